@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <glad/glad.h>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace common {
+
+// Records CPU frame times, GPU frame times and draw call counts for a run and
+// reports min/median/p99 statistics as JSON. GPU times come from a small ring
+// of GL_TIME_ELAPSED queries that is read back a few frames late, so the CPU
+// never waits on the GPU while the run is in progress.
+class Benchmark {
+public:
+  Benchmark();
+  ~Benchmark();
+
+  Benchmark(const Benchmark &) = delete;
+  Benchmark &operator=(const Benchmark &) = delete;
+
+  void begin_frame();
+  void end_frame();
+  void add_draw_calls(std::uint64_t count) {
+    if (frame_count_ >= warmup_frames) {
+      draw_calls_ += count;
+    }
+  }
+
+  // Adds to a named per-frame counter, such as the number of visible
+  // objects; reported as a total and a per-frame mean.
+  void add_counter(const std::string &name, std::uint64_t value);
+
+  // Records one measurement of a named quantity that is not tied to frames,
+  // such as an input latency; reported with min/median/p99 like frame times.
+  void add_sample(const std::string &name, double value);
+
+  // Waits for the queries still in flight. Call once after the last frame.
+  void finish();
+
+  // Records a named point in time, reported in milliseconds since the
+  // benchmark was created. The first frame is recorded as "first_frame".
+  void record_event(const std::string &name);
+
+  void write_json(std::ostream &os, const std::string &name) const;
+
+private:
+  using clock = std::chrono::steady_clock;
+  static constexpr std::size_t query_count{4};
+  // The first frame pays for lazy driver work such as shader JIT and
+  // resource creation, and llvmpipe reports a bogus elapsed time for it.
+  static constexpr std::size_t warmup_frames{1};
+
+  void collect_query(std::size_t index, bool wait);
+
+  std::array<GLuint, query_count> queries_{};
+  std::array<bool, query_count> pending_{};
+  std::size_t query_index_{0};
+  std::size_t frame_count_{0};
+  clock::time_point created_{clock::now()};
+  clock::time_point run_start_;
+  clock::time_point frame_start_;
+  clock::duration run_time_{};
+  std::vector<double> cpu_frame_ms_;
+  std::vector<double> gpu_frame_ms_;
+  std::uint64_t draw_calls_{0};
+  std::vector<std::pair<std::string, double>> events_;
+  std::vector<std::pair<std::string, std::uint64_t>> counters_;
+  std::vector<std::pair<std::string, std::vector<double>>> samples_;
+};
+
+} // namespace common
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <common/frustum.hpp>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace common {
+
+// Bounding volume hierarchy over object AABBs for frustum culling. Nodes are
+// stored depth first, so every subtree is one contiguous run of nodes and
+// its objects one contiguous run of indices. Moving objects are handled by
+// refitting the bounds; subtrees whose bounds have grown too much since they
+// were built are rebuilt in place, without touching the rest of the tree.
+class Bvh {
+public:
+  // Replaces the hierarchy with one over `bounds`; object i is bounds[i].
+  void build(std::span<const Aabb> bounds);
+
+  // Moves object `index`. Takes effect on the next refit().
+  void update(std::size_t index, const Aabb &bounds);
+
+  // Recomputes node bounds after update() calls and rebuilds the subtrees
+  // that degraded. Returns the number of subtrees rebuilt.
+  int refit();
+
+  // Appends the indices of the objects whose bounds touch the frustum.
+  void cull(const Frustum &frustum, std::vector<std::uint32_t> &visible) const;
+
+  std::size_t size() const { return bounds_.size(); }
+
+private:
+  static constexpr std::uint32_t leaf_size{4};
+  // A subtree is rebuilt once its surface area exceeds this multiple of the
+  // area it had when it was built.
+  static constexpr float rebuild_factor{2.0f};
+
+  struct Node {
+    Aabb bounds;
+    float built_area;
+    // Index of the right child; the left child follows the node. 0 for
+    // leaves.
+    std::uint32_t right;
+    // Objects of the subtree in objects_.
+    std::uint32_t first;
+    std::uint32_t count;
+  };
+
+  // Builds the subtree over objects_[first, first + count) at nodes_[index]
+  // and returns the index after its last node.
+  std::uint32_t build_node(std::uint32_t index, std::uint32_t first,
+                           std::uint32_t count);
+  int rebuild_degraded(std::uint32_t index);
+
+  std::vector<Aabb> bounds_;
+  std::vector<std::uint32_t> objects_;
+  std::vector<Node> nodes_;
+  bool dirty_{false};
+};
+
+} // namespace common
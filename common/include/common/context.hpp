@@ -0,0 +1,159 @@
+#pragma once
+
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <common/benchmark.hpp>
+#include <common/profiler.hpp>
+#include <common/shader.hpp>
+#include <common/texture_loader.hpp>
+#include <cstdint>
+#include <glad/glad.h>
+#include <memory>
+#include <string>
+
+namespace common {
+
+struct Options {
+  // Render into an offscreen framebuffer of a surfaceless EGL context instead
+  // of a window, so the demos run on machines without a display or GPU.
+  bool headless{false};
+  // Number of frames to run; 0 runs until the window is closed.
+  int frames{0};
+  // Where to write the JSON benchmark report, "-" for stdout, empty for none.
+  std::string benchmark_path;
+  // Directory for linked program binaries; empty uses a temporary directory.
+  std::string shader_cache_path;
+  // Replaces the texture a demo loads, for example with a precompiled .gtex.
+  std::string texture_path;
+  // Number of objects drawn by demos with a stress mode; 0 disables it.
+  int instances{0};
+  // Where to write a Chrome trace of the profiler zones; empty for none.
+  std::string trace_path;
+  // A .gmesh scene for demos that can draw one instead of their own geometry.
+  std::string mesh_path;
+  // Advance time() by 1/60 s per frame instead of following the wall clock,
+  // and wait for requested textures, so that runs render the same frames.
+  bool fixed_clock{false};
+  // Where to write the last frame of a run with a frame count as a PPM
+  // image; empty for none.
+  std::string capture_path;
+  // Cull and draw stress modes on the GPU with GpuCuller. Asks for a GL 4.3
+  // context, and falls back to 3.3 and the CPU path without one.
+  bool gpu_culling{false};
+};
+
+// Understands --headless, --frames <n>, --benchmark <path>,
+// --shader-cache <dir>, --texture <path>, --instances <n>, --trace <path>,
+// --mesh <path>, --fixed-clock, --capture <path> and --gpu-culling.
+Options parse_options(int argc, char **argv);
+
+// Owns the OpenGL context a demo renders into (a GLFW window or a headless
+// EGL context with an offscreen framebuffer) and drives the frame loop.
+class Context {
+public:
+  static std::unique_ptr<Context> create(const std::string &title, int width,
+                                         int height, const Options &options);
+  ~Context();
+
+  Context(const Context &) = delete;
+  Context &operator=(const Context &) = delete;
+
+  // nullptr when running headless.
+  GLFWwindow *window() const { return window_; }
+  bool headless() const { return options_.headless; }
+  int width() const { return width_; }
+  int height() const { return height_; }
+
+  ShaderCache &shader_cache() { return *shader_cache_; }
+
+  // Always on. Windows show its summary in their title bar.
+  Profiler &profiler() { return *profiler_; }
+
+  // Created on first use; begin_frame() then advances its uploads.
+  TextureLoader &texture_loader();
+
+  // The texture a demo should load: --texture, or else the demo's default.
+  const std::string &texture_path(const std::string &default_path) const {
+    return options_.texture_path.empty() ? default_path
+                                         : options_.texture_path;
+  }
+
+  // The scene given with --mesh, empty for none.
+  const std::string &mesh_path() const { return options_.mesh_path; }
+
+  // Object count requested with --instances, 0 when not stress testing.
+  int instances() const { return options_.instances; }
+
+  // Whether --gpu-culling was given; GpuCuller::supported() tells whether
+  // the context can do it.
+  bool gpu_culling() const { return options_.gpu_culling; }
+
+  // Seconds since the context was created, or since the first frame with
+  // --fixed-clock.
+  double time() const;
+
+  // Returns false once the window was closed or the frame budget is spent.
+  bool begin_frame();
+  void end_frame();
+
+  void add_draw_calls(std::uint64_t count) {
+    if (benchmark_) {
+      benchmark_->add_draw_calls(count);
+    }
+  }
+
+  void add_counter(const std::string &name, std::uint64_t value) {
+    if (benchmark_) {
+      benchmark_->add_counter(name, value);
+    }
+  }
+
+  void add_sample(const std::string &name, double value) {
+    if (benchmark_) {
+      benchmark_->add_sample(name, value);
+    }
+  }
+
+  void record_event(const std::string &name) {
+    if (benchmark_) {
+      benchmark_->record_event(name);
+    }
+  }
+
+private:
+  Context(const std::string &title, int width, int height,
+          const Options &options);
+
+  bool init_window();
+  bool init_headless();
+  bool init_framebuffer();
+  void capture();
+  void finish();
+
+  std::string title_;
+  int width_;
+  int height_;
+  Options options_;
+  std::chrono::steady_clock::time_point start_time_;
+  int frame_{0};
+  bool finished_{false};
+  bool textures_resident_{false};
+
+  bool glfw_initialized_{false};
+  GLFWwindow *window_{nullptr};
+
+  void *egl_display_{nullptr};
+  void *egl_context_{nullptr};
+  GLuint framebuffer_{0};
+  GLuint color_renderbuffer_{0};
+  GLuint depth_renderbuffer_{0};
+
+  std::unique_ptr<Benchmark> benchmark_;
+  std::unique_ptr<Profiler> profiler_;
+  std::chrono::steady_clock::time_point title_time_;
+  std::unique_ptr<ShaderCache> shader_cache_;
+  std::unique_ptr<TextureLoader> texture_loader_;
+};
+
+} // namespace common
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <common/reflection.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <glad/glad.h>
+#include <span>
+#include <vector>
+
+namespace common {
+
+// The GL objects a draw binds. Together with a depth they make up the sort
+// key of its packet.
+struct DrawState {
+  GLuint program;
+  GLuint vertex_array;
+  GLuint texture;
+};
+
+// A compact, GL-free record of one glDrawElements call of GL_TRIANGLES with
+// GL_UNSIGNED_INT indices. Its uniforms live in the arena of the list that
+// recorded it.
+struct DrawPacket {
+  // Program, vertex array and texture names in the top three 16 bit fields
+  // and the depth in the lowest, so that sorting groups packets by state and
+  // orders each group by depth. Names above 65535 share fields, which only
+  // costs some grouping.
+  std::uint64_t key;
+  DrawState state;
+  GLsizei index_count;
+  std::uint32_t first_index;
+  std::uint32_t uniform_begin;
+  std::uint32_t uniform_count;
+};
+
+// Records draw packets without touching GL, so any thread can fill one; use
+// one list per thread and hand them all to a DrawQueue on the GL thread.
+// The storage is kept across clear(), so steady-state recording does not
+// allocate.
+class DrawList {
+public:
+  // `depth` orders packets of equal state, for example front to back.
+  void draw(const DrawState &state, GLsizei index_count,
+            std::uint32_t first_index = 0, std::uint16_t depth = 0);
+
+  // Sets a uniform of the program of the last draw() right before it is
+  // issued. The queue replays packets in sort order, merged across lists, so
+  // the packet issued before this one is arbitrary: every packet must set
+  // each uniform it relies on that any packet of its program sets. Uniforms
+  // that no packet sets keep the value given them before DrawQueue::submit().
+  template <class T> void uniform(GLint location, const T &value) {
+    if (location < 0 || packets_.empty()) {
+      return;
+    }
+    auto offset{data_.size()};
+    data_.resize(offset + sizeof(T));
+    std::memcpy(data_.data() + offset, &value, sizeof(T));
+    uniforms_.push_back({location, UniformTraits<T>::type,
+                         static_cast<std::uint32_t>(offset)});
+    ++packets_.back().uniform_count;
+  }
+
+  void clear() {
+    packets_.clear();
+    uniforms_.clear();
+    data_.clear();
+  }
+
+  std::size_t size() const { return packets_.size(); }
+
+private:
+  friend class DrawQueue;
+
+  struct PacketUniform {
+    GLint location;
+    GLenum type;
+    std::uint32_t offset;
+  };
+
+  std::vector<DrawPacket> packets_;
+  std::vector<PacketUniform> uniforms_;
+  std::vector<std::byte> data_;
+};
+
+// Issues the packets of any number of draw lists from the GL thread: merges
+// them, radix-sorts them by key and replays them. State goes through
+// gl_state(), so only what differs from the previous packet is bound.
+class DrawQueue {
+public:
+  // Textures are bound to unit 0. The lists are left as they are; clear them
+  // before recording the next frame. Returns the number of draw calls.
+  int submit(std::span<const DrawList> lists);
+
+private:
+  struct Entry {
+    std::uint64_t key;
+    std::uint32_t list;
+    std::uint32_t packet;
+  };
+
+  void sort();
+
+  std::vector<Entry> entries_;
+  std::vector<Entry> scratch_;
+};
+
+} // namespace common
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace common {
+
+// A bounded lock-free queue for one producer thread and one consumer thread,
+// such as input events handed from the window callbacks to the simulation.
+// Neither side ever blocks: push() fails when the queue is full and pop()
+// when it is empty.
+template <class T, std::size_t Capacity> class EventQueue {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "the capacity must be a power of two");
+
+public:
+  bool push(const T &event) {
+    auto tail{tail_.load(std::memory_order_relaxed)};
+    if (tail - head_.load(std::memory_order_acquire) == Capacity) {
+      return false;
+    }
+    slots_[tail & (Capacity - 1)] = event;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T &event) {
+    auto head{head_.load(std::memory_order_relaxed)};
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    event = slots_[head & (Capacity - 1)];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  std::array<T, Capacity> slots_{};
+  // On separate cache lines so that the two threads do not share one.
+  alignas(64) std::atomic<std::size_t> head_{0};
+  alignas(64) std::atomic<std::size_t> tail_{0};
+};
+
+} // namespace common
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace common {
+
+struct Aabb {
+  glm::vec3 min;
+  glm::vec3 max;
+};
+
+Aabb merge(const Aabb &a, const Aabb &b);
+float surface_area(const Aabb &box);
+
+enum class Containment {
+  outside,
+  intersecting,
+  inside,
+};
+
+// The six clip planes of a view-projection matrix, kept as separate x, y, z
+// and w arrays padded to eight planes so that one box is tested against all
+// of them with a couple of SIMD instructions.
+class Frustum {
+public:
+  explicit Frustum(const glm::mat4 &view_projection);
+
+  // Conservative: boxes near a frustum corner may be reported as
+  // intersecting although they are outside.
+  Containment classify(const Aabb &box) const;
+
+private:
+  static constexpr int padded_plane_count{8};
+
+  alignas(32) float x_[padded_plane_count];
+  alignas(32) float y_[padded_plane_count];
+  alignas(32) float z_[padded_plane_count];
+  alignas(32) float w_[padded_plane_count];
+};
+
+} // namespace common
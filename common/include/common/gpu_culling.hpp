@@ -0,0 +1,112 @@
+#pragma once
+
+#include <array>
+#include <common/reflection.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <span>
+
+namespace common {
+
+// Vertex shaders of culled draws read the index of their object as
+// `layout (location = 7) in uint a_object;`, and the bounding spheres of
+// all objects as
+// `layout (std430, binding = 0) readonly buffer Objects { vec4 objects[]; };`
+// to find their own data.
+inline constexpr GLuint culled_object_location{7};
+inline constexpr GLuint culled_objects_binding{0};
+
+// Culls and draws many copies of one mesh without the CPU touching any of
+// them per frame. The bounding spheres of the objects live in a shader
+// storage buffer. A compute shader tests each against the frustum and
+// against a depth pyramid (Hi-Z) built from the previous frame's depth
+// buffer, and writes one DrawElementsIndirectCommand per visible object
+// whose base instance is the object's index. A single
+// glMultiDrawElementsIndirect then draws them. With ARB_indirect_parameters
+// the commands of visible objects are packed at the front and the draw
+// count comes from the GPU too; without it every object keeps its command,
+// with an instance count of 0 when it is culled.
+//
+// Needs GL 4.3 (compute shaders, shader storage and indirect multi-draws);
+// callers keep their CPU path for contexts without it.
+class GpuCuller {
+public:
+  static bool supported();
+
+  GpuCuller();
+  ~GpuCuller();
+
+  GpuCuller(const GpuCuller &) = delete;
+  GpuCuller &operator=(const GpuCuller &) = delete;
+
+  // Replaces the objects, each a bounding sphere in world space with its
+  // center in xyz and its radius in w.
+  void set_objects(std::span<const glm::vec4> spheres);
+  std::size_t size() const { return object_count_; }
+
+  // Culls the objects for `view_projection` and draws the visible ones with
+  // `program`, whose uniforms must already be set, and the `index_count`
+  // indices from `first_index` on of the element buffer of `vertex_array`.
+  // Sets up the a_object attribute of `vertex_array`. Returns the number of
+  // draw calls issued.
+  int draw(const glm::mat4 &view_projection, GLuint program,
+           GLuint vertex_array, GLsizei index_count, GLuint first_index = 0);
+
+  // Builds the depth pyramid that the next draw() tests occlusion against
+  // from the depth buffer of the bound framebuffer, covering the viewport.
+  // Call once the frame's depth is complete. Without it, draw() only culls
+  // against the frustum.
+  void update_depth();
+
+  // Objects drawn by an earlier draw(), read back once the GPU is done with
+  // it so that this never waits.
+  std::uint32_t visible_objects() const { return visible_objects_; }
+
+  // Whether the draw count comes from the GPU.
+  bool packs_commands() const { return packs_commands_; }
+
+private:
+  // Frames the GPU may be behind before a count is dropped unread.
+  static constexpr std::size_t readback_slot_count{3};
+
+  void resize_depth(int width, int height);
+  void read_back();
+
+  bool packs_commands_;
+  GLuint cull_program_{0};
+  GLuint reduce_program_{0};
+  Uniform<glm::mat4> view_projection_uniform_;
+  Uniform<glm::mat4> depth_view_projection_uniform_;
+  Uniform<int> object_count_uniform_;
+  Uniform<int> index_count_uniform_;
+  Uniform<int> first_index_uniform_;
+  Uniform<int> occlusion_uniform_;
+  Uniform<int> source_level_uniform_;
+  std::size_t object_count_{0};
+  GLuint object_buffer_{0};
+  GLuint index_buffer_{0};
+  GLuint command_buffer_{0};
+  // The draw count, and copies of it that the CPU reads once their fences
+  // are signaled.
+  GLuint count_buffer_{0};
+  GLuint readback_buffer_{0};
+  std::array<GLsync, readback_slot_count> readback_fences_{};
+  std::size_t frame_{0};
+  std::uint32_t visible_objects_{0};
+
+  GLuint depth_texture_{0};
+  GLuint pyramid_{0};
+  int depth_width_{0};
+  int depth_height_{0};
+  int pyramid_width_{0};
+  int pyramid_height_{0};
+  int pyramid_levels_{0};
+  // Whether the pyramid holds a frame, and the camera it was drawn from.
+  bool has_depth_{false};
+  glm::mat4 depth_view_projection_{1.0f};
+  glm::mat4 view_projection_{1.0f};
+};
+
+} // namespace common
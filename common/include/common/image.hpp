@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace common {
+
+// 8-bit RGB pixels, rows top to bottom.
+struct Image {
+  int width{0};
+  int height{0};
+  std::vector<unsigned char> pixels;
+};
+
+// Binary PPM (P6), which any image viewer opens and needs no library.
+bool write_ppm(const std::string &path, const Image &image);
+bool read_ppm(const std::string &path, Image &image);
+
+struct ImageDifference {
+  // Largest difference of any channel of any pixel.
+  int max_difference{0};
+  // Pixels with a channel that differs by more than the tolerance.
+  std::size_t mismatched_pixels{0};
+};
+
+// Images of different sizes mismatch in every pixel of the larger one.
+ImageDifference compare_images(const Image &a, const Image &b, int tolerance);
+
+// Reads back the color buffer of the bound framebuffer.
+Image read_framebuffer(int width, int height);
+
+} // namespace common
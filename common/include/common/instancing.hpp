@@ -0,0 +1,120 @@
+#pragma once
+
+#include <common/stream_buffer.hpp>
+#include <common/transforms.hpp>
+#include <compare>
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <map>
+#include <span>
+#include <vector>
+
+namespace common {
+
+// Vertex shaders of instanced draws read the model matrix as
+// `layout (location = 2) in mat4 a_model;`, which takes locations 2 to 5,
+// and may read the texture array layer of the instance as
+// `layout (location = 6) in uint a_layer;`.
+inline constexpr GLuint instance_model_location{2};
+inline constexpr GLuint instance_layer_location{6};
+
+// What one glDrawElementsInstanced call shares: the mesh and its material.
+// With a GL_TEXTURE_2D_ARRAY, instances with different textures still share
+// the batch and tell them apart by layer.
+struct DrawBatch {
+  GLuint vertex_array;
+  GLsizei index_count;
+  GLuint program;
+  GLuint texture;
+  GLenum texture_target{GL_TEXTURE_2D};
+  // Where the indices start in the element buffer, such as the range of a
+  // level of detail.
+  GLuint first_index{0};
+
+  auto operator<=>(const DrawBatch &) const = default;
+};
+
+// Collects model matrices per batch and draws every batch with a single
+// instanced call. All matrices of a flush go into one region of a
+// StreamBuffer, and each batch points the a_model attribute of its vertex
+// array at its range, which works without base instance support.
+class InstancedRenderer {
+public:
+  InstancedRenderer();
+
+  InstancedRenderer(const InstancedRenderer &) = delete;
+  InstancedRenderer &operator=(const InstancedRenderer &) = delete;
+
+  void add(const DrawBatch &batch, const glm::mat4 &model,
+           std::uint32_t layer = 0) {
+    auto &instances{batches_[batch]};
+    instances.models.push_back(model);
+    if (layer != 0 || !instances.layers.empty()) {
+      instances.layers.resize(instances.models.size() - 1, 0);
+      instances.layers.push_back(layer);
+    }
+  }
+
+  // The model matrices queued for `batch`, for callers that fill them in
+  // bulk. Their layers are 0.
+  std::vector<glm::mat4> &instances(const DrawBatch &batch) {
+    return batches_[batch].models;
+  }
+
+  // Queues every object of `transforms`. Their matrices are composed by
+  // flush() straight into the mapped instance buffer, so `transforms` must
+  // stay alive and unchanged until then.
+  void add(const DrawBatch &batch, const TransformStore &transforms) {
+    batches_[batch].stores.push_back({&transforms, {}, true});
+  }
+
+  // Same for only the objects in `indices`, such as the visible ones, which
+  // must also stay alive until flush().
+  void add(const DrawBatch &batch, const TransformStore &transforms,
+           std::span<const std::uint32_t> indices) {
+    batches_[batch].stores.push_back({&transforms, indices, false});
+  }
+
+  // Same, with the layer of every object of `transforms` in `layers`, which
+  // must stay alive until flush() too.
+  void add(const DrawBatch &batch, const TransformStore &transforms,
+           std::span<const std::uint32_t> indices,
+           std::span<const std::uint32_t> layers) {
+    batches_[batch].stores.push_back({&transforms, indices, false, layers});
+  }
+
+  // Uploads the queued matrices and layers, draws each non-empty batch with
+  // its texture on unit 0 and empties the queues. Each call uses the next
+  // region of the instance buffer, so call it once per frame. The programs
+  // must already have their other uniforms set. Returns the number of draw
+  // calls issued.
+  int flush();
+
+private:
+  struct StoreRange {
+    const TransformStore *transforms;
+    std::span<const std::uint32_t> indices;
+    bool all;
+    // Per object of `transforms`; empty for layer 0.
+    std::span<const std::uint32_t> layers{};
+
+    std::size_t size() const {
+      return all ? transforms->size() : indices.size();
+    }
+  };
+
+  struct Instances {
+    std::vector<glm::mat4> models;
+    // Parallel to `models`, or shorter with the rest 0.
+    std::vector<std::uint32_t> layers;
+    std::vector<StoreRange> stores;
+
+    std::size_t size() const;
+  };
+
+  std::map<DrawBatch, Instances> batches_;
+  StreamBuffer instance_buffer_;
+};
+
+} // namespace common
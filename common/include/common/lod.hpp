@@ -0,0 +1,57 @@
+#pragma once
+
+#include <common/mesh.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+namespace common {
+
+// Picks a level of detail per object every frame: the coarsest whose error,
+// projected to the screen at the object's distance, stays within a number
+// of pixels. Levels only get coarser once their error is well within that,
+// by the hysteresis fraction, so that objects at the distance where two
+// levels meet do not switch back and forth as the camera moves.
+class LodSelector {
+public:
+  explicit LodSelector(float threshold_pixels = 1.0f,
+                       float hysteresis = 0.25f)
+      : threshold_{threshold_pixels}, hysteresis_{hysteresis} {}
+
+  // Objects start at full detail.
+  void resize(std::size_t object_count) { levels_.resize(object_count, 0); }
+
+  // The camera of this frame: its position, vertical field of view in
+  // radians and viewport height in pixels. Resets the frame's counts.
+  void begin_frame(const glm::vec3 &eye, float fov_y, int viewport_height);
+
+  // Selects a level among `lods`, finest first, for an object whose mesh is
+  // scaled by `scale` and bounded by a sphere around `center` in world
+  // space. Counts its triangles at that level.
+  std::uint32_t select(std::size_t object, std::span<const MeshLod> lods,
+                       const glm::vec3 &center, float radius,
+                       float scale = 1.0f);
+
+  // This frame's selections so far.
+  std::uint64_t triangles() const { return triangles_; }
+  std::uint64_t full_detail_triangles() const {
+    return full_detail_triangles_;
+  }
+  // Objects that switched level.
+  std::uint64_t changes() const { return changes_; }
+
+private:
+  float threshold_;
+  float hysteresis_;
+  std::vector<std::uint8_t> levels_;
+  glm::vec3 eye_{0.0f};
+  // Pixels that one unit at distance one covers.
+  float pixels_per_unit_{1.0f};
+  std::uint64_t triangles_{0};
+  std::uint64_t full_detail_triangles_{0};
+  std::uint64_t changes_{0};
+};
+
+} // namespace common
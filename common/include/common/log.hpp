@@ -0,0 +1,210 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace common {
+
+enum class LogLevel {
+  debug,
+  info,
+  warning,
+  error,
+};
+
+// A log call with its arguments captured but not yet formatted, so that the
+// calling thread only copies a few values. Formats must be string literals:
+// only the pointer is kept. String arguments are copied into the record.
+class LogRecord {
+public:
+  static constexpr std::size_t max_arguments{6};
+  static constexpr std::size_t text_capacity{160};
+
+  LogRecord() = default;
+  LogRecord(LogLevel level, const char *format);
+
+  void add(bool value);
+  void add(std::string_view value);
+  void add(const char *value) { add(std::string_view{value}); }
+  void add(const std::string &value) { add(std::string_view{value}); }
+
+  template <std::integral T> void add(T value) {
+    if constexpr (std::signed_integral<T>) {
+      push({Argument::Type::signed_integer, {.signed_integer = value}});
+    } else {
+      push({Argument::Type::unsigned_integer, {.unsigned_integer = value}});
+    }
+  }
+
+  template <std::floating_point T> void add(T value) {
+    push({Argument::Type::floating, {.floating = value}});
+  }
+
+  void set_suppressed(std::uint32_t count) { suppressed_ = count; }
+
+  // False when arguments did not fit and were dropped.
+  bool complete() const { return complete_; }
+  LogLevel level() const { return level_; }
+  std::int64_t time_ns() const { return time_ns_; }
+
+  // Replaces each {} of the format with the next argument.
+  std::string format() const;
+
+private:
+  struct Argument {
+    enum class Type : std::uint8_t {
+      boolean,
+      signed_integer,
+      unsigned_integer,
+      floating,
+      string,
+    };
+    Type type;
+    union {
+      bool boolean;
+      std::int64_t signed_integer;
+      std::uint64_t unsigned_integer;
+      double floating;
+      struct {
+        std::uint16_t offset;
+        std::uint16_t size;
+      } string;
+    };
+  };
+
+  void push(const Argument &argument) {
+    if (argument_count_ == max_arguments) {
+      complete_ = false;
+      return;
+    }
+    arguments_[argument_count_++] = argument;
+  }
+
+  std::int64_t time_ns_{0};
+  const char *format_{""};
+  LogLevel level_{LogLevel::info};
+  bool complete_{true};
+  std::uint8_t argument_count_{0};
+  std::uint16_t text_size_{0};
+  std::uint32_t suppressed_{0};
+  // Left uninitialised; only the used prefixes are ever read.
+  std::array<Argument, max_arguments> arguments_;
+  std::array<char, text_capacity> text_;
+};
+
+// Messages below this level are skipped at the call; info by default.
+void set_log_level(LogLevel level);
+bool log_enabled(LogLevel level);
+
+// Hands a record to the calling thread's ring buffer, from which a
+// background thread formats and writes it: warnings and errors to stderr,
+// the rest to stdout. Never blocks; a full ring drops the record and the
+// drop is reported later.
+void submit_log(const LogRecord &record);
+// The slow path for messages that did not fit in a record, formatted by the
+// caller and queued under a lock.
+void submit_log(LogLevel level, std::string message);
+
+// Writes everything logged so far before returning.
+void flush_log();
+
+template <class... Args>
+std::string format_log(std::string_view format, const Args &...args) {
+  std::ostringstream os;
+  os << std::boolalpha;
+  auto next{[&](const auto &argument) {
+    auto placeholder{format.find("{}")};
+    os << format.substr(0, placeholder);
+    if (placeholder == std::string_view::npos) {
+      format = {};
+      return;
+    }
+    os << argument;
+    format.remove_prefix(placeholder + 2);
+  }};
+  (next(args), ...);
+  os << format;
+  return os.str();
+}
+
+template <class... Args>
+void log(LogLevel level, const char *format, const Args &...args) {
+  if (!log_enabled(level)) {
+    return;
+  }
+  LogRecord record{level, format};
+  (record.add(args), ...);
+  if (record.complete()) {
+    submit_log(record);
+  } else {
+    submit_log(level, format_log(format, args...));
+  }
+}
+
+template <class... Args>
+void log_debug(const char *format, const Args &...args) {
+  log(LogLevel::debug, format, args...);
+}
+
+template <class... Args>
+void log_info(const char *format, const Args &...args) {
+  log(LogLevel::info, format, args...);
+}
+
+template <class... Args>
+void log_warning(const char *format, const Args &...args) {
+  log(LogLevel::warning, format, args...);
+}
+
+template <class... Args>
+void log_error(const char *format, const Args &...args) {
+  log(LogLevel::error, format, args...);
+}
+
+// Lets at most one message through per interval, for messages logged every
+// frame. The next message that passes says how many were suppressed.
+class LogRateLimit {
+public:
+  using clock = std::chrono::steady_clock;
+
+  explicit LogRateLimit(clock::duration interval) : interval_{interval} {}
+
+  template <class... Args>
+  void log(LogLevel level, const char *format, const Args &...args) {
+    if (!log_enabled(level)) {
+      return;
+    }
+    auto now{clock::now()};
+    if (now < next_) {
+      ++suppressed_;
+      return;
+    }
+    next_ = now + interval_;
+    auto suppressed{std::exchange(suppressed_, 0)};
+    LogRecord record{level, format};
+    (record.add(args), ...);
+    record.set_suppressed(suppressed);
+    if (record.complete()) {
+      submit_log(record);
+    } else {
+      auto message{format_log(format, args...)};
+      if (suppressed > 0) {
+        message += format_log(" ({} similar messages suppressed)", suppressed);
+      }
+      submit_log(level, std::move(message));
+    }
+  }
+
+private:
+  clock::duration interval_;
+  clock::time_point next_{};
+  std::uint32_t suppressed_{0};
+};
+
+} // namespace common
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace common {
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(MappedFile &&other) noexcept;
+  MappedFile &operator=(MappedFile &&other) noexcept;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  // Prints the reason and returns false when the file cannot be mapped.
+  bool open(const std::string &path);
+  void close();
+
+  const std::byte *data() const { return data_; }
+  std::size_t size() const { return size_; }
+
+private:
+  const std::byte *data_{nullptr};
+  std::size_t size_{0};
+#ifdef _WIN32
+  void *file_{nullptr};
+  void *mapping_{nullptr};
+#endif
+};
+
+} // namespace common
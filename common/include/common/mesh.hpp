@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+namespace common {
+
+struct MeshVertex {
+  glm::vec3 position;
+  glm::vec3 normal;
+  glm::vec2 uv;
+};
+
+// A level of detail of a mesh: a range of its index list that draws a
+// coarser version of it from the same vertices.
+struct MeshLod {
+  std::uint32_t first_index;
+  std::uint32_t index_count;
+  // How far, in mesh units, the surface may be from the full detail one.
+  float error;
+};
+
+// An indexed triangle list.
+struct Mesh {
+  std::vector<MeshVertex> vertices;
+  std::vector<std::uint32_t> indices;
+  // Finest first, the first one being the full detail mesh. Empty when the
+  // whole index list is the only level.
+  std::vector<MeshLod> lods;
+};
+
+// Loads the faces of a Wavefront OBJ file, triangulating polygons as fans.
+// Corners with the same position, normal and texture coordinates share one
+// vertex; missing normals and texture coordinates are zero. Prints the
+// reason and returns false when the file cannot be read.
+bool load_obj(const std::string &path, Mesh &mesh);
+
+struct VertexCacheStatistics {
+  // Average cache miss ratio: vertices transformed per triangle. 3 at worst,
+  // about 0.5 for large regular meshes in the best order.
+  double acmr;
+  // Average transform to vertex ratio: how often each vertex is
+  // transformed. 1 at best.
+  double atvr;
+};
+
+// Simulates a FIFO post-transform cache of `cache_size` vertices, the model
+// the optimisers below are tuned for.
+VertexCacheStatistics
+analyze_vertex_cache(const std::vector<std::uint32_t> &indices,
+                     std::size_t vertex_count, unsigned cache_size = 16);
+
+// Reorders the triangles for the post-transform vertex cache with Tipsify
+// (Sander, Nehab and Barczak, 2007), in linear time. Returns the index
+// offsets at which the new order starts a cluster of triangles that can be
+// moved as a whole without costing more than `cluster_threshold` times the
+// ACMR, for optimize_overdraw().
+std::vector<std::size_t>
+optimize_vertex_cache(std::vector<std::uint32_t> &indices,
+                      std::size_t vertex_count, unsigned cache_size = 16,
+                      double cluster_threshold = 1.05);
+
+// Sorts the clusters so that those facing away from the centre of the mesh
+// come first: drawn early, they occlude the rest, which then fail the depth
+// test before shading.
+void optimize_overdraw(std::vector<std::uint32_t> &indices,
+                       const std::vector<std::size_t> &clusters,
+                       const std::vector<MeshVertex> &vertices);
+
+// Renumbers the vertices in the order the indices first use them, so that
+// vertex fetches walk memory forwards, and drops unused vertices.
+void optimize_vertex_fetch(Mesh &mesh);
+
+// The three passes above, in order. They treat the index list as one
+// level, so run them before generate_lods().
+void optimize_mesh(Mesh &mesh, unsigned cache_size = 16);
+
+// Appends up to `max_levels` - 1 coarser levels to the full detail mesh,
+// replacing any it had, each with about `ratio` times the triangles of the
+// one before. They are simplified by collapsing edges in the order of their
+// quadric error (Garland and Heckbert, 1997) onto one of their two
+// vertices, so the levels share the vertex buffer, and each is then
+// reordered for the vertex cache. Vertices on open borders and on seams,
+// where the normal or texture coordinates of a position change, never move.
+// Stops early when simplification stalls.
+void generate_lods(Mesh &mesh, std::size_t max_levels = 4, float ratio = 0.5f,
+                   unsigned cache_size = 16);
+
+} // namespace common
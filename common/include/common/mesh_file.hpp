@@ -0,0 +1,66 @@
+#pragma once
+
+#include <common/mesh.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+
+namespace common {
+
+// A .gmesh file holds any number of meshes as the GPU wants them: a header,
+// a chunk table with one entry per mesh, then all vertices and all indices
+// as two blobs, each starting 16-byte aligned. Vertices are MeshVertex
+// structs and indices 32-bit, already offset by the chunk's first vertex, so
+// every chunk draws from the same pair of buffers with plain glDrawElements.
+// The chunk table is followed by a table of the levels of detail of all
+// chunks, with their first indices counted from the start of the blob.
+constexpr std::uint32_t mesh_file_magic{0x48534d47}; // "GMSH"
+constexpr std::uint32_t mesh_file_version{2};
+constexpr std::size_t mesh_file_alignment{16};
+
+struct MeshFileHeader {
+  std::uint32_t magic;
+  std::uint32_t version;
+  // sizeof(MeshVertex) when written.
+  std::uint32_t vertex_stride;
+  std::uint32_t chunk_count;
+  std::uint64_t vertex_offset;
+  std::uint64_t vertex_size;
+  std::uint64_t index_offset;
+  std::uint64_t index_size;
+};
+
+struct MeshFileChunk {
+  std::uint32_t first_vertex;
+  std::uint32_t vertex_count;
+  // The full detail level.
+  std::uint32_t first_index;
+  std::uint32_t index_count;
+  glm::vec3 bounds_min;
+  glm::vec3 bounds_max;
+  // Levels of detail in the level table, finest first. Every chunk has at
+  // least the full detail one.
+  std::uint32_t first_lod;
+  std::uint32_t lod_count;
+};
+
+bool write_mesh_file(const std::string &path, const std::vector<Mesh> &meshes);
+
+// Maps the file and fills the two buffers from the mapping with
+// glBufferSubData, in pieces of at most `piece_size` bytes so that the driver
+// never stages more than that at once, however big the file. The index
+// values are trusted, not checked against the vertex count.
+bool upload_mesh_file(const std::string &path, GLuint vertex_buffer,
+                      GLuint index_buffer, std::vector<MeshFileChunk> &chunks,
+                      std::vector<MeshLod> &lods,
+                      std::size_t piece_size = 16 << 20);
+
+// Points attributes of the bound vertex array at the position, normal and
+// texture coordinates of the MeshVertex structs in `buffer`. A location of
+// -1 leaves that component out.
+void set_mesh_vertex_attributes(GLuint buffer, GLint position_location,
+                                GLint normal_location, GLint uv_location);
+
+} // namespace common
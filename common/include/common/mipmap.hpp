@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+namespace common {
+
+enum class MipmapFilter {
+  // 2x2 average, the same footprint as most glGenerateMipmap implementations.
+  box,
+  // 6x6 Kaiser-windowed sinc: sharper levels with less aliasing.
+  kaiser,
+};
+
+struct MipmapOptions {
+  MipmapFilter filter{MipmapFilter::box};
+  // Treat the RGB channels of 3 and 4 channel images as sRGB encoded: filter
+  // in linear light and encode the result back to sRGB. Alpha and images
+  // with fewer channels are always filtered as they are.
+  bool srgb{true};
+  // Rows of every level are split across this many threads.
+  unsigned threads{1};
+};
+
+struct MipmapLevel {
+  int width;
+  int height;
+  // Tightly packed rows of width * channels bytes.
+  std::vector<unsigned char> pixels;
+};
+
+// Builds mip levels 1 and up, down to 1x1, for 8-bit images with 1 to 4
+// channels. The filtering kernels use SSE, or AVX2 when the library is built
+// with COMMON_AVX2, and the filtering of each level overlaps with converting
+// the previous one back to 8 bits.
+std::vector<MipmapLevel> build_mipmaps(const unsigned char *pixels, int width,
+                                       int height, int channels,
+                                       const MipmapOptions &options);
+
+} // namespace common
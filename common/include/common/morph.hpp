@@ -0,0 +1,52 @@
+#pragma once
+
+#include <common/reflection.hpp>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <span>
+
+namespace common {
+
+// GLSL for vertex shaders that play a MorphAnimation; paste it after the
+// #version line. morph_position(vertex, time) returns the vertex's position
+// blended between the two keyframes around `time`, without branches, so a
+// mesh can have any number of vertices and keyframes and every instance can
+// play at its own time.
+extern const char morph_shader_source[];
+
+// Keyframed vertex positions of one mesh ("morph targets"), stored
+// keyframe-major in a texture buffer and read with texelFetch.
+class MorphAnimation {
+public:
+  // `positions` holds keyframe_count runs of vertex_count positions.
+  // Keyframes are `keyframe_duration` seconds apart. A looping animation
+  // blends from the last keyframe back to the first; otherwise it holds the
+  // first and last keyframe outside its duration.
+  MorphAnimation(std::span<const glm::vec3> positions, int vertex_count,
+                 int keyframe_count, float keyframe_duration, bool loop);
+  ~MorphAnimation();
+
+  MorphAnimation(const MorphAnimation &) = delete;
+  MorphAnimation &operator=(const MorphAnimation &) = delete;
+
+  int vertex_count() const { return vertex_count_; }
+  int keyframe_count() const { return keyframe_count_; }
+  // Seconds from the first keyframe to the end of the animation.
+  float duration() const;
+
+  // Sets the u_morph_* uniforms of `reflection`'s program, which must be in
+  // use, to this animation read from `texture_unit`.
+  void configure(const ProgramReflection &reflection, int texture_unit) const;
+  // Binds the keyframe texture to `texture_unit`.
+  void bind(int texture_unit) const;
+
+private:
+  int vertex_count_;
+  int keyframe_count_;
+  float keyframe_duration_;
+  bool loop_;
+  GLuint buffer_{0};
+  GLuint texture_{0};
+};
+
+} // namespace common
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace common {
+
+// Splits [0, count) into contiguous chunks of at least min_chunk items and
+// runs body(begin, end) for each on up to `threads` threads. The calling
+// thread takes the first chunk, so small ranges never start a thread.
+template <class F>
+void parallel_for(std::size_t count, unsigned threads, std::size_t min_chunk,
+                  F &&body) {
+  auto chunks{std::min<std::size_t>(
+      std::max(threads, 1u), (count + min_chunk - 1) / std::max<std::size_t>(
+                                                          min_chunk, 1))};
+  if (chunks <= 1) {
+    if (count > 0) {
+      body(std::size_t{0}, count);
+    }
+    return;
+  }
+
+  auto chunk_size{(count + chunks - 1) / chunks};
+  std::vector<std::thread> workers;
+  workers.reserve(chunks - 1);
+  for (auto begin{chunk_size}; begin < count; begin += chunk_size) {
+    auto end{std::min(count, begin + chunk_size)};
+    workers.emplace_back([&body, begin, end] { body(begin, end); });
+  }
+  body(std::size_t{0}, chunk_size);
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+} // namespace common
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <glad/glad.h>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace common {
+
+// Times named CPU and GPU zones of every frame. CPU zones read the steady
+// clock on entry and exit and may be opened on any thread. GPU zones put a
+// GL_TIMESTAMP query on either side of their commands; the queries of the
+// last few frames form a ring that is read back only once the results are
+// available, so the CPU never waits for the GPU. A frame whose queries are
+// still pending when its slot comes round again is dropped instead.
+//
+// Zone totals per frame feed a moving average for summary(), and with
+// tracing on every zone is also kept for write_trace(). Zone names must be
+// string literals or otherwise outlive the profiler.
+class Profiler {
+public:
+  explicit Profiler(bool trace);
+  ~Profiler();
+
+  Profiler(const Profiler &) = delete;
+  Profiler &operator=(const Profiler &) = delete;
+
+  void begin_frame();
+  void end_frame();
+
+  // Writes the recorded zones as Chrome trace_event JSON, for
+  // chrome://tracing or ui.perfetto.dev. GPU zones show up as a thread of
+  // their own, aligned with the CPU clock.
+  void write_trace(std::ostream &os) const;
+
+  // Moving averages in milliseconds per frame, for example
+  // "frame 4.10 ms | cull 0.52 | gpu draw 1.31".
+  std::string summary() const;
+
+  // Frames whose GPU results were discarded because reading them would have
+  // stalled.
+  std::uint64_t dropped_gpu_frames() const { return dropped_gpu_frames_; }
+
+private:
+  friend class CpuZone;
+  friend class GpuZone;
+
+  using clock = std::chrono::steady_clock;
+  static constexpr std::size_t frames_in_flight{4};
+
+  struct Zone {
+    const char *name;
+    std::uint32_t thread;
+    std::int64_t start_ns;
+    std::int64_t duration_ns;
+  };
+
+  struct GpuZoneQueries {
+    const char *name;
+    std::size_t begin;
+    std::size_t end;
+  };
+
+  struct GpuFrame {
+    std::vector<GLuint> queries;
+    std::size_t used{0};
+    std::vector<GpuZoneQueries> zones;
+    bool pending{false};
+  };
+
+  struct Average {
+    const char *name;
+    bool gpu;
+    double frame_ns;
+    double average_ms;
+    std::uint64_t frames;
+  };
+
+  std::int64_t now_ns() const;
+  void end_cpu_zone(const char *name, std::int64_t start_ns);
+  GLuint next_query();
+  void end_gpu_zone(const char *name, std::size_t begin, std::size_t end);
+  bool collect(GpuFrame &frame);
+  void accumulate(const char *name, bool gpu, std::int64_t duration_ns);
+
+  bool trace_;
+  clock::time_point epoch_{clock::now()};
+  // GPU timestamp minus CPU time, both in nanoseconds since epoch_.
+  std::int64_t gpu_offset_ns_{0};
+  std::int64_t frame_start_ns_{0};
+  std::uint64_t frame_{0};
+  std::uint64_t dropped_gpu_frames_{0};
+  std::array<GpuFrame, frames_in_flight> gpu_frames_;
+
+  mutable std::mutex mutex_;
+  std::vector<Average> averages_;
+  double frame_average_ms_{0.0};
+  std::vector<Zone> zones_;
+};
+
+// Times the enclosing scope as a CPU zone.
+class CpuZone {
+public:
+  CpuZone(Profiler &profiler, const char *name)
+      : profiler_{profiler}, name_{name}, start_ns_{profiler.now_ns()} {}
+  ~CpuZone() { profiler_.end_cpu_zone(name_, start_ns_); }
+
+  CpuZone(const CpuZone &) = delete;
+  CpuZone &operator=(const CpuZone &) = delete;
+
+private:
+  Profiler &profiler_;
+  const char *name_;
+  std::int64_t start_ns_;
+};
+
+// Times the GL commands issued in the enclosing scope on the GPU. Only the
+// thread that owns the GL context may open one.
+class GpuZone {
+public:
+  GpuZone(Profiler &profiler, const char *name);
+  ~GpuZone();
+
+  GpuZone(const GpuZone &) = delete;
+  GpuZone &operator=(const GpuZone &) = delete;
+
+private:
+  Profiler &profiler_;
+  const char *name_;
+  std::size_t begin_;
+};
+
+} // namespace common
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <string>
+#include <unordered_map>
+
+namespace common {
+
+template <class T> struct UniformTraits;
+
+template <> struct UniformTraits<float> {
+  static constexpr GLenum type{GL_FLOAT};
+  static void upload(GLint location, float value) {
+    glUniform1f(location, value);
+  }
+};
+
+template <> struct UniformTraits<int> {
+  static constexpr GLenum type{GL_INT};
+  static void upload(GLint location, int value) {
+    glUniform1i(location, value);
+  }
+};
+
+template <> struct UniformTraits<glm::vec2> {
+  static constexpr GLenum type{GL_FLOAT_VEC2};
+  static void upload(GLint location, const glm::vec2 &value) {
+    glUniform2fv(location, 1, glm::value_ptr(value));
+  }
+};
+
+template <> struct UniformTraits<glm::vec3> {
+  static constexpr GLenum type{GL_FLOAT_VEC3};
+  static void upload(GLint location, const glm::vec3 &value) {
+    glUniform3fv(location, 1, glm::value_ptr(value));
+  }
+};
+
+template <> struct UniformTraits<glm::vec4> {
+  static constexpr GLenum type{GL_FLOAT_VEC4};
+  static void upload(GLint location, const glm::vec4 &value) {
+    glUniform4fv(location, 1, glm::value_ptr(value));
+  }
+};
+
+template <> struct UniformTraits<glm::mat4> {
+  static constexpr GLenum type{GL_FLOAT_MAT4};
+  static void upload(GLint location, const glm::mat4 &value) {
+    glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+  }
+};
+
+// A pre-resolved uniform location that remembers the last value it uploaded,
+// so setting the current value again issues no GL call. The shadow value is
+// only correct while every write to the uniform goes through this handle.
+// Like glUniform*, set() applies to the program currently in use.
+template <class T> class Uniform {
+public:
+  Uniform() = default;
+  explicit Uniform(GLint location) : location_{location} {}
+
+  bool valid() const { return location_ >= 0; }
+
+  void set(const T &value) {
+    if (location_ < 0 || (uploaded_ && value_ == value)) {
+      return;
+    }
+    value_ = value;
+    uploaded_ = true;
+    UniformTraits<T>::upload(location_, value);
+  }
+
+private:
+  GLint location_{-1};
+  T value_{};
+  bool uploaded_{false};
+};
+
+// Enumerates the active uniforms of a linked program once with
+// glGetActiveUniform and hands out typed handles to them.
+class ProgramReflection {
+public:
+  struct UniformInfo {
+    GLint location;
+    GLenum type;
+    GLint size;
+  };
+
+  explicit ProgramReflection(GLuint program);
+
+  GLuint program() const { return program_; }
+
+  // nullptr when the program has no active uniform with this name.
+  const UniformInfo *find(const std::string &name) const;
+
+  // Returns an invalid handle, whose set() does nothing, when the uniform is
+  // missing (for example optimised out) or declared with another type.
+  template <class T> Uniform<T> uniform(const std::string &name) const {
+    auto info{find(name)};
+    if (!info || !type_matches(info->type, UniformTraits<T>::type)) {
+      report_missing(name);
+      return Uniform<T>{};
+    }
+    return Uniform<T>{info->location};
+  }
+
+  // Points the uniform block `name` at uniform buffer binding `binding`.
+  // Returns false when the program has no active block with this name.
+  bool bind_uniform_block(const std::string &name, GLuint binding) const;
+
+private:
+  static bool type_matches(GLenum declared, GLenum requested);
+  void report_missing(const std::string &name) const;
+
+  GLuint program_;
+  std::unordered_map<std::string, UniformInfo> uniforms_;
+};
+
+} // namespace common
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace common {
+
+// A hierarchy of local transforms whose world matrices are kept up to date
+// incrementally. set_local() only marks a node; update() then recomputes the
+// world matrices of the marked nodes and their descendants and skips every
+// subtree with no mark in it, so a mostly static scene costs next to
+// nothing.
+//
+// Nodes are numbered in the order they are added, and a parent is always
+// added before its children. Internally, update() keeps them in depth-first
+// order, so that it walks memory front to back and every subtree is one
+// contiguous range, and spreads subtrees that share no ancestor across
+// threads.
+class SceneGraph {
+public:
+  static constexpr std::uint32_t no_parent{0xffffffff};
+
+  std::size_t size() const { return parents_.size(); }
+
+  // Returns the index of the new node, which starts out marked.
+  std::uint32_t add(std::uint32_t parent,
+                    const glm::mat4 &local = glm::mat4(1.0f));
+  void clear();
+
+  void set_local(std::uint32_t node, const glm::mat4 &local);
+
+  std::uint32_t parent(std::uint32_t node) const { return parents_[node]; }
+  const glm::mat4 &local(std::uint32_t node) const {
+    return locals_[positions_[node]];
+  }
+  // As of the last update().
+  const glm::mat4 &world(std::uint32_t node) const {
+    return worlds_[positions_[node]];
+  }
+
+  // Recomputes the world matrices that the marked nodes affect, on up to
+  // `threads` threads, and returns how many that was.
+  std::size_t update(unsigned threads = 1);
+
+private:
+  // Updates the nodes at positions [begin, end), whose parents are up to
+  // date.
+  std::size_t update_range(std::size_t begin, std::size_t end);
+  // Moves the nodes into depth-first order.
+  void build_order();
+
+  // By node.
+  std::vector<std::uint32_t> parents_;
+  std::vector<std::uint32_t> positions_;
+
+  // By position, in depth-first order as of the last update(), with nodes
+  // added since then at the end.
+  std::vector<std::uint32_t> nodes_;
+  std::vector<std::uint32_t> parent_positions_;
+  std::vector<glm::mat4> locals_;
+  std::vector<glm::mat4> worlds_;
+  // The node itself changed, or some node below it did.
+  std::vector<std::uint8_t> dirty_;
+  std::vector<std::uint8_t> dirty_below_;
+  // The update() that last recomputed the node, so that children can tell
+  // whether their parent moved without clearing flags afterwards.
+  std::vector<std::uint32_t> updated_in_;
+  // One past the last position of the subtree.
+  std::vector<std::uint32_t> subtree_end_;
+  std::uint32_t updates_{0};
+  // Some node was marked since the last update().
+  bool marked_{false};
+  bool order_stale_{true};
+
+  // Positions of nodes whose subtrees are too big for one thread, then the
+  // ranges of positions below them that are handed out to threads.
+  std::vector<std::uint32_t> spine_;
+  std::vector<std::uint32_t> task_begin_, task_end_;
+};
+
+} // namespace common
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+
+namespace common {
+
+// Compiles and links a program from vertex and fragment shader sources,
+// printing the info log and returning 0 on failure.
+GLuint compile_program(const std::string &vertex_source,
+                       const std::string &fragment_source);
+
+// Same for a compute shader, which needs GL 4.3.
+GLuint compile_compute_program(const std::string &compute_source);
+
+// Builds shader programs and keeps their linked binaries on disk, keyed by a
+// hash of the sources and the driver identity. Later runs reload the binary
+// with glProgramBinary and only compile when the driver rejects the blob, for
+// example after a driver update.
+class ShaderCache {
+public:
+  explicit ShaderCache(std::filesystem::path directory);
+
+  // Returns a linked program, or 0 when the sources fail to build.
+  GLuint load(const std::string &vertex_source,
+              const std::string &fragment_source);
+
+  // The program stored for these sources, or 0 when there is none or the
+  // driver rejects it.
+  GLuint find(const std::string &vertex_source,
+              const std::string &fragment_source) const;
+  // Stores the binary of `program`, which must have been linked with
+  // GL_PROGRAM_BINARY_RETRIEVABLE_HINT, for later runs to find().
+  void store(GLuint program, const std::string &vertex_source,
+             const std::string &fragment_source) const;
+  // False when the driver has no binary formats, which makes the cache a
+  // pass-through.
+  bool stores_binaries() const { return binaries_supported_; }
+
+private:
+  std::uint64_t hash(const std::string &vertex_source,
+                     const std::string &fragment_source) const;
+  std::filesystem::path entry_path(std::uint64_t key) const;
+  GLuint load_binary(const std::filesystem::path &path) const;
+  void store_binary(GLuint program, const std::filesystem::path &path) const;
+
+  std::filesystem::path directory_;
+  std::string driver_;
+  bool binaries_supported_{false};
+};
+
+// Builds many programs without waiting for any of them. submit() issues
+// the compiles and the link and returns at once. With
+// KHR_parallel_shader_compile (or ARB_parallel_shader_compile) the driver
+// builds on its own threads, and poll() only reads the results of builds
+// whose GL_COMPLETION_STATUS_KHR says they are done, which never blocks.
+// Without either extension the driver builds when the results are read, so
+// poll() finishes builds one after the other until a time budget is spent.
+// Either way a render loop can draw with the programs that are ready and
+// call poll() once per frame for the rest.
+class ShaderBuildQueue {
+public:
+  // Builds go through `shader_cache` when given: programs it has stored are
+  // ready at submit(), and new ones are stored once linked.
+  explicit ShaderBuildQueue(ShaderCache *shader_cache = nullptr);
+  // Deletes the objects of builds still in progress.
+  ~ShaderBuildQueue();
+
+  ShaderBuildQueue(const ShaderBuildQueue &) = delete;
+  ShaderBuildQueue &operator=(const ShaderBuildQueue &) = delete;
+
+  // Returns the index of the build for program() and done().
+  std::size_t submit(const std::string &vertex_source,
+                     const std::string &fragment_source);
+
+  // Collects finished builds. Returns the number still in progress.
+  std::size_t poll();
+  // Waits for every build.
+  void finish();
+
+  // The linked program of a build, which the caller then owns; 0 while it is
+  // in progress or when it failed.
+  GLuint program(std::size_t index) const { return builds_[index].program; }
+  bool done(std::size_t index) const { return builds_[index].done; }
+  std::size_t pending() const { return pending_.size(); }
+
+  // Whether the driver compiles in parallel.
+  bool parallel() const { return parallel_; }
+
+private:
+  // Time poll() may block for when the driver does not build in parallel.
+  static constexpr double blocking_budget_ms{4.0};
+
+  struct Build {
+    GLuint program{0};
+    bool done{false};
+    // In progress only.
+    GLuint vertex_shader{0};
+    GLuint fragment_shader{0};
+    GLuint linking{0};
+    std::string vertex_source;
+    std::string fragment_source;
+  };
+
+  void finish_build(Build &build);
+
+  ShaderCache *shader_cache_;
+  bool parallel_;
+  std::vector<Build> builds_;
+  std::vector<std::size_t> pending_;
+};
+
+} // namespace common
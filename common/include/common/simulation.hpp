@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace common {
+
+// Calls a tick function at a fixed rate on a thread of its own, so the
+// simulation advances in equal steps however fast or slow the render loop
+// runs. Each call gets the time the tick was scheduled for. A thread that
+// falls behind runs up to max_catch_up ticks back to back and then drops the
+// rest, so a long stall cannot snowball.
+class SimulationThread {
+public:
+  using clock = std::chrono::steady_clock;
+
+  static constexpr int max_catch_up{8};
+
+  SimulationThread(clock::duration step,
+                   std::function<void(clock::time_point)> tick);
+  // Stops and joins the thread; a tick in progress runs to completion.
+  ~SimulationThread();
+
+  SimulationThread(const SimulationThread &) = delete;
+  SimulationThread &operator=(const SimulationThread &) = delete;
+
+  clock::duration step() const { return step_; }
+
+  // Ticks run so far.
+  std::uint64_t ticks() const { return ticks_.load(std::memory_order_relaxed); }
+
+  // Ticks skipped because the thread fell too far behind.
+  std::uint64_t dropped_ticks() const {
+    return dropped_ticks_.load(std::memory_order_relaxed);
+  }
+
+private:
+  void run();
+
+  clock::duration step_;
+  std::function<void(clock::time_point)> tick_;
+  std::atomic<std::uint64_t> ticks_{0};
+  std::atomic<std::uint64_t> dropped_ticks_{0};
+  std::mutex mutex_;
+  std::condition_variable stop_condition_;
+  bool stopping_{false};
+  std::thread thread_;
+};
+
+} // namespace common
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace common {
+
+// Hands the newest copy of some state from one writer thread to one reader
+// thread without either waiting for the other. The writer fills a private
+// slot and swaps it with a shared one; the reader swaps the shared slot for
+// its own when it holds something new. Snapshots the reader never picked up
+// are simply overwritten.
+template <class T> class SnapshotBuffer {
+public:
+  explicit SnapshotBuffer(const T &initial) { slots_.fill(initial); }
+
+  SnapshotBuffer(const SnapshotBuffer &) = delete;
+  SnapshotBuffer &operator=(const SnapshotBuffer &) = delete;
+
+  // Writer side.
+  void publish(const T &snapshot) {
+    slots_[back_] = snapshot;
+    back_ = middle_.exchange(back_ | fresh_bit, std::memory_order_acq_rel) &
+            index_mask;
+  }
+
+  // Reader side. The reference stays valid until the next call.
+  const T &latest() {
+    if (middle_.load(std::memory_order_relaxed) & fresh_bit) {
+      front_ = middle_.exchange(front_, std::memory_order_acq_rel) & index_mask;
+    }
+    return slots_[front_];
+  }
+
+private:
+  static constexpr std::uint8_t index_mask{3};
+  static constexpr std::uint8_t fresh_bit{4};
+
+  std::array<T, 3> slots_;
+  std::atomic<std::uint8_t> middle_{1};
+  std::uint8_t back_{0};
+  std::uint8_t front_{2};
+};
+
+} // namespace common
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <common/reflection.hpp>
+#include <common/shader.hpp>
+#include <common/stream_buffer.hpp>
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace common {
+
+// One axis-aligned textured quad, in the units of the projection passed to
+// SpriteBatcher::flush(), for example pixels.
+struct Sprite {
+  glm::vec2 min;
+  glm::vec2 max;
+  glm::vec2 uv_min{0.0f};
+  glm::vec2 uv_max{1.0f};
+  // RGBA8 with red in the lowest byte, multiplied with the texture.
+  std::uint32_t color{0xffffffff};
+  // Layer of a GL_TEXTURE_2D_ARRAY, ignored for GL_TEXTURE_2D.
+  std::uint32_t layer{0};
+};
+
+// Draws large numbers of sprites per frame with few draw calls. Queuing a
+// sprite only appends it to an array. flush() radix-sorts the queue by
+// texture and layer, expands every sprite into four vertices straight into
+// a StreamBuffer and draws each texture's sprites with one call, indexing
+// them through a static buffer of quad indices shared by all flushes. The
+// layers of a texture array therefore share a draw.
+//
+// Sprites of one texture and layer keep the order they were queued in, but
+// different textures are drawn in the order they were registered, so sprites
+// that must overlap in a given order should come from one texture (an atlas
+// or an array).
+class SpriteBatcher {
+public:
+  explicit SpriteBatcher(ShaderCache &shader_cache);
+  ~SpriteBatcher();
+
+  SpriteBatcher(const SpriteBatcher &) = delete;
+  SpriteBatcher &operator=(const SpriteBatcher &) = delete;
+
+  // What add_texture() returns once the sort key has no room for more
+  // textures. draw() ignores sprites with it.
+  static constexpr std::uint32_t invalid_texture{0xffffffff};
+
+  // Returns the handle draw() takes for `texture`, a GL_TEXTURE_2D or
+  // GL_TEXTURE_2D_ARRAY. Registering the same texture again returns the same
+  // handle.
+  std::uint32_t add_texture(GLuint texture, GLenum target = GL_TEXTURE_2D);
+
+  void draw(std::uint32_t texture, const Sprite &sprite) {
+    if (texture == invalid_texture) {
+      return;
+    }
+    sprites_.push_back(sprite);
+    textures_of_sprites_.push_back(texture);
+  }
+
+  // Sorts the queue and writes its vertices, the CPU side of flush(), which
+  // calls it when needed. Lets callers time the batching apart from the
+  // driver's work. Call flush() before the next draw().
+  void prepare();
+
+  // Draws the queued sprites with alpha blending and empties the queue.
+  // Leaves blending on and depth testing off. Each call uses the next region
+  // of the vertex buffer, so call it once per frame. Returns the number of
+  // draw calls issued.
+  int flush(const glm::mat4 &projection);
+
+  std::size_t size() const { return sprites_.size(); }
+
+private:
+  struct Texture {
+    GLuint texture;
+    GLenum target;
+  };
+
+  struct Entry {
+    std::uint32_t key;
+    std::uint32_t sprite;
+  };
+
+  // Sprites of one texture, consecutive in the vertex buffer.
+  struct Run {
+    std::uint32_t texture;
+    std::size_t first;
+    std::size_t count;
+  };
+
+  void sort();
+  void reserve_indices(std::size_t sprite_count);
+  void clear();
+
+  std::vector<Texture> textures_;
+  std::vector<Sprite> sprites_;
+  std::vector<std::uint32_t> textures_of_sprites_;
+  std::vector<Entry> entries_;
+  std::vector<Entry> scratch_;
+  std::vector<Run> runs_;
+  StreamBuffer::Allocation allocation_{};
+  bool prepared_{false};
+
+  // Indexed by target, GL_TEXTURE_2D first.
+  GLuint programs_[2]{};
+  Uniform<glm::mat4> projection_uniforms_[2];
+  GLuint vertex_array_{0};
+  GLuint index_buffer_{0};
+  std::size_t index_capacity_{0};
+  StreamBuffer vertex_buffer_;
+};
+
+} // namespace common
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glad/glad.h>
+
+namespace common {
+
+// Shadows the GL state that draws change most often (the program, vertex
+// array, buffer and texture bindings, blend and depth state and the
+// viewport) and skips the calls that would not change it. The shadow is
+// only right while every change to that state goes through the cache, so
+// the common library and the demos bind exclusively through gl_state().
+// Bindings start out unknown, so the first call for each is always issued.
+class StateCache {
+public:
+  struct Counters {
+    std::uint64_t issued{0};
+    std::uint64_t elided{0};
+  };
+
+  StateCache() { invalidate(); }
+
+  StateCache(const StateCache &) = delete;
+  StateCache &operator=(const StateCache &) = delete;
+
+  void use_program(GLuint program);
+  void bind_vertex_array(GLuint vertex_array);
+
+  // GL_ELEMENT_ARRAY_BUFFER is vertex array state and always passes through,
+  // as does any target the cache does not track.
+  void bind_buffer(GLenum target, GLuint buffer);
+  void bind_buffer_range(GLenum target, GLuint index, GLuint buffer,
+                         GLintptr offset, GLsizeiptr size);
+
+  // Also makes `unit` active, so that calls such as glTexParameteri that act
+  // on the active unit see the texture.
+  void bind_texture(GLuint unit, GLenum target, GLuint texture);
+
+  void set_enabled(GLenum capability, bool enabled);
+  void blend_func(GLenum source, GLenum destination);
+  void depth_func(GLenum function);
+  void depth_mask(bool write);
+  void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+  // Deleting a bound object unbinds it and frees its name for reuse, so
+  // call these after glDelete* of objects that may be bound.
+  void forget_program(GLuint program);
+  void forget_vertex_array(GLuint vertex_array);
+  void forget_buffer(GLuint buffer);
+  void forget_texture(GLuint texture);
+
+  // Marks everything unknown, for example after a new context was made
+  // current or code outside the cache changed state.
+  void invalidate();
+
+  const Counters &counters() const { return counters_; }
+  void reset_counters() { counters_ = {}; }
+
+private:
+  static constexpr GLuint unknown{~GLuint{0}};
+  static constexpr std::size_t buffer_target_count{6};
+  static constexpr std::size_t texture_target_count{3};
+  static constexpr std::size_t texture_unit_count{16};
+  static constexpr std::size_t uniform_binding_count{16};
+  static constexpr std::size_t capability_count{4};
+
+  struct BufferRange {
+    GLuint buffer;
+    GLintptr offset;
+    GLsizeiptr size;
+  };
+
+  // Counts the call and returns true when `value` differs from `shadow`,
+  // which is then updated.
+  template <class T> bool change(T &shadow, const T &value) {
+    if (shadow == value) {
+      ++counters_.elided;
+      return false;
+    }
+    shadow = value;
+    ++counters_.issued;
+    return true;
+  }
+
+  void active_texture(GLuint unit);
+
+  GLuint program_;
+  GLuint vertex_array_;
+  std::array<GLuint, buffer_target_count> buffers_;
+  std::array<BufferRange, uniform_binding_count> uniform_bindings_;
+  GLuint active_unit_;
+  std::array<std::array<GLuint, texture_target_count>, texture_unit_count>
+      textures_;
+  // 0 disabled, 1 enabled, -1 unknown.
+  std::array<int, capability_count> capabilities_;
+  std::array<GLenum, 2> blend_func_;
+  GLenum depth_func_;
+  int depth_mask_;
+  std::array<GLint, 4> viewport_;
+  Counters counters_;
+};
+
+// The cache of the calling thread's GL context. The demos have one context
+// on one thread; Context invalidates the cache when it creates its own.
+StateCache &gl_state();
+
+} // namespace common
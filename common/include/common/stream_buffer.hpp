@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <glad/glad.h>
+
+namespace common {
+
+// Per-frame dynamic data (uniform blocks, instance attributes, pixels) in
+// one buffer that is never waited on by the driver.
+//
+// With GL 4.4 or ARB_buffer_storage the buffer is mapped once, persistently
+// and coherently, and split into frame_count regions written round robin.
+// A fence after each frame's commands guards its region, so the CPU only
+// waits when it gets frame_count frames ahead of the GPU. On GL 3.3 the
+// buffer is orphaned with glBufferData at every begin_frame() instead and
+// ranges are mapped unsynchronized, one at a time.
+class StreamBuffer {
+public:
+  static constexpr std::size_t frame_count{3};
+
+  struct Allocation {
+    // nullptr when the frame's region is full.
+    void *data;
+    GLuint buffer;
+    GLintptr offset;
+    GLsizeiptr size;
+  };
+
+  // `target` is where the buffer is bound while it is created and mapped,
+  // for example GL_UNIFORM_BUFFER or GL_ARRAY_BUFFER.
+  StreamBuffer(GLenum target, std::size_t frame_capacity);
+  ~StreamBuffer();
+
+  StreamBuffer(const StreamBuffer &) = delete;
+  StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+  // Moves to the next region. Call before the first allocate() of a frame.
+  void begin_frame();
+  // Fences the region written since begin_frame(). Call after the last
+  // command that reads it.
+  void end_frame();
+
+  // Grows the per-frame capacity to at least `frame_capacity`, replacing
+  // the buffer. Only call between end_frame() and begin_frame().
+  void reserve(std::size_t frame_capacity);
+
+  Allocation allocate(std::size_t size, std::size_t alignment = 16);
+  // Makes an allocation visible to the GPU. Required before the next
+  // allocate() and before drawing with it; free with a persistent mapping.
+  void commit(const Allocation &allocation);
+
+  bool persistent() const { return persistent_; }
+  GLuint buffer() const { return buffer_; }
+  std::size_t frame_capacity() const { return frame_capacity_; }
+  // Number of begin_frame() calls that had to wait for the GPU.
+  std::uint64_t stalls() const { return stalls_; }
+
+private:
+  void create();
+  void destroy();
+
+  GLenum target_;
+  std::size_t frame_capacity_;
+  bool persistent_;
+  GLuint buffer_{0};
+  unsigned char *mapping_{nullptr};
+  std::array<GLsync, frame_count> fences_{};
+  std::size_t region_{0};
+  std::size_t used_{0};
+  std::uint64_t stalls_{0};
+};
+
+} // namespace common
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <common/texture_loader.hpp>
+#include <glad/glad.h>
+#include <string>
+
+namespace common {
+
+// Packs textures of one size into the layers of an RGBA8
+// GL_TEXTURE_2D_ARRAY with a full mip chain, so that objects with different
+// textures can share a draw call: each instance carries its layer index
+// (see InstancedRenderer) and the shader samples a sampler2DArray with it.
+// Layers fill in order and are never freed.
+class TextureArray {
+public:
+  // `capacity` is clamped to GL_MAX_ARRAY_TEXTURE_LAYERS.
+  TextureArray(int width, int height, int capacity);
+  ~TextureArray();
+
+  TextureArray(const TextureArray &) = delete;
+  TextureArray &operator=(const TextureArray &) = delete;
+
+  // Queues `path` for decoding into the next free layer. Returns the layer,
+  // or -1 when the array is full. The layer's contents are undefined until
+  // TextureLoader::update() has uploaded it.
+  int load(TextureLoader &loader, const std::string &path);
+
+  // Copies 8-bit pixels with 1 to 4 channels into the next free layer right
+  // away, building their mips on the CPU. Gray and gray-alpha pixels are
+  // expanded to RGBA first, so they sample as gray. Returns the layer, or -1
+  // when the array is full or the image has the wrong size.
+  int add(const unsigned char *pixels, int width, int height, int channels);
+
+  GLuint texture() const { return texture_; }
+  int width() const { return width_; }
+  int height() const { return height_; }
+  int size() const { return size_; }
+  int capacity() const { return capacity_; }
+
+private:
+  GLuint texture_{0};
+  int width_;
+  int height_;
+  int levels_;
+  int capacity_;
+  int size_{0};
+};
+
+} // namespace common
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+
+namespace common {
+
+// A .gtex file holds a texture exactly as the GPU wants it: a header, a level
+// table and the data of every mip level, already in the final (optionally
+// BCn-compressed) format. Uncompressed rows are padded to 4 bytes to match
+// the default GL_UNPACK_ALIGNMENT, and level data starts 16-byte aligned, so
+// the runtime maps the file and hands the levels to GL without touching them.
+constexpr std::uint32_t texture_file_magic{0x58455447}; // "GTEX"
+constexpr std::uint32_t texture_file_version{1};
+constexpr std::size_t texture_file_alignment{16};
+
+struct TextureFileHeader {
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::uint32_t internal_format;
+  // Both 0 for compressed formats.
+  std::uint32_t format;
+  std::uint32_t type;
+  std::uint32_t width;
+  std::uint32_t height;
+  std::uint32_t level_count;
+};
+
+struct TextureFileLevel {
+  std::uint64_t offset;
+  std::uint64_t size;
+  std::uint32_t width;
+  std::uint32_t height;
+};
+
+struct TextureLevelData {
+  std::uint32_t width;
+  std::uint32_t height;
+  std::vector<std::byte> data;
+};
+
+struct TextureData {
+  GLenum internal_format;
+  GLenum format;
+  GLenum type;
+  std::vector<TextureLevelData> levels;
+};
+
+bool is_compressed_format(GLenum internal_format);
+
+bool write_texture_file(const std::string &path, const TextureData &texture);
+
+// Maps the file and uploads all of its levels into the GL_TEXTURE_2D
+// straight from the mapping. Leaves the texture bound on the active unit.
+bool upload_texture_file(GLuint texture, const std::string &path);
+
+} // namespace common
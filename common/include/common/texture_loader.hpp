@@ -0,0 +1,90 @@
+#pragma once
+
+#include <common/mipmap.hpp>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <glad/glad.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace common {
+
+// Decodes images and builds their mip chains on a pool of worker threads, and
+// streams them into textures through a pixel buffer object. load() returns at
+// once with a texture that holds a 1x1 placeholder; update(), called once per
+// frame on the GL thread, replaces placeholders with the decoded images as
+// they become ready.
+// Precompiled .gtex files skip the workers and are uploaded by load() itself.
+class TextureLoader {
+public:
+  explicit TextureLoader(unsigned worker_count = default_worker_count());
+  ~TextureLoader();
+
+  TextureLoader(const TextureLoader &) = delete;
+  TextureLoader &operator=(const TextureLoader &) = delete;
+
+  // Returns a new GL_TEXTURE_2D; the caller owns it and sets its parameters.
+  // Leaves the texture bound to GL_TEXTURE_2D on the active texture unit.
+  GLuint load(const std::string &path);
+
+  // Fills layer `layer` of `array`, a GL_TEXTURE_2D_ARRAY with a full mip
+  // chain, the same way. The image must be `width` x `height`; others are
+  // reported and skipped. See TextureArray.
+  void load_layer(GLuint array, GLint layer, int width, int height,
+                  const std::string &path);
+
+  // Uploads decoded images until the per-frame byte budget is spent. Leaves
+  // the uploaded texture bound to its target on the active texture unit.
+  void update();
+
+  // Number of images that were requested but are not resident yet.
+  std::size_t pending() const { return pending_; }
+
+  static unsigned default_worker_count();
+
+private:
+  struct Job {
+    GLuint texture;
+    std::string path;
+    // -1 for a GL_TEXTURE_2D.
+    GLint layer{-1};
+    int layer_width{0};
+    int layer_height{0};
+  };
+
+  struct Image {
+    GLuint texture;
+    std::string path;
+    int width;
+    int height;
+    int channels;
+    unsigned char *pixels;
+    const char *failure_reason;
+    std::vector<MipmapLevel> mipmaps;
+    GLint layer{-1};
+    int layer_width{0};
+    int layer_height{0};
+  };
+
+  // Bound on the bytes copied into the PBO per frame so that a burst of
+  // finished images does not turn into one long frame.
+  static constexpr std::size_t upload_budget_bytes{16 << 20};
+
+  void work();
+  void upload(const Image &image);
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable job_available_;
+  std::deque<Job> jobs_;
+  std::deque<Image> decoded_;
+  bool stopping_{false};
+
+  std::size_t pending_{0};
+  GLuint pixel_buffer_{0};
+};
+
+} // namespace common
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <span>
+#include <vector>
+
+namespace common {
+
+// Position, rotation and scale of many objects, stored as one array per
+// component so that the composition kernels load eight objects with one
+// instruction. Arrays are padded to a multiple of eight with identity
+// transforms; the padding is never written out.
+class TransformStore {
+public:
+  // Objects composed per SIMD iteration.
+  static constexpr std::size_t batch_size{8};
+
+  std::size_t size() const { return size_; }
+
+  // Returns the index of the new object.
+  std::size_t add(const glm::vec3 &position, const glm::quat &rotation,
+                  const glm::vec3 &scale);
+  void clear();
+
+  void set_position(std::size_t index, const glm::vec3 &position);
+  // `rotation` must be normalized.
+  void set_rotation(std::size_t index, const glm::quat &rotation);
+  void set_scale(std::size_t index, const glm::vec3 &scale);
+
+  // Writes translate * rotate * scale of every object to `out`, which may
+  // be mapped buffer memory and needs no particular alignment.
+  void compose_world(glm::mat4 *out) const;
+  // Same, premultiplied by `view_projection`.
+  void compose_mvp(const glm::mat4 &view_projection, glm::mat4 *out) const;
+
+  // Same for only the objects in `indices`, written in that order, such as
+  // the visible ones. Indices must be below 2^31.
+  void compose_world(std::span<const std::uint32_t> indices,
+                     glm::mat4 *out) const;
+  void compose_mvp(const glm::mat4 &view_projection,
+                   std::span<const std::uint32_t> indices,
+                   glm::mat4 *out) const;
+
+private:
+  // indices == nullptr composes objects 0 to count - 1; view_projection ==
+  // nullptr writes world matrices.
+  void compose(const std::uint32_t *indices, std::size_t count,
+               const glm::mat4 *view_projection, glm::mat4 *out) const;
+
+  std::size_t size_{0};
+  std::vector<float> position_x_, position_y_, position_z_;
+  std::vector<float> rotation_x_, rotation_y_, rotation_z_, rotation_w_;
+  std::vector<float> scale_x_, scale_y_, scale_z_;
+};
+
+} // namespace common
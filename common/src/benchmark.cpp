@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <cmath>
+#include <common/benchmark.hpp>
+
+namespace common {
+
+namespace {
+
+struct Summary {
+  double min{0.0};
+  double median{0.0};
+  double p99{0.0};
+  double mean{0.0};
+};
+
+Summary summarize(std::vector<double> samples) {
+  Summary summary;
+  if (samples.empty()) {
+    return summary;
+  }
+  std::sort(samples.begin(), samples.end());
+  auto percentile{[&](double p) {
+    auto rank{static_cast<std::size_t>(std::ceil(p * samples.size()))};
+    return samples[std::clamp<std::size_t>(rank, 1, samples.size()) - 1];
+  }};
+  summary.min = samples.front();
+  summary.median = percentile(0.5);
+  summary.p99 = percentile(0.99);
+  for (auto sample : samples) {
+    summary.mean += sample;
+  }
+  summary.mean /= samples.size();
+  return summary;
+}
+
+void write_statistics(std::ostream &os, const std::vector<double> &samples) {
+  auto summary{summarize(samples)};
+  os << "{\"samples\": " << samples.size() << ", \"min\": " << summary.min
+     << ", \"median\": " << summary.median << ", \"p99\": " << summary.p99
+     << ", \"mean\": " << summary.mean << '}';
+}
+
+void write_summary(std::ostream &os, const char *key,
+                   const std::vector<double> &samples) {
+  os << "  \"" << key << "\": ";
+  write_statistics(os, samples);
+  os << ",\n";
+}
+
+} // namespace
+
+Benchmark::Benchmark() { glGenQueries(query_count, queries_.data()); }
+
+Benchmark::~Benchmark() { glDeleteQueries(query_count, queries_.data()); }
+
+void Benchmark::begin_frame() {
+  frame_start_ = clock::now();
+  if (frame_count_ == 0) {
+    record_event("first_frame");
+  }
+  if (frame_count_ == warmup_frames) {
+    run_start_ = frame_start_;
+  }
+
+  if (pending_[query_index_]) {
+    collect_query(query_index_, true);
+  }
+  glBeginQuery(GL_TIME_ELAPSED, queries_[query_index_]);
+}
+
+void Benchmark::end_frame() {
+  glEndQuery(GL_TIME_ELAPSED);
+  pending_[query_index_] = frame_count_ >= warmup_frames;
+  query_index_ = (query_index_ + 1) % query_count;
+
+  auto frame_end{clock::now()};
+  if (frame_count_++ >= warmup_frames) {
+    cpu_frame_ms_.push_back(
+        std::chrono::duration<double, std::milli>(frame_end - frame_start_)
+            .count());
+    run_time_ = frame_end - run_start_;
+  }
+
+  // Opportunistically pick up older results that are already available.
+  for (std::size_t i{0}; i < query_count; ++i) {
+    if (pending_[i]) {
+      collect_query(i, false);
+    }
+  }
+}
+
+void Benchmark::finish() {
+  for (std::size_t i{0}; i < query_count; ++i) {
+    auto index{(query_index_ + i) % query_count};
+    if (pending_[index]) {
+      collect_query(index, true);
+    }
+  }
+}
+
+void Benchmark::record_event(const std::string &name) {
+  events_.emplace_back(name, std::chrono::duration<double, std::milli>(
+                                 clock::now() - created_)
+                                 .count());
+}
+
+void Benchmark::add_counter(const std::string &name, std::uint64_t value) {
+  if (frame_count_ < warmup_frames) {
+    return;
+  }
+  for (auto &[counter, total] : counters_) {
+    if (counter == name) {
+      total += value;
+      return;
+    }
+  }
+  counters_.emplace_back(name, value);
+}
+
+void Benchmark::add_sample(const std::string &name, double value) {
+  if (frame_count_ < warmup_frames) {
+    return;
+  }
+  for (auto &[quantity, values] : samples_) {
+    if (quantity == name) {
+      values.push_back(value);
+      return;
+    }
+  }
+  samples_.emplace_back(name, std::vector<double>{value});
+}
+
+void Benchmark::collect_query(std::size_t index, bool wait) {
+  if (!wait) {
+    GLint available{GL_FALSE};
+    glGetQueryObjectiv(queries_[index], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+      return;
+    }
+  }
+  GLuint64 elapsed_ns{0};
+  glGetQueryObjectui64v(queries_[index], GL_QUERY_RESULT, &elapsed_ns);
+  gpu_frame_ms_.push_back(elapsed_ns / 1.0e6);
+  pending_[index] = false;
+}
+
+void Benchmark::write_json(std::ostream &os, const std::string &name) const {
+  auto run_seconds{std::chrono::duration<double>(run_time_).count()};
+  os << "{\n";
+  os << "  \"name\": \"" << name << "\",\n";
+  os << "  \"frames\": " << cpu_frame_ms_.size() << ",\n";
+  os << "  \"seconds\": " << run_seconds << ",\n";
+  write_summary(os, "cpu_frame_ms", cpu_frame_ms_);
+  write_summary(os, "gpu_frame_ms", gpu_frame_ms_);
+  os << "  \"events_ms\": {";
+  for (std::size_t i{0}; i < events_.size(); ++i) {
+    os << (i ? ", " : "") << '"' << events_[i].first
+       << "\": " << events_[i].second;
+  }
+  os << "},\n";
+  os << "  \"counters\": {";
+  for (std::size_t i{0}; i < counters_.size(); ++i) {
+    auto &[counter, total]{counters_[i]};
+    os << (i ? ", " : "") << '"' << counter << "\": {\"total\": " << total
+       << ", \"per_frame\": "
+       << (cpu_frame_ms_.empty() ? 0.0
+                                 : double(total) / cpu_frame_ms_.size())
+       << '}';
+  }
+  os << "},\n";
+  os << "  \"samples\": {";
+  for (std::size_t i{0}; i < samples_.size(); ++i) {
+    os << (i ? ", " : "") << '"' << samples_[i].first << "\": ";
+    write_statistics(os, samples_[i].second);
+  }
+  os << "},\n";
+  os << "  \"draw_calls\": " << draw_calls_ << ",\n";
+  os << "  \"draws_per_second\": "
+     << (run_seconds > 0.0 ? draw_calls_ / run_seconds : 0.0) << "\n";
+  os << "}\n";
+}
+
+} // namespace common
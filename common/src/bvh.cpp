@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <common/bvh.hpp>
+#include <numeric>
+
+namespace common {
+
+namespace {
+
+// Nodes in a subtree over `count` objects. Splits always halve the count, so
+// this depends on nothing else, which is what lets a subtree be rebuilt in
+// the space of the old one.
+std::uint32_t subtree_size(std::uint32_t count, std::uint32_t leaf_size) {
+  if (count <= leaf_size) {
+    return 1;
+  }
+  return 1 + subtree_size(count / 2, leaf_size) +
+         subtree_size(count - count / 2, leaf_size);
+}
+
+} // namespace
+
+void Bvh::build(std::span<const Aabb> bounds) {
+  bounds_.assign(bounds.begin(), bounds.end());
+  objects_.resize(bounds_.size());
+  std::iota(objects_.begin(), objects_.end(), 0u);
+  nodes_.clear();
+  dirty_ = false;
+  if (bounds_.empty()) {
+    return;
+  }
+  nodes_.resize(
+      subtree_size(static_cast<std::uint32_t>(bounds_.size()), leaf_size));
+  build_node(0, 0, static_cast<std::uint32_t>(bounds_.size()));
+}
+
+void Bvh::update(std::size_t index, const Aabb &bounds) {
+  bounds_[index] = bounds;
+  dirty_ = true;
+}
+
+int Bvh::refit() {
+  if (!dirty_) {
+    return 0;
+  }
+  dirty_ = false;
+  // Children always come after their parent.
+  for (auto i{nodes_.size()}; i-- > 0;) {
+    auto &node{nodes_[i]};
+    if (node.right) {
+      node.bounds = merge(nodes_[i + 1].bounds, nodes_[node.right].bounds);
+    } else {
+      node.bounds = bounds_[objects_[node.first]];
+      for (std::uint32_t j{1}; j < node.count; ++j) {
+        node.bounds = merge(node.bounds, bounds_[objects_[node.first + j]]);
+      }
+    }
+  }
+  return nodes_.empty() ? 0 : rebuild_degraded(0);
+}
+
+void Bvh::cull(const Frustum &frustum,
+               std::vector<std::uint32_t> &visible) const {
+  if (nodes_.empty()) {
+    return;
+  }
+  std::uint32_t stack[64];
+  std::size_t depth{0};
+  stack[depth++] = 0;
+  while (depth > 0) {
+    auto &node{nodes_[stack[--depth]]};
+    auto containment{frustum.classify(node.bounds)};
+    if (containment == Containment::outside) {
+      continue;
+    }
+    if (containment == Containment::inside) {
+      // Everything below is visible; no need to test it.
+      visible.insert(visible.end(), objects_.begin() + node.first,
+                     objects_.begin() + node.first + node.count);
+      continue;
+    }
+    if (node.right) {
+      stack[depth++] = node.right;
+      stack[depth++] = static_cast<std::uint32_t>(&node - nodes_.data()) + 1;
+      continue;
+    }
+    for (std::uint32_t j{0}; j < node.count; ++j) {
+      auto object{objects_[node.first + j]};
+      if (frustum.classify(bounds_[object]) != Containment::outside) {
+        visible.push_back(object);
+      }
+    }
+  }
+}
+
+std::uint32_t Bvh::build_node(std::uint32_t index, std::uint32_t first,
+                              std::uint32_t count) {
+  auto begin{objects_.begin() + first};
+  auto end{begin + count};
+  auto &node{nodes_[index]};
+  node.first = first;
+  node.count = count;
+  node.bounds = bounds_[*begin];
+  auto centers{Aabb{bounds_[*begin].min + bounds_[*begin].max,
+                    bounds_[*begin].min + bounds_[*begin].max}};
+  for (auto it{begin + 1}; it != end; ++it) {
+    node.bounds = merge(node.bounds, bounds_[*it]);
+    auto center{bounds_[*it].min + bounds_[*it].max};
+    centers = merge(centers, {center, center});
+  }
+  node.built_area = surface_area(node.bounds);
+
+  if (count <= leaf_size) {
+    node.right = 0;
+    return index + 1;
+  }
+
+  // Median split along the axis where the centers spread the most.
+  auto spread{centers.max - centers.min};
+  auto axis{spread.x > spread.y ? (spread.x > spread.z ? 0 : 2)
+                                : (spread.y > spread.z ? 1 : 2)};
+  std::nth_element(begin, begin + count / 2, end,
+                   [&](std::uint32_t a, std::uint32_t b) {
+                     return bounds_[a].min[axis] + bounds_[a].max[axis] <
+                            bounds_[b].min[axis] + bounds_[b].max[axis];
+                   });
+  auto right{build_node(index + 1, first, count / 2)};
+  // nodes_ is sized up front, so `node` survives the recursion.
+  node.right = right;
+  return build_node(right, first + count / 2, count - count / 2);
+}
+
+int Bvh::rebuild_degraded(std::uint32_t index) {
+  auto &node{nodes_[index]};
+  if (!node.right) {
+    return 0;
+  }
+  if (surface_area(node.bounds) > rebuild_factor * node.built_area) {
+    build_node(index, node.first, node.count);
+    return 1;
+  }
+  return rebuild_degraded(index + 1) + rebuild_degraded(node.right);
+}
+
+} // namespace common
@@ -0,0 +1,402 @@
+#include <common/context.hpp>
+#include <common/image.hpp>
+#include <common/log.hpp>
+#include <common/state_cache.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#ifdef COMMON_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+namespace common {
+
+static constexpr int default_headless_frames{300};
+
+// The version every demo needs, and the one GPU culling needs.
+static constexpr int base_gl_version[]{3, 3};
+static constexpr int gpu_culling_gl_version[]{4, 3};
+
+Options parse_options(int argc, char **argv) {
+  Options options;
+  for (int i{1}; i < argc; ++i) {
+    auto has_value{i + 1 < argc};
+    if (std::strcmp(argv[i], "--headless") == 0) {
+      options.headless = true;
+    } else if (std::strcmp(argv[i], "--frames") == 0 && has_value) {
+      options.frames = std::atoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--benchmark") == 0 && has_value) {
+      options.benchmark_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--shader-cache") == 0 && has_value) {
+      options.shader_cache_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--texture") == 0 && has_value) {
+      options.texture_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--instances") == 0 && has_value) {
+      options.instances = std::atoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--trace") == 0 && has_value) {
+      options.trace_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--mesh") == 0 && has_value) {
+      options.mesh_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--fixed-clock") == 0) {
+      options.fixed_clock = true;
+    } else if (std::strcmp(argv[i], "--capture") == 0 && has_value) {
+      options.capture_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--gpu-culling") == 0) {
+      options.gpu_culling = true;
+    } else {
+      log_warning("Ignoring unknown argument: {}", argv[i]);
+    }
+  }
+  if (options.headless && options.frames <= 0) {
+    options.frames = default_headless_frames;
+  }
+  return options;
+}
+
+std::unique_ptr<Context> Context::create(const std::string &title, int width,
+                                         int height, const Options &options) {
+  std::unique_ptr<Context> context{new Context(title, width, height, options)};
+  // The new GL context shares no state with anything the cache saw before.
+  gl_state().invalidate();
+  auto initialized{options.headless ? context->init_headless()
+                                    : context->init_window()};
+  if (!initialized) {
+    return nullptr;
+  }
+  if (!options.benchmark_path.empty()) {
+    context->benchmark_ = std::make_unique<Benchmark>();
+  }
+  context->profiler_ =
+      std::make_unique<Profiler>(!options.trace_path.empty());
+  auto shader_cache_path{
+      options.shader_cache_path.empty()
+          ? std::filesystem::temp_directory_path() / "LearnOpenGL-shaders"
+          : std::filesystem::path{options.shader_cache_path}};
+  context->shader_cache_ = std::make_unique<ShaderCache>(shader_cache_path);
+  return context;
+}
+
+Context::Context(const std::string &title, int width, int height,
+                 const Options &options)
+    : title_{title}, width_{width}, height_{height}, options_{options},
+      start_time_{std::chrono::steady_clock::now()} {}
+
+Context::~Context() {
+  benchmark_.reset();
+  profiler_.reset();
+  texture_loader_.reset();
+
+  if (framebuffer_) {
+    glDeleteFramebuffers(1, &framebuffer_);
+    glDeleteRenderbuffers(1, &color_renderbuffer_);
+    glDeleteRenderbuffers(1, &depth_renderbuffer_);
+  }
+
+#ifdef COMMON_HAS_EGL
+  if (egl_display_) {
+    eglMakeCurrent(egl_display_, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                   EGL_NO_CONTEXT);
+    if (egl_context_) {
+      eglDestroyContext(egl_display_, egl_context_);
+    }
+    eglTerminate(egl_display_);
+  }
+#endif
+
+  if (window_) {
+    glfwDestroyWindow(window_);
+  }
+  if (glfw_initialized_) {
+    glfwTerminate();
+  }
+}
+
+bool Context::init_window() {
+  glfwSetErrorCallback([](int error_code, const char *description) {
+    log_error("error_code: {} description: {}", error_code, description);
+  });
+
+  if (!glfwInit()) {
+    log_error("Failed to initialize glfw");
+    return false;
+  }
+  glfw_initialized_ = true;
+
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+  auto create_window{[&](const int (&version)[2]) {
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version[0]);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version[1]);
+    window_ =
+        glfwCreateWindow(width_, height_, title_.c_str(), nullptr, nullptr);
+  }};
+  if (options_.gpu_culling) {
+    create_window(gpu_culling_gl_version);
+  }
+  if (!window_) {
+    create_window(base_gl_version);
+  }
+  if (!window_) {
+    log_error("Failed to create window");
+    return false;
+  }
+
+  glfwMakeContextCurrent(window_);
+
+  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+    log_error("Failed to initialize OpenGL context");
+    return false;
+  }
+
+  // Vsync would cap every measurement at the refresh rate.
+  if (!options_.benchmark_path.empty()) {
+    glfwSwapInterval(0);
+  }
+
+  glfwSetFramebufferSizeCallback(window_,
+                                 [](GLFWwindow *window, int width, int height) {
+                                   gl_state().viewport(0, 0, width, height);
+                                 });
+
+  glfwSetKeyCallback(window_, [](GLFWwindow *window, int key, int scancode,
+                                 int action, int mods) {
+    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
+      glfwSetWindowShouldClose(window, GLFW_TRUE);
+    }
+  });
+
+  return true;
+}
+
+bool Context::init_headless() {
+#ifdef COMMON_HAS_EGL
+  EGLDisplay display{EGL_NO_DISPLAY};
+  auto get_platform_display{reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+      eglGetProcAddress("eglGetPlatformDisplayEXT"))};
+  if (get_platform_display) {
+    display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                   EGL_DEFAULT_DISPLAY, nullptr);
+  }
+  if (display == EGL_NO_DISPLAY) {
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+    log_error("Failed to initialize EGL display");
+    return false;
+  }
+  egl_display_ = display;
+
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    log_error("Failed to bind the OpenGL API");
+    return false;
+  }
+
+  const EGLint config_attributes[]{
+      EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+      EGL_NONE,
+  };
+  EGLConfig config;
+  EGLint config_count{0};
+  if (!eglChooseConfig(display, config_attributes, &config, 1,
+                       &config_count) ||
+      config_count == 0) {
+    log_error("Failed to choose EGL config");
+    return false;
+  }
+
+  auto create_context{[&](const int (&version)[2]) {
+    const EGLint context_attributes[]{
+        EGL_CONTEXT_MAJOR_VERSION,
+        version[0],
+        EGL_CONTEXT_MINOR_VERSION,
+        version[1],
+        EGL_CONTEXT_OPENGL_PROFILE_MASK,
+        EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE,
+    };
+    egl_context_ =
+        eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+  }};
+  if (options_.gpu_culling) {
+    create_context(gpu_culling_gl_version);
+  }
+  if (egl_context_ == EGL_NO_CONTEXT) {
+    create_context(base_gl_version);
+  }
+  if (egl_context_ == EGL_NO_CONTEXT) {
+    log_error("Failed to create EGL context");
+    return false;
+  }
+
+  // Surfaceless: all rendering goes to the offscreen framebuffer below.
+  if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, egl_context_)) {
+    log_error("Failed to make EGL context current");
+    return false;
+  }
+
+  if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+    log_error("Failed to initialize OpenGL context");
+    return false;
+  }
+
+  return init_framebuffer();
+#else
+  log_error("Headless mode requires EGL");
+  return false;
+#endif
+}
+
+bool Context::init_framebuffer() {
+  glGenFramebuffers(1, &framebuffer_);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+
+  glGenRenderbuffers(1, &color_renderbuffer_);
+  glBindRenderbuffer(GL_RENDERBUFFER, color_renderbuffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width_, height_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, color_renderbuffer_);
+
+  glGenRenderbuffers(1, &depth_renderbuffer_);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width_, height_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER, depth_renderbuffer_);
+
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    log_error("Failed to create offscreen framebuffer");
+    return false;
+  }
+
+  gl_state().viewport(0, 0, width_, height_);
+  return true;
+}
+
+TextureLoader &Context::texture_loader() {
+  if (!texture_loader_) {
+    texture_loader_ = std::make_unique<TextureLoader>();
+  }
+  return *texture_loader_;
+}
+
+double Context::time() const {
+  if (options_.fixed_clock) {
+    return frame_ / 60.0;
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start_time_)
+      .count();
+}
+
+bool Context::begin_frame() {
+  auto done{(window_ && glfwWindowShouldClose(window_)) ||
+            (options_.frames > 0 && frame_ >= options_.frames)};
+  if (done) {
+    finish();
+    return false;
+  }
+
+  if (benchmark_) {
+    benchmark_->begin_frame();
+  }
+  profiler_->begin_frame();
+  if (texture_loader_) {
+    CpuZone zone{*profiler_, "texture_uploads"};
+    texture_loader_->update();
+    // Whether a texture makes it into a frame must not depend on how fast
+    // the workers decode it.
+    while (options_.fixed_clock && texture_loader_->pending() > 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+      texture_loader_->update();
+    }
+    if (!textures_resident_ && texture_loader_->pending() == 0) {
+      textures_resident_ = true;
+      if (benchmark_) {
+        benchmark_->record_event("textures_resident");
+      }
+    }
+  }
+  return true;
+}
+
+void Context::end_frame() {
+  if (!options_.capture_path.empty() && frame_ + 1 == options_.frames) {
+    capture();
+  }
+  {
+    CpuZone zone{*profiler_, "present"};
+    if (window_) {
+      glfwSwapBuffers(window_);
+      glfwPollEvents();
+    } else {
+      glFlush();
+    }
+  }
+  profiler_->end_frame();
+  if (window_ && std::chrono::steady_clock::now() - title_time_ >
+                     std::chrono::milliseconds{500}) {
+    title_time_ = std::chrono::steady_clock::now();
+    glfwSetWindowTitle(window_,
+                       (title_ + " | " + profiler_->summary()).c_str());
+  }
+
+  auto &state{gl_state()};
+  if (benchmark_) {
+    benchmark_->add_counter("gl_state_calls_issued", state.counters().issued);
+    benchmark_->add_counter("gl_state_calls_elided", state.counters().elided);
+    benchmark_->end_frame();
+  }
+  state.reset_counters();
+  ++frame_;
+}
+
+// Reads back the frame before it is presented, which leaves a window's back
+// buffer undefined.
+void Context::capture() {
+  int width{width_}, height{height_};
+  if (window_) {
+    glfwGetFramebufferSize(window_, &width, &height);
+  }
+  write_ppm(options_.capture_path, read_framebuffer(width, height));
+}
+
+void Context::finish() {
+  if (finished_) {
+    return;
+  }
+  finished_ = true;
+
+  if (!options_.trace_path.empty()) {
+    std::ofstream trace{options_.trace_path};
+    if (trace) {
+      profiler_->write_trace(trace);
+    } else {
+      log_error("Failed to open {}", options_.trace_path);
+    }
+  }
+  if (!benchmark_) {
+    return;
+  }
+
+  benchmark_->finish();
+  if (options_.benchmark_path == "-") {
+    // Keeps messages logged during the run ahead of the report.
+    flush_log();
+    benchmark_->write_json(std::cout, title_);
+    return;
+  }
+  std::ofstream file{options_.benchmark_path};
+  if (!file) {
+    log_error("Failed to open {}", options_.benchmark_path);
+    return;
+  }
+  benchmark_->write_json(file, title_);
+}
+
+} // namespace common
@@ -0,0 +1,112 @@
+#include <array>
+#include <common/draw_list.hpp>
+#include <common/state_cache.hpp>
+#include <utility>
+
+namespace common {
+
+namespace {
+
+template <class T> void upload(GLint location, const std::byte *data) {
+  T value;
+  std::memcpy(&value, data, sizeof(T));
+  UniformTraits<T>::upload(location, value);
+}
+
+void upload(GLint location, GLenum type, const std::byte *data) {
+  switch (type) {
+  case GL_FLOAT:
+    upload<float>(location, data);
+    break;
+  case GL_INT:
+    upload<int>(location, data);
+    break;
+  case GL_FLOAT_VEC2:
+    upload<glm::vec2>(location, data);
+    break;
+  case GL_FLOAT_VEC3:
+    upload<glm::vec3>(location, data);
+    break;
+  case GL_FLOAT_VEC4:
+    upload<glm::vec4>(location, data);
+    break;
+  case GL_FLOAT_MAT4:
+    upload<glm::mat4>(location, data);
+    break;
+  }
+}
+
+} // namespace
+
+void DrawList::draw(const DrawState &state, GLsizei index_count,
+                    std::uint32_t first_index, std::uint16_t depth) {
+  auto key{std::uint64_t{state.program & 0xffffu} << 48 |
+           std::uint64_t{state.vertex_array & 0xffffu} << 32 |
+           std::uint64_t{state.texture & 0xffffu} << 16 | depth};
+  packets_.push_back({key, state, index_count, first_index,
+                      static_cast<std::uint32_t>(uniforms_.size()), 0});
+}
+
+// LSD radix sort on bytes. All eight histograms come from one pass over the
+// keys, and passes whose byte is the same for every key are skipped, which
+// with few distinct states is most of them.
+void DrawQueue::sort() {
+  constexpr std::size_t digits{sizeof(std::uint64_t)};
+  std::array<std::array<std::uint32_t, 256>, digits> counts{};
+  for (auto &entry : entries_) {
+    for (std::size_t d{0}; d < digits; ++d) {
+      ++counts[d][(entry.key >> (8 * d)) & 0xff];
+    }
+  }
+
+  scratch_.resize(entries_.size());
+  for (std::size_t d{0}; d < digits; ++d) {
+    auto &count{counts[d]};
+    if (count[(entries_.front().key >> (8 * d)) & 0xff] == entries_.size()) {
+      continue;
+    }
+    std::uint32_t offset{0};
+    for (auto &bucket : count) {
+      offset += std::exchange(bucket, offset);
+    }
+    for (auto &entry : entries_) {
+      scratch_[count[(entry.key >> (8 * d)) & 0xff]++] = entry;
+    }
+    entries_.swap(scratch_);
+  }
+}
+
+int DrawQueue::submit(std::span<const DrawList> lists) {
+  entries_.clear();
+  for (std::uint32_t l{0}; l < lists.size(); ++l) {
+    auto &packets{lists[l].packets_};
+    for (std::uint32_t p{0}; p < packets.size(); ++p) {
+      entries_.push_back({packets[p].key, l, p});
+    }
+  }
+  if (entries_.empty()) {
+    return 0;
+  }
+  sort();
+
+  auto &state{gl_state()};
+  for (auto &entry : entries_) {
+    auto &list{lists[entry.list]};
+    auto &packet{list.packets_[entry.packet]};
+    state.use_program(packet.state.program);
+    state.bind_vertex_array(packet.state.vertex_array);
+    state.bind_texture(0, GL_TEXTURE_2D, packet.state.texture);
+
+    for (auto u{packet.uniform_begin};
+         u < packet.uniform_begin + packet.uniform_count; ++u) {
+      auto &uniform{list.uniforms_[u]};
+      upload(uniform.location, uniform.type,
+             list.data_.data() + uniform.offset);
+    }
+    glDrawElements(GL_TRIANGLES, packet.index_count, GL_UNSIGNED_INT,
+                   (void *)(packet.first_index * sizeof(GLuint)));
+  }
+  return static_cast<int>(entries_.size());
+}
+
+} // namespace common
@@ -0,0 +1,121 @@
+#include <cmath>
+#include <common/frustum.hpp>
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define COMMON_FRUSTUM_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define COMMON_FRUSTUM_SSE
+#endif
+
+namespace common {
+
+Aabb merge(const Aabb &a, const Aabb &b) {
+  return {glm::min(a.min, b.min), glm::max(a.max, b.max)};
+}
+
+float surface_area(const Aabb &box) {
+  auto size{box.max - box.min};
+  return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+Frustum::Frustum(const glm::mat4 &view_projection) {
+  // Gribb and Hartmann: each plane is the last row of the matrix plus or
+  // minus one of the other rows, with the normal pointing inwards.
+  auto row{[&](int r) {
+    return glm::vec4(view_projection[0][r], view_projection[1][r],
+                     view_projection[2][r], view_projection[3][r]);
+  }};
+  const glm::vec4 planes[]{
+      row(3) + row(0), row(3) - row(0), row(3) + row(1),
+      row(3) - row(1), row(3) + row(2), row(3) - row(2),
+  };
+  for (int i{0}; i < padded_plane_count; ++i) {
+    // The padding planes contain everything.
+    auto plane{i < 6 ? planes[i] : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)};
+    auto length{glm::length(glm::vec3(plane))};
+    if (length > 0.0f) {
+      plane /= length;
+    }
+    x_[i] = plane.x;
+    y_[i] = plane.y;
+    z_[i] = plane.z;
+    w_[i] = plane.w;
+  }
+}
+
+Containment Frustum::classify(const Aabb &box) const {
+  auto center{0.5f * (box.max + box.min)};
+  auto extent{0.5f * (box.max - box.min)};
+  // Per plane: distance of the center, and the projected radius of the box
+  // onto the normal. Outside when distance + radius < 0 for any plane,
+  // inside when distance - radius >= 0 for all of them.
+#if defined(COMMON_FRUSTUM_AVX2)
+  auto sign_mask{_mm256_set1_ps(-0.0f)};
+  auto x{_mm256_load_ps(x_)}, y{_mm256_load_ps(y_)}, z{_mm256_load_ps(z_)};
+  auto distance{_mm256_fmadd_ps(
+      x, _mm256_set1_ps(center.x),
+      _mm256_fmadd_ps(y, _mm256_set1_ps(center.y),
+                      _mm256_fmadd_ps(z, _mm256_set1_ps(center.z),
+                                      _mm256_load_ps(w_))))};
+  auto radius{_mm256_fmadd_ps(
+      _mm256_andnot_ps(sign_mask, x), _mm256_set1_ps(extent.x),
+      _mm256_fmadd_ps(
+          _mm256_andnot_ps(sign_mask, y), _mm256_set1_ps(extent.y),
+          _mm256_mul_ps(_mm256_andnot_ps(sign_mask, z),
+                        _mm256_set1_ps(extent.z))))};
+  auto zero{_mm256_setzero_ps()};
+  if (_mm256_movemask_ps(_mm256_cmp_ps(_mm256_add_ps(distance, radius), zero,
+                                       _CMP_LT_OQ))) {
+    return Containment::outside;
+  }
+  if (_mm256_movemask_ps(_mm256_cmp_ps(_mm256_sub_ps(distance, radius), zero,
+                                       _CMP_LT_OQ))) {
+    return Containment::intersecting;
+  }
+  return Containment::inside;
+#elif defined(COMMON_FRUSTUM_SSE)
+  auto sign_mask{_mm_set1_ps(-0.0f)};
+  auto zero{_mm_setzero_ps()};
+  int outside{0}, intersecting{0};
+  for (int i{0}; i < padded_plane_count; i += 4) {
+    auto x{_mm_load_ps(x_ + i)}, y{_mm_load_ps(y_ + i)},
+        z{_mm_load_ps(z_ + i)};
+    auto distance{_mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(center.x)),
+                   _mm_mul_ps(y, _mm_set1_ps(center.y))),
+        _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(center.z)), _mm_load_ps(w_ + i)))};
+    auto radius{_mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign_mask, x),
+                              _mm_set1_ps(extent.x)),
+                   _mm_mul_ps(_mm_andnot_ps(sign_mask, y),
+                              _mm_set1_ps(extent.y))),
+        _mm_mul_ps(_mm_andnot_ps(sign_mask, z), _mm_set1_ps(extent.z)))};
+    outside |=
+        _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+    intersecting |=
+        _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(distance, radius), zero));
+  }
+  if (outside) {
+    return Containment::outside;
+  }
+  return intersecting ? Containment::intersecting : Containment::inside;
+#else
+  auto result{Containment::inside};
+  for (int i{0}; i < padded_plane_count; ++i) {
+    auto distance{x_[i] * center.x + y_[i] * center.y + z_[i] * center.z +
+                  w_[i]};
+    auto radius{std::abs(x_[i]) * extent.x + std::abs(y_[i]) * extent.y +
+                std::abs(z_[i]) * extent.z};
+    if (distance + radius < 0.0f) {
+      return Containment::outside;
+    }
+    if (distance - radius < 0.0f) {
+      result = Containment::intersecting;
+    }
+  }
+  return result;
+#endif
+}
+
+} // namespace common
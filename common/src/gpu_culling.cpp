@@ -0,0 +1,409 @@
+#include <algorithm>
+#include <common/gpu_culling.hpp>
+#include <common/shader.hpp>
+#include <common/state_cache.hpp>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace common {
+
+namespace {
+
+// Out of the way of the units demos bind their own textures to.
+constexpr GLuint depth_unit{15};
+
+constexpr GLuint cull_group_size{64};
+constexpr GLuint reduce_group_size{8};
+
+struct DrawElementsIndirectCommand {
+  GLuint count;
+  GLuint instance_count;
+  GLuint first_index;
+  GLint base_vertex;
+  GLuint base_instance;
+};
+
+// One invocation per object. The commands of visible objects are appended
+// through the atomic counter when u_pack is set, and written to the
+// object's own slot otherwise.
+const std::string cull_shader_source =
+    "#version 430 core\n"
+    "layout (local_size_x = 64) in;\n"
+    "\n"
+    "struct DrawCommand {\n"
+    "  uint count;\n"
+    "  uint instance_count;\n"
+    "  uint first_index;\n"
+    "  int base_vertex;\n"
+    "  uint base_instance;\n"
+    "};\n"
+    "\n"
+    "layout (std430, binding = 0) readonly buffer Objects {\n"
+    "  vec4 objects[];\n"
+    "};\n"
+    "layout (std430, binding = 1) writeonly buffer Commands {\n"
+    "  DrawCommand commands[];\n"
+    "};\n"
+    "layout (std430, binding = 2) buffer Count { uint draw_count; };\n"
+    "layout (binding = 15) uniform sampler2D u_depth;\n"
+    "\n"
+    "uniform mat4 u_view_projection;\n"
+    "uniform mat4 u_depth_view_projection;\n"
+    "uniform int u_object_count;\n"
+    "uniform int u_index_count;\n"
+    "uniform int u_first_index;\n"
+    "uniform int u_occlusion;\n"
+    "uniform int u_pack;\n"
+    "\n"
+    "bool in_frustum(vec4 sphere)\n"
+    "{\n"
+    "  mat4 rows = transpose(u_view_projection);\n"
+    "  for (int i = 0; i < 6; ++i) {\n"
+    "    vec4 plane = rows[3] + (i % 2 == 0 ? 1.0 : -1.0) * rows[i / 2];\n"
+    "    plane /= length(plane.xyz);\n"
+    "    if (dot(plane.xyz, sphere.xyz) + plane.w < -sphere.w) {\n"
+    "      return false;\n"
+    "    }\n"
+    "  }\n"
+    "  return true;\n"
+    "}\n"
+    "\n"
+    // The box around the sphere as the pyramid's camera saw it, against the
+    // farthest depth of the at most 2x2 texels of the level where it is
+    // about one texel big. Boxes that reach behind the camera or off the
+    // screen are never occluded.
+    "bool occluded(vec4 sphere)\n"
+    "{\n"
+    "  vec2 uv_min = vec2(1.0);\n"
+    "  vec2 uv_max = vec2(0.0);\n"
+    "  float nearest = 1.0;\n"
+    "  for (int i = 0; i < 8; ++i) {\n"
+    "    vec3 corner = vec3((i & 1) != 0 ? 1.0 : -1.0,\n"
+    "                       (i & 2) != 0 ? 1.0 : -1.0,\n"
+    "                       (i & 4) != 0 ? 1.0 : -1.0);\n"
+    "    vec4 clip = u_depth_view_projection *\n"
+    "                vec4(sphere.xyz + sphere.w * corner, 1.0);\n"
+    "    if (clip.w <= 0.0) {\n"
+    "      return false;\n"
+    "    }\n"
+    "    vec3 window = clip.xyz / clip.w * 0.5 + 0.5;\n"
+    "    uv_min = min(uv_min, window.xy);\n"
+    "    uv_max = max(uv_max, window.xy);\n"
+    "    nearest = min(nearest, window.z);\n"
+    "  }\n"
+    "  if (any(lessThan(uv_min, vec2(0.0))) ||\n"
+    "      any(greaterThan(uv_max, vec2(1.0)))) {\n"
+    "    return false;\n"
+    "  }\n"
+    "  ivec2 base_size = textureSize(u_depth, 0);\n"
+    "  vec2 extent = (uv_max - uv_min) * vec2(base_size);\n"
+    "  int level = int(ceil(log2(max(max(extent.x, extent.y), 1.0))));\n"
+    "  level = min(level, textureQueryLevels(u_depth) - 1);\n"
+    "  ivec2 size = max(base_size >> level, ivec2(1));\n"
+    "  ivec2 low = min(ivec2(uv_min * vec2(size)), size - 1);\n"
+    "  ivec2 high = min(ivec2(uv_max * vec2(size)), size - 1);\n"
+    "  float farthest = max(\n"
+    "      max(texelFetch(u_depth, low, level).r,\n"
+    "          texelFetch(u_depth, ivec2(high.x, low.y), level).r),\n"
+    "      max(texelFetch(u_depth, ivec2(low.x, high.y), level).r,\n"
+    "          texelFetch(u_depth, high, level).r));\n"
+    "  return nearest > farthest;\n"
+    "}\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "  uint object = gl_GlobalInvocationID.x;\n"
+    "  if (object >= uint(u_object_count)) {\n"
+    "    return;\n"
+    "  }\n"
+    "  vec4 sphere = objects[object];\n"
+    "  bool visible = in_frustum(sphere) &&\n"
+    "                 (u_occlusion == 0 || !occluded(sphere));\n"
+    "  DrawCommand command = DrawCommand(uint(u_index_count),\n"
+    "                                    visible ? 1u : 0u,\n"
+    "                                    uint(u_first_index), 0, object);\n"
+    "  if (u_pack == 0) {\n"
+    "    commands[object] = command;\n"
+    "  }\n"
+    "  if (visible) {\n"
+    "    uint slot = atomicAdd(draw_count, 1u);\n"
+    "    if (u_pack != 0) {\n"
+    "      commands[slot] = command;\n"
+    "    }\n"
+    "  }\n"
+    "}";
+
+// Each texel of a level takes the farthest depth of the texels of the level
+// above that it covers: two or three per axis, as levels round their size
+// down. Level 0 is made from the depth texture the same way. Both shaders
+// derive the size of a level from level 0's, as GL defines it, because
+// textureSize() of a level returned level 0's size on llvmpipe.
+const std::string reduce_shader_source =
+    "#version 430 core\n"
+    "layout (local_size_x = 8, local_size_y = 8) in;\n"
+    "\n"
+    "layout (binding = 15) uniform sampler2D u_source;\n"
+    "layout (r32f, binding = 0) writeonly uniform image2D u_destination;\n"
+    "\n"
+    "uniform int u_source_level;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "  ivec2 texel = ivec2(gl_GlobalInvocationID.xy);\n"
+    "  ivec2 size = imageSize(u_destination);\n"
+    "  if (any(greaterThanEqual(texel, size))) {\n"
+    "    return;\n"
+    "  }\n"
+    "  ivec2 source_size =\n"
+    "      max(textureSize(u_source, 0) >> u_source_level, ivec2(1));\n"
+    "  ivec2 begin = texel * source_size / size;\n"
+    "  ivec2 end = ((texel + 1) * source_size + size - 1) / size;\n"
+    "  float farthest = 0.0;\n"
+    "  for (int y = begin.y; y < end.y; ++y) {\n"
+    "    for (int x = begin.x; x < end.x; ++x) {\n"
+    "      farthest = max(farthest,\n"
+    "                     texelFetch(u_source, ivec2(x, y),\n"
+    "                                u_source_level).r);\n"
+    "    }\n"
+    "  }\n"
+    "  imageStore(u_destination, texel, vec4(farthest));\n"
+    "}";
+
+GLuint group_count(int size, GLuint group_size) {
+  return (static_cast<GLuint>(size) + group_size - 1) / group_size;
+}
+
+} // namespace
+
+bool GpuCuller::supported() { return GLAD_GL_VERSION_4_3; }
+
+GpuCuller::GpuCuller()
+    : packs_commands_{GLAD_GL_ARB_indirect_parameters != 0},
+      cull_program_{compile_compute_program(cull_shader_source)},
+      reduce_program_{compile_compute_program(reduce_shader_source)} {
+  if (cull_program_) {
+    ProgramReflection reflection{cull_program_};
+    view_projection_uniform_ =
+        reflection.uniform<glm::mat4>("u_view_projection");
+    depth_view_projection_uniform_ =
+        reflection.uniform<glm::mat4>("u_depth_view_projection");
+    object_count_uniform_ = reflection.uniform<int>("u_object_count");
+    index_count_uniform_ = reflection.uniform<int>("u_index_count");
+    first_index_uniform_ = reflection.uniform<int>("u_first_index");
+    occlusion_uniform_ = reflection.uniform<int>("u_occlusion");
+    gl_state().use_program(cull_program_);
+    reflection.uniform<int>("u_pack").set(packs_commands_);
+  }
+  if (reduce_program_) {
+    source_level_uniform_ =
+        ProgramReflection{reduce_program_}.uniform<int>("u_source_level");
+  }
+
+  GLuint buffers[5];
+  glGenBuffers(5, buffers);
+  object_buffer_ = buffers[0];
+  index_buffer_ = buffers[1];
+  command_buffer_ = buffers[2];
+  count_buffer_ = buffers[3];
+  readback_buffer_ = buffers[4];
+  auto &state{gl_state()};
+  state.bind_buffer(GL_COPY_WRITE_BUFFER, count_buffer_);
+  glBufferData(GL_COPY_WRITE_BUFFER, sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+  state.bind_buffer(GL_COPY_WRITE_BUFFER, readback_buffer_);
+  glBufferData(GL_COPY_WRITE_BUFFER, readback_slot_count * sizeof(GLuint),
+               nullptr, GL_STREAM_READ);
+}
+
+GpuCuller::~GpuCuller() {
+  auto &state{gl_state()};
+  for (auto program : {cull_program_, reduce_program_}) {
+    glDeleteProgram(program);
+    state.forget_program(program);
+  }
+  for (auto buffer : {object_buffer_, index_buffer_, command_buffer_,
+                      count_buffer_, readback_buffer_}) {
+    glDeleteBuffers(1, &buffer);
+    state.forget_buffer(buffer);
+  }
+  for (auto texture : {depth_texture_, pyramid_}) {
+    glDeleteTextures(1, &texture);
+    state.forget_texture(texture);
+  }
+  for (auto fence : readback_fences_) {
+    glDeleteSync(fence);
+  }
+}
+
+void GpuCuller::set_objects(std::span<const glm::vec4> spheres) {
+  object_count_ = spheres.size();
+  auto &state{gl_state()};
+  state.bind_buffer(GL_COPY_WRITE_BUFFER, object_buffer_);
+  glBufferData(GL_COPY_WRITE_BUFFER, spheres.size_bytes(), spheres.data(),
+               GL_STATIC_DRAW);
+
+  // The a_object attribute reads this at the command's base instance.
+  std::vector<GLuint> indices(object_count_);
+  std::iota(indices.begin(), indices.end(), 0);
+  state.bind_buffer(GL_COPY_WRITE_BUFFER, index_buffer_);
+  glBufferData(GL_COPY_WRITE_BUFFER, indices.size() * sizeof(GLuint),
+               indices.data(), GL_STATIC_DRAW);
+
+  state.bind_buffer(GL_COPY_WRITE_BUFFER, command_buffer_);
+  glBufferData(GL_COPY_WRITE_BUFFER,
+               object_count_ * sizeof(DrawElementsIndirectCommand), nullptr,
+               GL_DYNAMIC_COPY);
+}
+
+int GpuCuller::draw(const glm::mat4 &view_projection, GLuint program,
+                    GLuint vertex_array, GLsizei index_count,
+                    GLuint first_index) {
+  if (!cull_program_ || object_count_ == 0) {
+    return 0;
+  }
+  auto &state{gl_state()};
+  view_projection_ = view_projection;
+
+  state.use_program(cull_program_);
+  view_projection_uniform_.set(view_projection);
+  depth_view_projection_uniform_.set(depth_view_projection_);
+  object_count_uniform_.set(static_cast<int>(object_count_));
+  index_count_uniform_.set(index_count);
+  first_index_uniform_.set(static_cast<int>(first_index));
+  occlusion_uniform_.set(has_depth_);
+  if (has_depth_) {
+    state.bind_texture(depth_unit, GL_TEXTURE_2D, pyramid_);
+  }
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, culled_objects_binding,
+                   object_buffer_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, command_buffer_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, count_buffer_);
+  glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER,
+                    GL_UNSIGNED_INT, nullptr);
+  glDispatchCompute(group_count(static_cast<int>(object_count_),
+                                cull_group_size),
+                    1, 1);
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+  state.use_program(program);
+  state.bind_vertex_array(vertex_array);
+  state.bind_buffer(GL_ARRAY_BUFFER, index_buffer_);
+  glVertexAttribIPointer(culled_object_location, 1, GL_UNSIGNED_INT, 0,
+                         nullptr);
+  glEnableVertexAttribArray(culled_object_location);
+  glVertexAttribDivisor(culled_object_location, 1);
+  state.bind_buffer(GL_DRAW_INDIRECT_BUFFER, command_buffer_);
+  auto max_draws{static_cast<GLsizei>(object_count_)};
+  if (packs_commands_) {
+    state.bind_buffer(GL_PARAMETER_BUFFER_ARB, count_buffer_);
+    glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr,
+                                        0, max_draws, 0);
+  } else {
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr,
+                                max_draws, 0);
+  }
+
+  read_back();
+  return 1;
+}
+
+void GpuCuller::read_back() {
+  auto &state{gl_state()};
+  state.bind_buffer(GL_COPY_READ_BUFFER, readback_buffer_);
+  // Oldest first, so that the newest count that is ready wins. A count the
+  // GPU has not got to by the time its slot comes round again is dropped.
+  auto slot{frame_ % readback_slot_count};
+  for (std::size_t i{0}; i < readback_slot_count; ++i) {
+    auto s{(slot + i) % readback_slot_count};
+    auto &fence{readback_fences_[s]};
+    if (!fence) {
+      continue;
+    }
+    auto status{glClientWaitSync(fence, 0, 0)};
+    if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+      glGetBufferSubData(GL_COPY_READ_BUFFER, s * sizeof(GLuint),
+                         sizeof(GLuint), &visible_objects_);
+    } else if (s != slot) {
+      continue;
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+  }
+
+  state.bind_buffer(GL_COPY_WRITE_BUFFER, readback_buffer_);
+  state.bind_buffer(GL_COPY_READ_BUFFER, count_buffer_);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0,
+                      slot * sizeof(GLuint), sizeof(GLuint));
+  readback_fences_[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  ++frame_;
+}
+
+void GpuCuller::resize_depth(int width, int height) {
+  auto &state{gl_state()};
+  for (auto texture : {depth_texture_, pyramid_}) {
+    glDeleteTextures(1, &texture);
+    state.forget_texture(texture);
+  }
+  depth_width_ = width;
+  depth_height_ = height;
+  // Level 0 already halves the depth buffer.
+  pyramid_width_ = std::max(width / 2, 1);
+  pyramid_height_ = std::max(height / 2, 1);
+  pyramid_levels_ = 1;
+  while ((std::max(pyramid_width_, pyramid_height_) >> pyramid_levels_) > 0) {
+    ++pyramid_levels_;
+  }
+
+  glGenTextures(1, &depth_texture_);
+  state.bind_texture(depth_unit, GL_TEXTURE_2D, depth_texture_);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, width, height);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  glGenTextures(1, &pyramid_);
+  state.bind_texture(depth_unit, GL_TEXTURE_2D, pyramid_);
+  glTexStorage2D(GL_TEXTURE_2D, pyramid_levels_, GL_R32F, pyramid_width_,
+                 pyramid_height_);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_NEAREST_MIPMAP_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  has_depth_ = false;
+}
+
+void GpuCuller::update_depth() {
+  if (!reduce_program_) {
+    return;
+  }
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  if (viewport[2] <= 0 || viewport[3] <= 0) {
+    return;
+  }
+  if (viewport[2] != depth_width_ || viewport[3] != depth_height_) {
+    resize_depth(viewport[2], viewport[3]);
+  }
+
+  auto &state{gl_state()};
+  state.bind_texture(depth_unit, GL_TEXTURE_2D, depth_texture_);
+  glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, viewport[0], viewport[1],
+                      depth_width_, depth_height_);
+
+  state.use_program(reduce_program_);
+  for (int level{0}; level < pyramid_levels_; ++level) {
+    if (level == 1) {
+      state.bind_texture(depth_unit, GL_TEXTURE_2D, pyramid_);
+    }
+    source_level_uniform_.set(std::max(level - 1, 0));
+    glBindImageTexture(0, pyramid_, level, GL_FALSE, 0, GL_WRITE_ONLY,
+                       GL_R32F);
+    glDispatchCompute(
+        group_count(std::max(pyramid_width_ >> level, 1), reduce_group_size),
+        group_count(std::max(pyramid_height_ >> level, 1), reduce_group_size),
+        1);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+  }
+  has_depth_ = true;
+  depth_view_projection_ = view_projection_;
+}
+
+} // namespace common
@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <common/image.hpp>
+#include <common/log.hpp>
+#include <common/state_cache.hpp>
+#include <cstdlib>
+#include <fstream>
+#include <glad/glad.h>
+
+namespace common {
+
+bool write_ppm(const std::string &path, const Image &image) {
+  std::ofstream file{path, std::ios::binary | std::ios::trunc};
+  if (!file) {
+    log_error("Failed to open {}", path);
+    return false;
+  }
+  file << "P6\n" << image.width << ' ' << image.height << "\n255\n";
+  file.write(reinterpret_cast<const char *>(image.pixels.data()),
+             image.pixels.size());
+  if (!file) {
+    log_error("Failed to write {}", path);
+    return false;
+  }
+  return true;
+}
+
+bool read_ppm(const std::string &path, Image &image) {
+  std::ifstream file{path, std::ios::binary};
+  if (!file) {
+    log_error("Failed to open {}", path);
+    return false;
+  }
+  std::string magic;
+  int max_value{0};
+  file >> magic >> image.width >> image.height >> max_value;
+  // Exactly one whitespace character separates the header from the pixels.
+  file.get();
+  if (!file || magic != "P6" || max_value != 255 || image.width <= 0 ||
+      image.height <= 0) {
+    log_error("Unsupported image {}", path);
+    return false;
+  }
+  image.pixels.resize(std::size_t(image.width) * image.height * 3);
+  file.read(reinterpret_cast<char *>(image.pixels.data()),
+            image.pixels.size());
+  if (!file) {
+    log_error("Truncated image {}", path);
+    return false;
+  }
+  return true;
+}
+
+ImageDifference compare_images(const Image &a, const Image &b,
+                               int tolerance) {
+  ImageDifference difference;
+  if (a.width != b.width || a.height != b.height) {
+    difference.max_difference = 255;
+    difference.mismatched_pixels =
+        std::max(a.pixels.size(), b.pixels.size()) / 3;
+    return difference;
+  }
+  for (std::size_t i{0}; i < a.pixels.size(); i += 3) {
+    auto pixel{0};
+    for (std::size_t c{0}; c < 3; ++c) {
+      pixel = std::max(pixel, std::abs(int{a.pixels[i + c]} - b.pixels[i + c]));
+    }
+    difference.max_difference = std::max(difference.max_difference, pixel);
+    difference.mismatched_pixels += pixel > tolerance;
+  }
+  return difference;
+}
+
+Image read_framebuffer(int width, int height) {
+  Image image{width, height, {}};
+  image.pixels.resize(std::size_t(width) * height * 3);
+  gl_state().bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE,
+               image.pixels.data());
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  // GL returns the bottom row first.
+  auto row_size{std::size_t(width) * 3};
+  for (int y{0}; y < height / 2; ++y) {
+    std::swap_ranges(image.pixels.begin() + y * row_size,
+                     image.pixels.begin() + (y + 1) * row_size,
+                     image.pixels.end() - (y + 1) * row_size);
+  }
+  return image;
+}
+
+} // namespace common
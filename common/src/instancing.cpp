@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <common/instancing.hpp>
+#include <common/state_cache.hpp>
+#include <cstring>
+
+namespace common {
+
+namespace {
+
+// Room for this many matrices per frame before the buffer has to grow.
+constexpr std::size_t initial_instance_capacity{16384};
+
+} // namespace
+
+InstancedRenderer::InstancedRenderer()
+    : instance_buffer_{GL_ARRAY_BUFFER,
+                       initial_instance_capacity * sizeof(glm::mat4)} {}
+
+std::size_t InstancedRenderer::Instances::size() const {
+  auto count{models.size()};
+  for (auto &store : stores) {
+    count += store.size();
+  }
+  return count;
+}
+
+int InstancedRenderer::flush() {
+  std::size_t instance_count{0};
+  for (auto &[batch, instances] : batches_) {
+    instance_count += instances.size();
+  }
+  if (instance_count == 0) {
+    return 0;
+  }
+
+  // Every matrix, then every layer.
+  auto size{instance_count * (sizeof(glm::mat4) + sizeof(std::uint32_t))};
+  instance_buffer_.reserve(size);
+  instance_buffer_.begin_frame();
+  auto allocation{instance_buffer_.allocate(size, sizeof(glm::vec4))};
+  if (!allocation.data) {
+    instance_buffer_.end_frame();
+    return 0;
+  }
+  auto mapped{static_cast<unsigned char *>(allocation.data)};
+  auto layers{reinterpret_cast<std::uint32_t *>(
+      mapped + instance_count * sizeof(glm::mat4))};
+  std::size_t offset{0};
+  for (auto &[batch, instances] : batches_) {
+    std::memcpy(mapped + offset, instances.models.data(),
+                instances.models.size() * sizeof(glm::mat4));
+    offset += instances.models.size() * sizeof(glm::mat4);
+    std::memcpy(layers, instances.layers.data(),
+                instances.layers.size() * sizeof(std::uint32_t));
+    std::fill(layers + instances.layers.size(),
+              layers + instances.models.size(), 0u);
+    layers += instances.models.size();
+    for (auto &store : instances.stores) {
+      auto target{reinterpret_cast<glm::mat4 *>(mapped + offset)};
+      if (store.all) {
+        store.transforms->compose_world(target);
+      } else {
+        store.transforms->compose_world(store.indices, target);
+      }
+      offset += store.size() * sizeof(glm::mat4);
+      if (store.layers.empty()) {
+        std::fill(layers, layers + store.size(), 0u);
+      } else if (store.all) {
+        std::copy(store.layers.begin(), store.layers.end(), layers);
+      } else {
+        for (std::size_t i{0}; i < store.indices.size(); ++i) {
+          layers[i] = store.layers[store.indices[i]];
+        }
+      }
+      layers += store.size();
+    }
+  }
+  instance_buffer_.commit(allocation);
+
+  auto draw_calls{0};
+  offset = allocation.offset;
+  auto layer_offset{allocation.offset + instance_count * sizeof(glm::mat4)};
+  auto &state{gl_state()};
+  state.bind_buffer(GL_ARRAY_BUFFER, allocation.buffer);
+  for (auto &[batch, instances] : batches_) {
+    auto count{instances.size()};
+    if (count == 0) {
+      continue;
+    }
+    state.use_program(batch.program);
+    state.bind_texture(0, batch.texture_target, batch.texture);
+    state.bind_vertex_array(batch.vertex_array);
+    for (GLuint column{0}; column < 4; ++column) {
+      auto location{instance_model_location + column};
+      glEnableVertexAttribArray(location);
+      glVertexAttribPointer(
+          location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+          reinterpret_cast<const void *>(offset + column * sizeof(glm::vec4)));
+      glVertexAttribDivisor(location, 1);
+    }
+    glEnableVertexAttribArray(instance_layer_location);
+    glVertexAttribIPointer(instance_layer_location, 1, GL_UNSIGNED_INT,
+                           sizeof(std::uint32_t),
+                           reinterpret_cast<const void *>(layer_offset));
+    glVertexAttribDivisor(instance_layer_location, 1);
+    glDrawElementsInstanced(
+        GL_TRIANGLES, batch.index_count, GL_UNSIGNED_INT,
+        reinterpret_cast<const void *>(std::uintptr_t{batch.first_index} *
+                                       sizeof(std::uint32_t)),
+        static_cast<GLsizei>(count));
+    ++draw_calls;
+    offset += count * sizeof(glm::mat4);
+    layer_offset += count * sizeof(std::uint32_t);
+    // Keep the capacity for the next frame.
+    instances.models.clear();
+    instances.layers.clear();
+    instances.stores.clear();
+  }
+  instance_buffer_.end_frame();
+  return draw_calls;
+}
+
+} // namespace common
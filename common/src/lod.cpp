@@ -0,0 +1,56 @@
+#include <algorithm>
+#include <cmath>
+#include <common/lod.hpp>
+
+namespace common {
+
+void LodSelector::begin_frame(const glm::vec3 &eye, float fov_y,
+                              int viewport_height) {
+  eye_ = eye;
+  pixels_per_unit_ = viewport_height / (2.0f * std::tan(fov_y / 2.0f));
+  triangles_ = 0;
+  full_detail_triangles_ = 0;
+  changes_ = 0;
+}
+
+std::uint32_t LodSelector::select(std::size_t object,
+                                  std::span<const MeshLod> lods,
+                                  const glm::vec3 &center, float radius,
+                                  float scale) {
+  if (lods.empty()) {
+    return 0;
+  }
+  auto &level{levels_[object]};
+  auto current{std::min<std::size_t>(level, lods.size() - 1)};
+
+  // Measured from the nearest point of the bounds, so that big objects
+  // refine before their near side does.
+  auto distance{glm::length(center - eye_) - radius};
+  auto selected{std::size_t{0}};
+  if (distance > 0.0f) {
+    auto pixels_per_error{scale * pixels_per_unit_ / distance};
+    auto fits{[&](std::size_t i, float threshold) {
+      return lods[i].error * pixels_per_error <= threshold;
+    }};
+    selected = current;
+    if (!fits(current, threshold_)) {
+      while (selected > 0 && !fits(selected, threshold_)) {
+        --selected;
+      }
+    } else {
+      auto coarsen_threshold{threshold_ * (1.0f - hysteresis_)};
+      while (selected + 1 < lods.size() &&
+             fits(selected + 1, coarsen_threshold)) {
+        ++selected;
+      }
+    }
+  }
+
+  changes_ += selected != level;
+  level = static_cast<std::uint8_t>(selected);
+  triangles_ += lods[selected].index_count / 3;
+  full_detail_triangles_ += lods[0].index_count / 3;
+  return level;
+}
+
+} // namespace common
@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <atomic>
+#include <common/event_queue.hpp>
+#include <common/log.hpp>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace common {
+
+namespace {
+
+std::int64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::atomic<LogLevel> minimum_level{LogLevel::info};
+
+// Records waiting to be written, one ring per logging thread.
+struct LogRing {
+  EventQueue<LogRecord, 256> records;
+  std::atomic<std::uint64_t> dropped{0};
+  // Set when the owning thread exits; the ring is freed once drained.
+  std::atomic<bool> retired{false};
+};
+
+struct LogEntry {
+  std::int64_t time_ns;
+  LogLevel level;
+  std::string message;
+};
+
+class Logger {
+public:
+  Logger() : thread_{[this] { run(); }} {}
+
+  ~Logger() {
+    {
+      std::lock_guard lock{wake_mutex_};
+      stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+    flush();
+  }
+
+  LogRing &ring() {
+    // Retires the ring when the thread exits rather than freeing it, as the
+    // flusher may still be reading it.
+    struct Holder {
+      LogRing *ring{nullptr};
+      ~Holder() {
+        if (ring) {
+          ring->retired.store(true, std::memory_order_release);
+        }
+      }
+    };
+    thread_local Holder holder;
+    if (!holder.ring) {
+      auto ring{std::make_unique<LogRing>()};
+      holder.ring = ring.get();
+      std::lock_guard lock{rings_mutex_};
+      rings_.push_back(std::move(ring));
+    }
+    return *holder.ring;
+  }
+
+  void submit(LogEntry entry) {
+    auto urgent{entry.level == LogLevel::error};
+    {
+      std::lock_guard lock{entries_mutex_};
+      entries_.push_back(std::move(entry));
+    }
+    if (urgent) {
+      wake_.notify_one();
+    }
+  }
+
+  void wake() { wake_.notify_one(); }
+
+  void flush() {
+    std::lock_guard drain_lock{drain_mutex_};
+    std::vector<LogEntry> entries;
+    std::uint64_t dropped{0};
+    {
+      std::lock_guard lock{rings_mutex_};
+      for (auto it{rings_.begin()}; it != rings_.end();) {
+        auto &ring{**it};
+        // Read before draining, so that nothing pushed before the thread
+        // exited is left behind when the ring is freed.
+        auto retired{ring.retired.load(std::memory_order_acquire)};
+        LogRecord record;
+        while (ring.records.pop(record)) {
+          entries.push_back({record.time_ns(), record.level(), {}});
+          // Formatted after the locks are released, see below.
+          pending_.push_back(record);
+        }
+        dropped += ring.dropped.exchange(0, std::memory_order_relaxed);
+        it = retired ? rings_.erase(it) : it + 1;
+      }
+    }
+    for (std::size_t i{0}; i < pending_.size(); ++i) {
+      entries[i].message = pending_[i].format();
+    }
+    pending_.clear();
+    {
+      std::lock_guard lock{entries_mutex_};
+      std::move(entries_.begin(), entries_.end(), std::back_inserter(entries));
+      entries_.clear();
+    }
+    if (entries.empty() && dropped == 0) {
+      return;
+    }
+
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const LogEntry &a, const LogEntry &b) {
+                       return a.time_ns < b.time_ns;
+                     });
+    auto wrote_stdout{false};
+    for (auto &entry : entries) {
+      if (entry.level >= LogLevel::warning) {
+        std::cerr << entry.message << '\n';
+      } else {
+        std::cout << entry.message << '\n';
+        wrote_stdout = true;
+      }
+    }
+    if (dropped > 0) {
+      std::cerr << "Log buffer full, dropped " << dropped << " messages\n";
+    }
+    if (wrote_stdout) {
+      std::cout.flush();
+    }
+  }
+
+private:
+  void run() {
+    std::unique_lock lock{wake_mutex_};
+    while (!stopping_) {
+      wake_.wait_for(lock, std::chrono::milliseconds{10});
+      lock.unlock();
+      flush();
+      lock.lock();
+    }
+  }
+
+  std::mutex rings_mutex_;
+  std::vector<std::unique_ptr<LogRing>> rings_;
+  std::mutex entries_mutex_;
+  std::vector<LogEntry> entries_;
+  // Serialises flushes, which keeps the output in order.
+  std::mutex drain_mutex_;
+  std::vector<LogRecord> pending_;
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+  bool stopping_{false};
+  std::thread thread_;
+};
+
+Logger &logger() {
+  static Logger instance;
+  return instance;
+}
+
+} // namespace
+
+LogRecord::LogRecord(LogLevel level, const char *format)
+    : time_ns_{now_ns()}, format_{format}, level_{level} {}
+
+void LogRecord::add(bool value) {
+  push({Argument::Type::boolean, {.boolean = value}});
+}
+
+void LogRecord::add(std::string_view value) {
+  if (value.size() > text_capacity - text_size_) {
+    complete_ = false;
+    return;
+  }
+  Argument argument{Argument::Type::string, {}};
+  argument.string = {text_size_, static_cast<std::uint16_t>(value.size())};
+  std::memcpy(text_.data() + text_size_, value.data(), value.size());
+  text_size_ += static_cast<std::uint16_t>(value.size());
+  push(argument);
+}
+
+std::string LogRecord::format() const {
+  std::ostringstream os;
+  os << std::boolalpha;
+  std::string_view format{format_};
+  for (std::size_t i{0}; i < argument_count_; ++i) {
+    auto placeholder{format.find("{}")};
+    os << format.substr(0, placeholder);
+    if (placeholder == std::string_view::npos) {
+      format = {};
+      break;
+    }
+    auto &argument{arguments_[i]};
+    switch (argument.type) {
+    case Argument::Type::boolean:
+      os << argument.boolean;
+      break;
+    case Argument::Type::signed_integer:
+      os << argument.signed_integer;
+      break;
+    case Argument::Type::unsigned_integer:
+      os << argument.unsigned_integer;
+      break;
+    case Argument::Type::floating:
+      os << argument.floating;
+      break;
+    case Argument::Type::string:
+      os << std::string_view{text_.data() + argument.string.offset,
+                             argument.string.size};
+      break;
+    }
+    format.remove_prefix(placeholder + 2);
+  }
+  os << format;
+  if (suppressed_ > 0) {
+    os << " (" << suppressed_ << " similar messages suppressed)";
+  }
+  return os.str();
+}
+
+void set_log_level(LogLevel level) {
+  minimum_level.store(level, std::memory_order_relaxed);
+}
+
+bool log_enabled(LogLevel level) {
+  return level >= minimum_level.load(std::memory_order_relaxed);
+}
+
+void submit_log(const LogRecord &record) {
+  auto &ring{logger().ring()};
+  if (!ring.records.push(record)) {
+    ring.dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (record.level() == LogLevel::error) {
+    logger().wake();
+  }
+}
+
+void submit_log(LogLevel level, std::string message) {
+  logger().submit({now_ns(), level, std::move(message)});
+}
+
+void flush_log() { logger().flush(); }
+
+} // namespace common
@@ -0,0 +1,125 @@
+#include <common/log.hpp>
+#include <common/mapped_file.hpp>
+#include <utility>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace common {
+
+MappedFile::~MappedFile() { close(); }
+
+MappedFile::MappedFile(MappedFile &&other) noexcept {
+  *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+  if (this != &other) {
+    close();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+#ifdef _WIN32
+    file_ = std::exchange(other.file_, nullptr);
+    mapping_ = std::exchange(other.mapping_, nullptr);
+#endif
+  }
+  return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string &path) {
+  close();
+  file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                      OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file_ == INVALID_HANDLE_VALUE) {
+    file_ = nullptr;
+    log_error("Failed to open {}", path);
+    return false;
+  }
+  LARGE_INTEGER size;
+  GetFileSizeEx(file_, &size);
+  size_ = static_cast<std::size_t>(size.QuadPart);
+  if (size_ == 0) {
+    return true;
+  }
+  mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping_) {
+    data_ = static_cast<const std::byte *>(
+        MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+  }
+  if (!data_) {
+    log_error("Failed to map {}", path);
+    close();
+    return false;
+  }
+  return true;
+}
+
+void MappedFile::close() {
+  if (data_) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_) {
+    CloseHandle(mapping_);
+  }
+  if (file_) {
+    CloseHandle(file_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  mapping_ = nullptr;
+  file_ = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::string &path) {
+  close();
+  auto fd{::open(path.c_str(), O_RDONLY)};
+  if (fd < 0) {
+    log_error("Failed to open {}", path);
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0) {
+    ::close(fd);
+    log_error("Failed to stat {}", path);
+    return false;
+  }
+  size_ = static_cast<std::size_t>(status.st_size);
+  if (size_ == 0) {
+    ::close(fd);
+    return true;
+  }
+  // The mapping stays valid after the descriptor is closed.
+  auto data{mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0)};
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    size_ = 0;
+    log_error("Failed to map {}", path);
+    return false;
+  }
+  madvise(data, size_, MADV_SEQUENTIAL);
+  data_ = static_cast<const std::byte *>(data);
+  return true;
+}
+
+void MappedFile::close() {
+  if (data_) {
+    munmap(const_cast<std::byte *>(data_), size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+}
+
+#endif
+
+} // namespace common
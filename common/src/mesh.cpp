@@ -0,0 +1,756 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <common/log.hpp>
+#include <common/mapped_file.hpp>
+#include <common/mesh.hpp>
+#include <numeric>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace common {
+
+namespace {
+
+// One face corner of an OBJ file: zero-based position, uv and normal
+// indices, -1 when absent.
+struct Corner {
+  std::int32_t position;
+  std::int32_t uv;
+  std::int32_t normal;
+
+  bool operator==(const Corner &) const = default;
+};
+
+struct CornerHash {
+  std::size_t operator()(const Corner &corner) const {
+    auto hash{static_cast<std::uint64_t>(corner.position) * 0x9e3779b97f4a7c15};
+    hash ^= static_cast<std::uint64_t>(corner.uv) * 0xc2b2ae3d27d4eb4f;
+    hash ^= static_cast<std::uint64_t>(corner.normal) * 0x165667b19e3779f9;
+    return static_cast<std::size_t>(hash ^ (hash >> 32));
+  }
+};
+
+std::string_view next_token(std::string_view &line) {
+  auto begin{line.find_first_not_of(" \t\r")};
+  if (begin == std::string_view::npos) {
+    line = {};
+    return {};
+  }
+  line.remove_prefix(begin);
+  auto end{std::min(line.find_first_of(" \t\r"), line.size())};
+  auto token{line.substr(0, end)};
+  line.remove_prefix(end);
+  return token;
+}
+
+template <class T> bool parse_number(std::string_view token, T &value) {
+  if (!token.empty() && token.front() == '+') {
+    token.remove_prefix(1);
+  }
+  auto [end, error]{
+      std::from_chars(token.data(), token.data() + token.size(), value)};
+  return error == std::errc{} && end == token.data() + token.size();
+}
+
+template <int N>
+bool parse_vector(std::string_view line, std::vector<glm::vec3> &values) {
+  glm::vec3 value{0.0f};
+  for (int i{0}; i < N; ++i) {
+    if (!parse_number(next_token(line), value[i])) {
+      return false;
+    }
+  }
+  values.push_back(value);
+  return true;
+}
+
+// Resolves a one-based, or negative and relative, OBJ index.
+bool resolve_index(std::string_view token, std::size_t count,
+                   std::int32_t &index) {
+  std::int64_t value;
+  if (!parse_number(token, value) || value == 0) {
+    return false;
+  }
+  value = value > 0 ? value - 1 : static_cast<std::int64_t>(count) + value;
+  if (value < 0 || value >= static_cast<std::int64_t>(count)) {
+    return false;
+  }
+  index = static_cast<std::int32_t>(value);
+  return true;
+}
+
+// Parses v, v/vt, v//vn or v/vt/vn.
+bool parse_corner(std::string_view token, std::size_t position_count,
+                  std::size_t uv_count, std::size_t normal_count,
+                  Corner &corner) {
+  corner = {-1, -1, -1};
+  auto slash{token.find('/')};
+  if (!resolve_index(token.substr(0, slash), position_count,
+                     corner.position)) {
+    return false;
+  }
+  if (slash == std::string_view::npos) {
+    return true;
+  }
+  token.remove_prefix(slash + 1);
+  slash = token.find('/');
+  auto uv{token.substr(0, slash)};
+  if (!uv.empty() && !resolve_index(uv, uv_count, corner.uv)) {
+    return false;
+  }
+  if (slash == std::string_view::npos) {
+    return true;
+  }
+  return resolve_index(token.substr(slash + 1), normal_count, corner.normal);
+}
+
+// Triangles per vertex, as offsets into one flat list.
+struct Adjacency {
+  std::vector<std::uint32_t> offsets;
+  std::vector<std::uint32_t> triangles;
+
+  Adjacency(const std::vector<std::uint32_t> &indices,
+            std::size_t vertex_count)
+      : offsets(vertex_count + 1, 0), triangles(indices.size()) {
+    for (auto index : indices) {
+      ++offsets[index + 1];
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    auto next{offsets};
+    for (std::size_t i{0}; i < indices.size(); ++i) {
+      triangles[next[indices[i]]++] = static_cast<std::uint32_t>(i / 3);
+    }
+  }
+
+  std::uint32_t count(std::uint32_t vertex) const {
+    return offsets[vertex + 1] - offsets[vertex];
+  }
+};
+
+// FIFO cache as timestamps: a vertex is cached while fewer than cache_size
+// vertices have been transformed since it was.
+class CacheModel {
+public:
+  CacheModel(std::size_t vertex_count, unsigned cache_size)
+      : cache_size_{cache_size}, times_(vertex_count, 0) {
+    reset();
+  }
+
+  // Returns true on a miss.
+  bool access(std::uint32_t vertex) {
+    if (time_ - times_[vertex] <= cache_size_) {
+      return false;
+    }
+    times_[vertex] = time_++;
+    return true;
+  }
+
+  void reset() { time_ += cache_size_ + 1; }
+
+  std::uint64_t age(std::uint32_t vertex) const {
+    return time_ - times_[vertex];
+  }
+
+private:
+  std::uint64_t cache_size_;
+  std::uint64_t time_{0};
+  std::vector<std::uint64_t> times_;
+};
+
+// Area-weighted sum of squared distances to a set of planes, as the upper
+// half of a symmetric 4x4 matrix: xx xy xz xw yy yz yw zz zw ww.
+struct Quadric {
+  std::array<double, 10> a{};
+  double weight{0.0};
+
+  static Quadric plane(const glm::vec3 &normal, const glm::vec3 &point,
+                       double area) {
+    double x{normal.x}, y{normal.y}, z{normal.z};
+    auto w{-(x * point.x + y * point.y + z * point.z)};
+    Quadric quadric{{x * x, x * y, x * z, x * w, y * y, y * z, y * w, z * z,
+                     z * w, w * w},
+                    area};
+    for (auto &value : quadric.a) {
+      value *= area;
+    }
+    return quadric;
+  }
+
+  Quadric &operator+=(const Quadric &other) {
+    for (std::size_t i{0}; i < a.size(); ++i) {
+      a[i] += other.a[i];
+    }
+    weight += other.weight;
+    return *this;
+  }
+
+  // The mean squared distance to the planes.
+  double error(const glm::vec3 &p) const {
+    if (weight == 0.0) {
+      return 0.0;
+    }
+    double x{p.x}, y{p.y}, z{p.z};
+    auto value{a[0] * x * x + a[4] * y * y + a[7] * z * z + a[9] +
+               2.0 * (a[1] * x * y + a[2] * x * z + a[5] * y * z + a[3] * x +
+                      a[6] * y + a[8] * z)};
+    // Rounding can take it below zero.
+    return std::max(value, 0.0) / weight;
+  }
+};
+
+struct PositionKey {
+  std::uint32_t x;
+  std::uint32_t y;
+  std::uint32_t z;
+
+  bool operator==(const PositionKey &) const = default;
+};
+
+struct PositionKeyHash {
+  std::size_t operator()(const PositionKey &key) const {
+    auto hash{static_cast<std::uint64_t>(key.x) * 0x9e3779b97f4a7c15};
+    hash ^= static_cast<std::uint64_t>(key.y) * 0xc2b2ae3d27d4eb4f;
+    hash ^= static_cast<std::uint64_t>(key.z) * 0x165667b19e3779f9;
+    return static_cast<std::size_t>(hash ^ (hash >> 32));
+  }
+};
+
+// Collapses edges of a triangle list in passes. Vertices are grouped by
+// position, so that the corners of a seam move together or, as they are
+// locked, not at all. Within a pass, collapses are taken cheapest first,
+// and each freezes the triangles around the vertex that moved, so no two
+// collapses of a pass see each other's triangles.
+class Simplifier {
+public:
+  Simplifier(const std::vector<MeshVertex> &vertices,
+             std::vector<std::uint32_t> indices)
+      : vertices_{vertices}, indices_{std::move(indices)},
+        positions_(vertices.size()), locked_(vertices.size(), 0),
+        quadrics_(vertices.size()) {
+    // Each position is represented by the first vertex that has it.
+    std::unordered_map<PositionKey, std::uint32_t, PositionKeyHash> first;
+    for (std::uint32_t v{0}; v < vertices.size(); ++v) {
+      auto &p{vertices[v].position};
+      PositionKey key{std::bit_cast<std::uint32_t>(p.x),
+                      std::bit_cast<std::uint32_t>(p.y),
+                      std::bit_cast<std::uint32_t>(p.z)};
+      positions_[v] = first.try_emplace(key, v).first->second;
+    }
+    std::vector<std::uint32_t> used(vertices.size(), unused);
+    for (auto index : indices_) {
+      auto &user{used[positions_[index]]};
+      if (user != unused && user != index) {
+        locked_[positions_[index]] = 1;
+      }
+      user = index;
+    }
+
+    // Edges of one triangle are on a border, and of more than two are
+    // non-manifold.
+    std::unordered_map<std::uint64_t, std::uint32_t> edge_triangles;
+    for (std::size_t i{0}; i < indices_.size(); i += 3) {
+      for (int corner{0}; corner < 3; ++corner) {
+        auto a{positions_[indices_[i + corner]]};
+        auto b{positions_[indices_[i + (corner + 1) % 3]]};
+        ++edge_triangles[std::uint64_t{std::min(a, b)} << 32 |
+                         std::max(a, b)];
+      }
+      auto &a{position(indices_[i])};
+      auto normal{glm::cross(position(indices_[i + 1]) - a,
+                             position(indices_[i + 2]) - a)};
+      auto length{glm::length(normal)};
+      if (length == 0.0f) {
+        continue;
+      }
+      auto plane{Quadric::plane(normal / length, a, 0.5 * length)};
+      for (int corner{0}; corner < 3; ++corner) {
+        quadrics_[positions_[indices_[i + corner]]] += plane;
+      }
+    }
+    for (auto &[edge, count] : edge_triangles) {
+      if (count != 2) {
+        locked_[edge >> 32] = 1;
+        locked_[edge & 0xffffffff] = 1;
+      }
+    }
+  }
+
+  std::size_t triangle_count() const { return indices_.size() / 3; }
+  const std::vector<std::uint32_t> &indices() const { return indices_; }
+  // The largest root mean square distance error of any collapse so far.
+  float error() const { return static_cast<float>(std::sqrt(max_error_)); }
+
+  // Collapses edges until at most `target` triangles are left or no more
+  // can move this pass. Returns false when none could.
+  bool pass(std::size_t target) {
+    // Triangles around each position.
+    std::vector<std::uint32_t> offsets(vertices_.size() + 1, 0);
+    for (auto index : indices_) {
+      ++offsets[positions_[index] + 1];
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<std::uint32_t> around(indices_.size());
+    auto next{offsets};
+    for (std::size_t i{0}; i < indices_.size(); ++i) {
+      around[next[positions_[indices_[i]]]++] =
+          static_cast<std::uint32_t>(i / 3);
+    }
+
+    struct Collapse {
+      std::uint32_t from;
+      // The vertex that the corners of `from` become.
+      std::uint32_t to_vertex;
+      double cost;
+    };
+    std::vector<Collapse> collapses;
+    for (std::size_t i{0}; i < indices_.size(); ++i) {
+      auto a{indices_[i]};
+      auto b{indices_[i - i % 3 + (i % 3 + 1) % 3]};
+      for (auto [from, to] : {std::pair{a, b}, std::pair{b, a}}) {
+        auto from_position{positions_[from]};
+        if (locked_[from_position]) {
+          continue;
+        }
+        auto quadric{quadrics_[from_position]};
+        quadric += quadrics_[positions_[to]];
+        collapses.push_back(
+            {from_position, to, quadric.error(position(to))});
+      }
+    }
+    std::sort(collapses.begin(), collapses.end(),
+              [](const Collapse &a, const Collapse &b) {
+                return a.cost < b.cost;
+              });
+
+    std::vector<std::uint8_t> frozen(vertices_.size(), 0);
+    std::vector<std::uint32_t> targets(vertices_.size(), unused);
+    auto triangles{triangle_count()};
+    auto collapsed{false};
+    for (auto &collapse : collapses) {
+      if (triangles <= target) {
+        break;
+      }
+      auto to{positions_[collapse.to_vertex]};
+      if (frozen[collapse.from] || frozen[to]) {
+        continue;
+      }
+      std::size_t removed{0};
+      auto allowed{true};
+      for (auto t{offsets[collapse.from]};
+           allowed && t < offsets[collapse.from + 1]; ++t) {
+        auto triangle{&indices_[around[t] * 3]};
+        glm::vec3 before[3], after[3];
+        auto shared{false};
+        for (int corner{0}; corner < 3; ++corner) {
+          auto p{positions_[triangle[corner]]};
+          allowed = allowed && !frozen[p];
+          shared = shared || p == to;
+          before[corner] = after[corner] = position(triangle[corner]);
+          if (p == collapse.from) {
+            after[corner] = position(collapse.to_vertex);
+          }
+        }
+        if (shared) {
+          ++removed;
+          continue;
+        }
+        // The triangle must not turn over.
+        auto normal_before{
+            glm::cross(before[1] - before[0], before[2] - before[0])};
+        auto normal_after{
+            glm::cross(after[1] - after[0], after[2] - after[0])};
+        allowed = allowed && glm::dot(normal_before, normal_after) > 0.0f;
+      }
+      if (!allowed) {
+        continue;
+      }
+
+      targets[collapse.from] = collapse.to_vertex;
+      quadrics_[to] += quadrics_[collapse.from];
+      max_error_ = std::max(max_error_, collapse.cost);
+      for (auto t{offsets[collapse.from]}; t < offsets[collapse.from + 1];
+           ++t) {
+        for (int corner{0}; corner < 3; ++corner) {
+          frozen[positions_[indices_[around[t] * 3 + corner]]] = 1;
+        }
+      }
+      triangles -= std::min(triangles, removed);
+      collapsed = true;
+    }
+    if (!collapsed) {
+      return false;
+    }
+
+    // Moves the collapsed corners and drops the triangles that lost their
+    // area.
+    std::size_t kept{0};
+    for (std::size_t i{0}; i < indices_.size(); i += 3) {
+      std::uint32_t triangle[3];
+      for (int corner{0}; corner < 3; ++corner) {
+        auto index{indices_[i + corner]};
+        auto target{targets[positions_[index]]};
+        triangle[corner] = target != unused ? target : index;
+      }
+      auto a{positions_[triangle[0]]}, b{positions_[triangle[1]]},
+          c{positions_[triangle[2]]};
+      if (a == b || b == c || c == a) {
+        continue;
+      }
+      std::copy(triangle, triangle + 3, indices_.begin() + kept);
+      kept += 3;
+    }
+    indices_.resize(kept);
+    return true;
+  }
+
+private:
+  static constexpr auto unused{~std::uint32_t{0}};
+
+  const glm::vec3 &position(std::uint32_t vertex) const {
+    return vertices_[vertex].position;
+  }
+
+  const std::vector<MeshVertex> &vertices_;
+  std::vector<std::uint32_t> indices_;
+  // Per vertex, the first vertex with its position. The other members are
+  // per such first vertex.
+  std::vector<std::uint32_t> positions_;
+  std::vector<std::uint8_t> locked_;
+  std::vector<Quadric> quadrics_;
+  double max_error_{0.0};
+};
+
+} // namespace
+
+bool load_obj(const std::string &path, Mesh &mesh) {
+  MappedFile file;
+  if (!file.open(path)) {
+    return false;
+  }
+  std::string_view text{reinterpret_cast<const char *>(file.data()),
+                        file.size()};
+
+  std::vector<glm::vec3> positions, normals, uvs;
+  std::unordered_map<Corner, std::uint32_t, CornerHash> vertex_indices;
+  std::vector<std::uint32_t> polygon;
+  mesh.vertices.clear();
+  mesh.indices.clear();
+  mesh.lods.clear();
+  std::size_t line_number{0};
+  while (!text.empty()) {
+    auto end{std::min(text.find('\n'), text.size())};
+    auto line{text.substr(0, end)};
+    text.remove_prefix(std::min(end + 1, text.size()));
+    ++line_number;
+
+    auto keyword{next_token(line)};
+    auto valid{true};
+    if (keyword == "v") {
+      valid = parse_vector<3>(line, positions);
+    } else if (keyword == "vn") {
+      valid = parse_vector<3>(line, normals);
+    } else if (keyword == "vt") {
+      valid = parse_vector<2>(line, uvs);
+    } else if (keyword == "f") {
+      polygon.clear();
+      for (auto token{next_token(line)}; valid && !token.empty();
+           token = next_token(line)) {
+        Corner corner;
+        valid = parse_corner(token, positions.size(), uvs.size(),
+                             normals.size(), corner);
+        if (!valid) {
+          break;
+        }
+        auto [it, inserted]{vertex_indices.try_emplace(
+            corner, static_cast<std::uint32_t>(mesh.vertices.size()))};
+        if (inserted) {
+          MeshVertex vertex{positions[corner.position], glm::vec3{0.0f},
+                            glm::vec2{0.0f}};
+          if (corner.normal >= 0) {
+            vertex.normal = normals[corner.normal];
+          }
+          if (corner.uv >= 0) {
+            vertex.uv = glm::vec2{uvs[corner.uv].x, uvs[corner.uv].y};
+          }
+          mesh.vertices.push_back(vertex);
+        }
+        polygon.push_back(it->second);
+      }
+      valid = valid && polygon.size() >= 3;
+      for (std::size_t i{2}; valid && i < polygon.size(); ++i) {
+        mesh.indices.insert(mesh.indices.end(),
+                            {polygon[0], polygon[i - 1], polygon[i]});
+      }
+    }
+    // Groups, materials and smoothing are not needed for a single mesh.
+    if (!valid) {
+      log_error("Invalid OBJ data in {} at line {}", path, line_number);
+      return false;
+    }
+  }
+  return true;
+}
+
+VertexCacheStatistics
+analyze_vertex_cache(const std::vector<std::uint32_t> &indices,
+                     std::size_t vertex_count, unsigned cache_size) {
+  CacheModel cache{vertex_count, cache_size};
+  std::vector<bool> used(vertex_count, false);
+  std::size_t misses{0}, used_count{0};
+  for (auto index : indices) {
+    misses += cache.access(index);
+    if (!used[index]) {
+      used[index] = true;
+      ++used_count;
+    }
+  }
+  auto triangles{indices.size() / 3};
+  return {triangles ? static_cast<double>(misses) / triangles : 0.0,
+          used_count ? static_cast<double>(misses) / used_count : 0.0};
+}
+
+std::vector<std::size_t>
+optimize_vertex_cache(std::vector<std::uint32_t> &indices,
+                      std::size_t vertex_count, unsigned cache_size,
+                      double cluster_threshold) {
+  auto triangle_count{indices.size() / 3};
+  std::vector<std::size_t> clusters;
+  if (triangle_count == 0) {
+    return clusters;
+  }
+
+  Adjacency adjacency{indices, vertex_count};
+  std::vector<std::uint32_t> live(vertex_count);
+  for (std::uint32_t v{0}; v < vertex_count; ++v) {
+    live[v] = adjacency.count(v);
+  }
+  std::vector<bool> emitted(triangle_count, false);
+  std::vector<std::uint32_t> dead_ends, candidates, output;
+  output.reserve(indices.size());
+  // Where Tipsify had to jump: the cache holds nothing useful there, so these
+  // are free cluster boundaries.
+  std::vector<std::size_t> hard_boundaries;
+  CacheModel cache{vertex_count, cache_size};
+  std::uint32_t scan{0};
+
+  auto next_from_dead_ends{[&]() -> std::int64_t {
+    while (!dead_ends.empty()) {
+      auto vertex{dead_ends.back()};
+      dead_ends.pop_back();
+      if (live[vertex] > 0) {
+        return vertex;
+      }
+    }
+    for (; scan < vertex_count; ++scan) {
+      if (live[scan] > 0) {
+        return scan;
+      }
+    }
+    return -1;
+  }};
+
+  std::int64_t fan{indices[0]};
+  while (fan >= 0) {
+    candidates.clear();
+    auto vertex{static_cast<std::uint32_t>(fan)};
+    for (auto i{adjacency.offsets[vertex]}; i < adjacency.offsets[vertex + 1];
+         ++i) {
+      auto triangle{adjacency.triangles[i]};
+      if (emitted[triangle]) {
+        continue;
+      }
+      emitted[triangle] = true;
+      for (int corner{0}; corner < 3; ++corner) {
+        auto v{indices[triangle * 3 + corner]};
+        output.push_back(v);
+        dead_ends.push_back(v);
+        candidates.push_back(v);
+        --live[v];
+        cache.access(v);
+      }
+    }
+
+    // Prefer the candidate that stays cached while its remaining triangles
+    // are emitted, and among those the oldest.
+    fan = -1;
+    std::int64_t best_priority{-1};
+    for (auto v : candidates) {
+      if (live[v] == 0) {
+        continue;
+      }
+      std::int64_t priority{0};
+      if (cache.age(v) + 2 * live[v] <= cache_size) {
+        priority = static_cast<std::int64_t>(cache.age(v));
+      }
+      if (priority > best_priority) {
+        best_priority = priority;
+        fan = v;
+      }
+    }
+    if (fan < 0) {
+      fan = next_from_dead_ends();
+      hard_boundaries.push_back(output.size());
+    }
+  }
+
+  // Soft boundaries: split the runs between hard boundaries wherever the
+  // cluster so far, simulated from a cold cache, is already close to the
+  // ACMR of the whole order.
+  auto acmr{analyze_vertex_cache(output, vertex_count, cache_size).acmr};
+  CacheModel cluster_cache{vertex_count, cache_size};
+  std::size_t cluster_misses{0}, cluster_triangles{0};
+  auto hard{hard_boundaries.begin()};
+  clusters.push_back(0);
+  for (std::size_t i{0}; i < output.size(); i += 3) {
+    for (int corner{0}; corner < 3; ++corner) {
+      cluster_misses += cluster_cache.access(output[i + corner]);
+    }
+    ++cluster_triangles;
+    auto end{i + 3};
+    while (hard != hard_boundaries.end() && *hard < end) {
+      ++hard;
+    }
+    auto at_hard{hard != hard_boundaries.end() && *hard == end};
+    auto cheap{static_cast<double>(cluster_misses) / cluster_triangles <=
+               cluster_threshold * acmr};
+    if (end < output.size() && (at_hard || cheap)) {
+      clusters.push_back(end);
+      cluster_cache.reset();
+      cluster_misses = 0;
+      cluster_triangles = 0;
+    }
+  }
+
+  indices = std::move(output);
+  return clusters;
+}
+
+void optimize_overdraw(std::vector<std::uint32_t> &indices,
+                       const std::vector<std::size_t> &clusters,
+                       const std::vector<MeshVertex> &vertices) {
+  if (clusters.size() < 2) {
+    return;
+  }
+
+  auto triangle_data{[&](std::size_t i, glm::vec3 &centroid) {
+    auto &a{vertices[indices[i]].position};
+    auto &b{vertices[indices[i + 1]].position};
+    auto &c{vertices[indices[i + 2]].position};
+    centroid = (a + b + c) / 3.0f;
+    // Twice the area, along the face normal.
+    return glm::cross(b - a, c - a);
+  }};
+
+  // Area weighted, so that slivers do not pull the centre around.
+  glm::vec3 mesh_centre{0.0f};
+  float mesh_area{0.0f};
+  for (std::size_t i{0}; i < indices.size(); i += 3) {
+    glm::vec3 centroid;
+    auto area{glm::length(triangle_data(i, centroid))};
+    mesh_centre += centroid * area;
+    mesh_area += area;
+  }
+  if (mesh_area > 0.0f) {
+    mesh_centre /= mesh_area;
+  }
+
+  struct Cluster {
+    std::size_t begin;
+    std::size_t end;
+    float sort_key;
+  };
+  std::vector<Cluster> sorted;
+  sorted.reserve(clusters.size());
+  for (std::size_t c{0}; c < clusters.size(); ++c) {
+    Cluster cluster{clusters[c],
+                    c + 1 < clusters.size() ? clusters[c + 1] : indices.size(),
+                    0.0f};
+    glm::vec3 centre{0.0f}, normal{0.0f};
+    float area{0.0f};
+    for (auto i{cluster.begin}; i < cluster.end; i += 3) {
+      glm::vec3 centroid;
+      auto weighted_normal{triangle_data(i, centroid)};
+      auto triangle_area{glm::length(weighted_normal)};
+      centre += centroid * triangle_area;
+      normal += weighted_normal;
+      area += triangle_area;
+    }
+    if (area > 0.0f && glm::length(normal) > 0.0f) {
+      cluster.sort_key = glm::dot(centre / area - mesh_centre,
+                                  glm::normalize(normal));
+    }
+    sorted.push_back(cluster);
+  }
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const Cluster &a, const Cluster &b) {
+                     return a.sort_key > b.sort_key;
+                   });
+
+  std::vector<std::uint32_t> output;
+  output.reserve(indices.size());
+  for (auto &cluster : sorted) {
+    output.insert(output.end(), indices.begin() + cluster.begin,
+                  indices.begin() + cluster.end);
+  }
+  indices = std::move(output);
+}
+
+void optimize_vertex_fetch(Mesh &mesh) {
+  constexpr auto unused{~std::uint32_t{0}};
+  std::vector<std::uint32_t> remap(mesh.vertices.size(), unused);
+  std::vector<MeshVertex> vertices;
+  vertices.reserve(mesh.vertices.size());
+  for (auto &index : mesh.indices) {
+    if (remap[index] == unused) {
+      remap[index] = static_cast<std::uint32_t>(vertices.size());
+      vertices.push_back(mesh.vertices[index]);
+    }
+    index = remap[index];
+  }
+  mesh.vertices = std::move(vertices);
+}
+
+void optimize_mesh(Mesh &mesh, unsigned cache_size) {
+  auto clusters{
+      optimize_vertex_cache(mesh.indices, mesh.vertices.size(), cache_size)};
+  optimize_overdraw(mesh.indices, clusters, mesh.vertices);
+  optimize_vertex_fetch(mesh);
+}
+
+void generate_lods(Mesh &mesh, std::size_t max_levels, float ratio,
+                   unsigned cache_size) {
+  if (mesh.lods.empty()) {
+    mesh.lods.push_back(
+        {0, static_cast<std::uint32_t>(mesh.indices.size()), 0.0f});
+  }
+  auto full{mesh.lods.front()};
+  mesh.lods.resize(1);
+  mesh.indices.resize(full.first_index + full.index_count);
+
+  Simplifier simplifier{
+      mesh.vertices,
+      {mesh.indices.begin() + full.first_index, mesh.indices.end()}};
+  while (mesh.lods.size() < max_levels) {
+    auto previous{mesh.lods.back().index_count / 3};
+    auto target{static_cast<std::size_t>(previous * ratio)};
+    while (simplifier.triangle_count() > target &&
+           simplifier.pass(target)) {
+    }
+    // A level that saves little is not worth switching to.
+    if (simplifier.triangle_count() > previous * (1.0f + ratio) / 2.0f) {
+      break;
+    }
+    auto indices{simplifier.indices()};
+    optimize_vertex_cache(indices, mesh.vertices.size(), cache_size);
+    mesh.lods.push_back({static_cast<std::uint32_t>(mesh.indices.size()),
+                         static_cast<std::uint32_t>(indices.size()),
+                         simplifier.error()});
+    mesh.indices.insert(mesh.indices.end(), indices.begin(), indices.end());
+  }
+}
+
+} // namespace common
@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <common/log.hpp>
+#include <common/mapped_file.hpp>
+#include <common/mesh_file.hpp>
+#include <common/state_cache.hpp>
+#include <fstream>
+#include <limits>
+#include <type_traits>
+
+namespace common {
+
+namespace {
+
+static_assert(std::is_trivially_copyable_v<MeshVertex> &&
+                  sizeof(MeshVertex) == 8 * sizeof(float),
+              "MeshVertex is written to and mapped from files as is");
+static_assert(std::is_trivially_copyable_v<MeshLod> &&
+                  sizeof(MeshLod) == 3 * sizeof(std::uint32_t),
+              "MeshLod is written to and mapped from files as is");
+
+std::uint64_t align_up(std::uint64_t value) {
+  return (value + mesh_file_alignment - 1) & ~(mesh_file_alignment - 1);
+}
+
+// Neither target is part of any vertex array, so the uploads leave the
+// bound one alone.
+void upload_blob(GLuint buffer, const std::byte *data, std::uint64_t size,
+                 std::size_t piece_size) {
+  auto &state{gl_state()};
+  state.bind_buffer(GL_COPY_WRITE_BUFFER, buffer);
+  glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(size), nullptr,
+               GL_STATIC_DRAW);
+  for (std::uint64_t offset{0}; offset < size; offset += piece_size) {
+    auto piece{std::min<std::uint64_t>(piece_size, size - offset)};
+    glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(offset),
+                    static_cast<GLsizeiptr>(piece), data + offset);
+  }
+  state.bind_buffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+} // namespace
+
+bool write_mesh_file(const std::string &path,
+                     const std::vector<Mesh> &meshes) {
+  std::vector<MeshFileChunk> chunks;
+  std::vector<MeshLod> lods;
+  std::uint64_t vertex_count{0}, index_count{0};
+  for (auto &mesh : meshes) {
+    if (vertex_count + mesh.vertices.size() >
+            std::numeric_limits<std::uint32_t>::max() ||
+        index_count + mesh.indices.size() >
+            std::numeric_limits<std::uint32_t>::max()) {
+      log_error("Too many vertices or indices for {}", path);
+      return false;
+    }
+    MeshFileChunk chunk{static_cast<std::uint32_t>(vertex_count),
+                        static_cast<std::uint32_t>(mesh.vertices.size()),
+                        static_cast<std::uint32_t>(index_count),
+                        static_cast<std::uint32_t>(mesh.indices.size()),
+                        glm::vec3{0.0f},
+                        glm::vec3{0.0f},
+                        static_cast<std::uint32_t>(lods.size()),
+                        0};
+    if (mesh.lods.empty()) {
+      lods.push_back({chunk.first_index, chunk.index_count, 0.0f});
+    }
+    for (auto lod : mesh.lods) {
+      lod.first_index += chunk.first_index;
+      lods.push_back(lod);
+    }
+    chunk.lod_count = static_cast<std::uint32_t>(lods.size()) - chunk.first_lod;
+    chunk.index_count = lods[chunk.first_lod].index_count;
+    if (!mesh.vertices.empty()) {
+      chunk.bounds_min = chunk.bounds_max = mesh.vertices.front().position;
+    }
+    for (auto &vertex : mesh.vertices) {
+      chunk.bounds_min = glm::min(chunk.bounds_min, vertex.position);
+      chunk.bounds_max = glm::max(chunk.bounds_max, vertex.position);
+    }
+    chunks.push_back(chunk);
+    vertex_count += mesh.vertices.size();
+    index_count += mesh.indices.size();
+  }
+
+  MeshFileHeader header{mesh_file_magic,
+                        mesh_file_version,
+                        sizeof(MeshVertex),
+                        static_cast<std::uint32_t>(chunks.size()),
+                        0,
+                        vertex_count * sizeof(MeshVertex),
+                        0,
+                        index_count * sizeof(std::uint32_t)};
+  header.vertex_offset =
+      align_up(sizeof(header) + chunks.size() * sizeof(MeshFileChunk) +
+               lods.size() * sizeof(MeshLod));
+  header.index_offset = align_up(header.vertex_offset + header.vertex_size);
+
+  std::ofstream file{path, std::ios::binary | std::ios::trunc};
+  if (!file) {
+    log_error("Failed to open {}", path);
+    return false;
+  }
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(chunks.data()),
+             chunks.size() * sizeof(MeshFileChunk));
+  file.write(reinterpret_cast<const char *>(lods.data()),
+             lods.size() * sizeof(MeshLod));
+  file.seekp(header.vertex_offset);
+  for (auto &mesh : meshes) {
+    file.write(reinterpret_cast<const char *>(mesh.vertices.data()),
+               mesh.vertices.size() * sizeof(MeshVertex));
+  }
+  file.seekp(header.index_offset);
+  std::vector<std::uint32_t> indices;
+  for (std::size_t i{0}; i < meshes.size(); ++i) {
+    indices = meshes[i].indices;
+    for (auto &index : indices) {
+      index += chunks[i].first_vertex;
+    }
+    file.write(reinterpret_cast<const char *>(indices.data()),
+               indices.size() * sizeof(std::uint32_t));
+  }
+  if (!file) {
+    log_error("Failed to write {}", path);
+    return false;
+  }
+  return true;
+}
+
+bool upload_mesh_file(const std::string &path, GLuint vertex_buffer,
+                      GLuint index_buffer, std::vector<MeshFileChunk> &chunks,
+                      std::vector<MeshLod> &lods, std::size_t piece_size) {
+  MappedFile file;
+  if (!file.open(path)) {
+    return false;
+  }
+
+  MeshFileHeader header;
+  if (file.size() < sizeof(header)) {
+    log_error("Truncated mesh file {}", path);
+    return false;
+  }
+  header = *reinterpret_cast<const MeshFileHeader *>(file.data());
+  if (header.magic != mesh_file_magic ||
+      header.version != mesh_file_version ||
+      header.vertex_stride != sizeof(MeshVertex)) {
+    log_error("Unsupported mesh file {}", path);
+    return false;
+  }
+  auto table_end{sizeof(header) +
+                 std::uint64_t{header.chunk_count} * sizeof(MeshFileChunk)};
+  if (file.size() < table_end || header.vertex_offset > file.size() ||
+      header.vertex_size > file.size() - header.vertex_offset ||
+      header.index_offset > file.size() ||
+      header.index_size > file.size() - header.index_offset) {
+    log_error("Truncated mesh file {}", path);
+    return false;
+  }
+
+  auto table{
+      reinterpret_cast<const MeshFileChunk *>(file.data() + sizeof(header))};
+  chunks.assign(table, table + header.chunk_count);
+  std::uint64_t lod_count{0};
+  for (auto &chunk : chunks) {
+    lod_count = std::max(lod_count,
+                         std::uint64_t{chunk.first_lod} + chunk.lod_count);
+  }
+  if (file.size() < table_end + lod_count * sizeof(MeshLod)) {
+    log_error("Truncated mesh file {}", path);
+    chunks.clear();
+    return false;
+  }
+  auto lod_table{reinterpret_cast<const MeshLod *>(file.data() + table_end)};
+  lods.assign(lod_table, lod_table + lod_count);
+
+  auto index_count{header.index_size / sizeof(std::uint32_t)};
+  auto valid{[&](const MeshFileChunk &chunk) {
+    if (std::uint64_t{chunk.first_vertex} + chunk.vertex_count >
+            header.vertex_size / sizeof(MeshVertex) ||
+        std::uint64_t{chunk.first_index} + chunk.index_count > index_count ||
+        chunk.lod_count == 0) {
+      return false;
+    }
+    for (auto i{chunk.first_lod}; i < chunk.first_lod + chunk.lod_count;
+         ++i) {
+      if (std::uint64_t{lods[i].first_index} + lods[i].index_count >
+          index_count) {
+        return false;
+      }
+    }
+    return true;
+  }};
+  if (!std::all_of(chunks.begin(), chunks.end(), valid)) {
+    log_error("Invalid chunk table in {}", path);
+    chunks.clear();
+    lods.clear();
+    return false;
+  }
+
+  piece_size = std::max<std::size_t>(piece_size, 1);
+  upload_blob(vertex_buffer, file.data() + header.vertex_offset,
+              header.vertex_size, piece_size);
+  upload_blob(index_buffer, file.data() + header.index_offset,
+              header.index_size, piece_size);
+  return true;
+}
+
+void set_mesh_vertex_attributes(GLuint buffer, GLint position_location,
+                                GLint normal_location, GLint uv_location) {
+  gl_state().bind_buffer(GL_ARRAY_BUFFER, buffer);
+  auto set{[](GLint location, GLint size, std::size_t offset) {
+    if (location < 0) {
+      return;
+    }
+    glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE,
+                          sizeof(MeshVertex), (void *)offset);
+    glEnableVertexAttribArray(location);
+  }};
+  set(position_location, 3, offsetof(MeshVertex, position));
+  set(normal_location, 3, offsetof(MeshVertex, normal));
+  set(uv_location, 2, offsetof(MeshVertex, uv));
+}
+
+} // namespace common
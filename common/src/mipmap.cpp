@@ -0,0 +1,376 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <common/mipmap.hpp>
+#include <common/parallel.hpp>
+#include <cstddef>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define COMMON_MIPMAP_SSE
+#endif
+#if defined(__AVX2__) && defined(__FMA__)
+#define COMMON_MIPMAP_AVX2
+#endif
+
+namespace common {
+
+namespace {
+
+// Rows handed to one thread at a time; below this, threads cost more than
+// they save.
+constexpr std::size_t min_rows_per_thread{16};
+
+// Working format: four floats per texel, whatever the channel count.
+struct FloatImage {
+  int width{0};
+  int height{0};
+  std::vector<float> texels;
+
+  FloatImage() = default;
+  FloatImage(int width, int height)
+      : width{width}, height{height},
+        texels(static_cast<std::size_t>(width) * height * 4) {}
+
+  float *row(int y) {
+    return texels.data() + static_cast<std::size_t>(y) * width * 4;
+  }
+  const float *row(int y) const {
+    return texels.data() + static_cast<std::size_t>(y) * width * 4;
+  }
+};
+
+const std::array<float, 256> &srgb_to_linear() {
+  static const auto table{[] {
+    std::array<float, 256> table;
+    for (int i{0}; i < 256; ++i) {
+      auto c{i / 255.0};
+      table[i] = static_cast<float>(
+          c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+    }
+    return table;
+  }()};
+  return table;
+}
+
+// Indexed by linear values quantised to 16 bits, which keeps even the
+// darkest sRGB steps apart.
+constexpr int linear_to_srgb_size{1 << 16};
+
+const std::vector<unsigned char> &linear_to_srgb() {
+  static const auto table{[] {
+    std::vector<unsigned char> table(linear_to_srgb_size);
+    for (int i{0}; i < linear_to_srgb_size; ++i) {
+      auto v{i / double(linear_to_srgb_size - 1)};
+      auto s{v <= 0.0031308 ? v * 12.92 : 1.055 * std::pow(v, 1 / 2.4) - 0.055};
+      table[i] = static_cast<unsigned char>(std::lround(s * 255.0));
+    }
+    return table;
+  }()};
+  return table;
+}
+
+// Taps of the 2x Kaiser-windowed sinc, centred between source texels
+// 2x and 2x + 1: source texel 2x - 2 + k gets weight kaiser_weights()[k].
+constexpr int kaiser_taps{6};
+
+double bessel_i0(double x) {
+  double sum{1.0}, term{1.0};
+  for (int k{1}; k < 32; ++k) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+const std::array<float, kaiser_taps> &kaiser_weights() {
+  static const auto weights{[] {
+    constexpr double pi{3.14159265358979323846};
+    constexpr double alpha{4.0};
+    constexpr double radius{kaiser_taps / 2.0};
+    std::array<double, kaiser_taps> raw;
+    double sum{0.0};
+    for (int k{0}; k < kaiser_taps; ++k) {
+      auto d{k - radius + 0.5};
+      // Half-band low-pass for the 2x reduction.
+      auto x{pi * d / 2.0};
+      auto sinc{std::sin(x) / x};
+      auto t{d / radius};
+      auto window{bessel_i0(alpha * std::sqrt(1.0 - t * t)) /
+                  bessel_i0(alpha)};
+      raw[k] = sinc * window;
+      sum += raw[k];
+    }
+    std::array<float, kaiser_taps> weights;
+    for (int k{0}; k < kaiser_taps; ++k) {
+      weights[k] = static_cast<float>(raw[k] / sum);
+    }
+    return weights;
+  }()};
+  return weights;
+}
+
+void decode_rows(const unsigned char *pixels, int channels, bool srgb,
+                 FloatImage &image, int begin, int end) {
+  auto &table{srgb_to_linear()};
+  auto color_channels{srgb && channels >= 3 ? 3 : 0};
+  for (int y{begin}; y < end; ++y) {
+    auto source{pixels +
+                static_cast<std::size_t>(y) * image.width * channels};
+    auto row{image.row(y)};
+    for (int x{0}; x < image.width; ++x) {
+      for (int c{0}; c < 4; ++c) {
+        if (c >= channels) {
+          row[4 * x + c] = c == 3 ? 1.0f : 0.0f;
+        } else if (c < color_channels) {
+          row[4 * x + c] = table[source[x * channels + c]];
+        } else {
+          row[4 * x + c] = source[x * channels + c] / 255.0f;
+        }
+      }
+    }
+  }
+}
+
+void encode_rows(const FloatImage &image, int channels, bool srgb,
+                 MipmapLevel &level, int begin, int end) {
+  auto &table{linear_to_srgb()};
+  auto color_channels{srgb && channels >= 3 ? 3 : 0};
+  for (int y{begin}; y < end; ++y) {
+    auto row{image.row(y)};
+    auto target{level.pixels.data() +
+                static_cast<std::size_t>(y) * image.width * channels};
+    for (int x{0}; x < image.width; ++x) {
+      for (int c{0}; c < channels; ++c) {
+        // Sinc lobes can overshoot, so clamp before quantising.
+        auto v{std::clamp(row[4 * x + c], 0.0f, 1.0f)};
+        target[x * channels + c] =
+            c < color_channels
+                ? table[static_cast<int>(v * (linear_to_srgb_size - 1) + 0.5f)]
+                : static_cast<unsigned char>(v * 255.0f + 0.5f);
+      }
+    }
+  }
+}
+
+void box_rows(const FloatImage &source, FloatImage &target, int begin,
+              int end) {
+  for (int y{begin}; y < end; ++y) {
+    auto row0{source.row(std::min(2 * y, source.height - 1))};
+    auto row1{source.row(std::min(2 * y + 1, source.height - 1))};
+    auto out{target.row(y)};
+    int x{0};
+    // With at least two source columns, 2x + 1 never leaves the row.
+    if (source.width >= 2) {
+#if defined(COMMON_MIPMAP_AVX2)
+      auto quarter8{_mm256_set1_ps(0.25f)};
+      for (; x + 1 < target.width; x += 2) {
+        auto a{_mm256_add_ps(_mm256_loadu_ps(row0 + 8 * x),
+                             _mm256_loadu_ps(row1 + 8 * x))};
+        auto b{_mm256_add_ps(_mm256_loadu_ps(row0 + 8 * x + 8),
+                             _mm256_loadu_ps(row1 + 8 * x + 8))};
+        // Pair up the left and right texel of both outputs.
+        auto left{_mm256_permute2f128_ps(a, b, 0x20)};
+        auto right{_mm256_permute2f128_ps(a, b, 0x31)};
+        _mm256_storeu_ps(out + 4 * x,
+                         _mm256_mul_ps(_mm256_add_ps(left, right), quarter8));
+      }
+#endif
+#if defined(COMMON_MIPMAP_SSE)
+      auto quarter{_mm_set1_ps(0.25f)};
+      for (; x < target.width; ++x) {
+        auto sum{_mm_add_ps(_mm_add_ps(_mm_loadu_ps(row0 + 8 * x),
+                                       _mm_loadu_ps(row1 + 8 * x)),
+                            _mm_add_ps(_mm_loadu_ps(row0 + 8 * x + 4),
+                                       _mm_loadu_ps(row1 + 8 * x + 4)))};
+        _mm_storeu_ps(out + 4 * x, _mm_mul_ps(sum, quarter));
+      }
+#endif
+    }
+    for (; x < target.width; ++x) {
+      auto x0{std::min(2 * x, source.width - 1)};
+      auto x1{std::min(2 * x + 1, source.width - 1)};
+      for (int c{0}; c < 4; ++c) {
+        // Same summation order as the SIMD paths, so all give equal bytes.
+        out[4 * x + c] = ((row0[4 * x0 + c] + row1[4 * x0 + c]) +
+                          (row0[4 * x1 + c] + row1[4 * x1 + c])) *
+                         0.25f;
+      }
+    }
+  }
+}
+
+// Horizontal Kaiser pass: source rows into rows of target width.
+void kaiser_horizontal_rows(const FloatImage &source, FloatImage &target,
+                            int begin, int end) {
+  auto &weights{kaiser_weights()};
+  // Outputs whose taps 2x - 2 .. 2x + 3 all lie inside the row.
+  auto interior_begin{1};
+  auto interior_end{std::max(interior_begin, (source.width - 2) / 2)};
+  for (int y{begin}; y < end; ++y) {
+    auto in{source.row(y)};
+    auto out{target.row(y)};
+    for (int x{0}; x < target.width; ++x) {
+      if (x >= interior_begin && x < interior_end) {
+        auto taps{in + 4 * (2 * x - 2)};
+#if defined(COMMON_MIPMAP_AVX2)
+        if (x + 1 < interior_end) {
+          // Two outputs at once; their taps are two texels apart.
+          auto sum{_mm256_setzero_ps()};
+          for (int k{0}; k < kaiser_taps; ++k) {
+            auto v{_mm256_insertf128_ps(
+                _mm256_castps128_ps256(_mm_loadu_ps(taps + 4 * k)),
+                _mm_loadu_ps(taps + 4 * (k + 2)), 1)};
+            sum = _mm256_fmadd_ps(v, _mm256_set1_ps(weights[k]), sum);
+          }
+          _mm256_storeu_ps(out + 4 * x, sum);
+          ++x;
+          continue;
+        }
+#endif
+#if defined(COMMON_MIPMAP_SSE)
+        auto sum{_mm_setzero_ps()};
+        for (int k{0}; k < kaiser_taps; ++k) {
+          sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(taps + 4 * k),
+                                           _mm_set1_ps(weights[k])));
+        }
+        _mm_storeu_ps(out + 4 * x, sum);
+        continue;
+#endif
+      }
+      for (int c{0}; c < 4; ++c) {
+        float sum{0.0f};
+        for (int k{0}; k < kaiser_taps; ++k) {
+          auto tap{std::clamp(2 * x - 2 + k, 0, source.width - 1)};
+          sum += weights[k] * in[4 * tap + c];
+        }
+        out[4 * x + c] = sum;
+      }
+    }
+  }
+}
+
+// Vertical Kaiser pass: every float of a target row is an independent
+// weighted sum of six source rows, so the loop vectorises across the row.
+void kaiser_vertical_rows(const FloatImage &source, FloatImage &target,
+                          int begin, int end) {
+  auto &weights{kaiser_weights()};
+  auto row_floats{static_cast<std::size_t>(target.width) * 4};
+  for (int y{begin}; y < end; ++y) {
+    std::array<const float *, kaiser_taps> rows;
+    for (int k{0}; k < kaiser_taps; ++k) {
+      rows[k] = source.row(std::clamp(2 * y - 2 + k, 0, source.height - 1));
+    }
+    auto out{target.row(y)};
+    std::size_t i{0};
+#if defined(COMMON_MIPMAP_AVX2)
+    for (; i + 8 <= row_floats; i += 8) {
+      auto sum{_mm256_setzero_ps()};
+      for (int k{0}; k < kaiser_taps; ++k) {
+        sum = _mm256_fmadd_ps(_mm256_loadu_ps(rows[k] + i),
+                              _mm256_set1_ps(weights[k]), sum);
+      }
+      _mm256_storeu_ps(out + i, sum);
+    }
+#endif
+#if defined(COMMON_MIPMAP_SSE)
+    for (; i + 4 <= row_floats; i += 4) {
+      auto sum{_mm_setzero_ps()};
+      for (int k{0}; k < kaiser_taps; ++k) {
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[k] + i),
+                                         _mm_set1_ps(weights[k])));
+      }
+      _mm_storeu_ps(out + i, sum);
+    }
+#endif
+    for (; i < row_floats; ++i) {
+      float sum{0.0f};
+      for (int k{0}; k < kaiser_taps; ++k) {
+        sum += weights[k] * rows[k][i];
+      }
+      out[i] = sum;
+    }
+  }
+}
+
+} // namespace
+
+std::vector<MipmapLevel> build_mipmaps(const unsigned char *pixels, int width,
+                                       int height, int channels,
+                                       const MipmapOptions &options) {
+  auto level_count{0};
+  for (auto size{std::max(width, height)}; size > 1; size /= 2) {
+    ++level_count;
+  }
+  std::vector<MipmapLevel> levels;
+  // Encoding keeps a pointer to the previous level across iterations.
+  levels.reserve(level_count);
+
+  FloatImage current{width, height};
+  parallel_for(height, options.threads, min_rows_per_thread,
+               [&](std::size_t begin, std::size_t end) {
+                 decode_rows(pixels, channels, options.srgb, current, begin,
+                             end);
+               });
+
+  // The level whose float data is `current` but that is not encoded yet.
+  MipmapLevel *unencoded{nullptr};
+  auto encode{[&](std::size_t begin, std::size_t end) {
+    encode_rows(current, channels, options.srgb, *unencoded, begin, end);
+  }};
+
+  // Runs filter(begin, end) over `rows` rows, and in the same parallel
+  // region encodes the previous level, which only reads `current`.
+  auto filter_and_encode{[&](int rows, auto &&filter) {
+    std::size_t filter_rows{static_cast<std::size_t>(rows)};
+    std::size_t previous_rows{
+        unencoded ? static_cast<std::size_t>(unencoded->height) : 0};
+    parallel_for(filter_rows + previous_rows, options.threads,
+                 min_rows_per_thread,
+                 [&](std::size_t begin, std::size_t end) {
+                   if (begin < filter_rows) {
+                     filter(begin, std::min(end, filter_rows));
+                   }
+                   if (end > filter_rows) {
+                     encode(std::max(begin, filter_rows) - filter_rows,
+                            end - filter_rows);
+                   }
+                 });
+    unencoded = nullptr;
+  }};
+
+  while (current.width > 1 || current.height > 1) {
+    FloatImage next{std::max(1, current.width / 2),
+                    std::max(1, current.height / 2)};
+
+    if (options.filter == MipmapFilter::box) {
+      filter_and_encode(next.height, [&](std::size_t begin, std::size_t end) {
+        box_rows(current, next, begin, end);
+      });
+    } else {
+      FloatImage horizontal{next.width, current.height};
+      filter_and_encode(current.height,
+                        [&](std::size_t begin, std::size_t end) {
+                          kaiser_horizontal_rows(current, horizontal, begin,
+                                                 end);
+                        });
+      parallel_for(next.height, options.threads, min_rows_per_thread,
+                   [&](std::size_t begin, std::size_t end) {
+                     kaiser_vertical_rows(horizontal, next, begin, end);
+                   });
+    }
+
+    levels.push_back({next.width, next.height,
+                      std::vector<unsigned char>(
+                          static_cast<std::size_t>(next.width) * next.height *
+                          channels)});
+    unencoded = &levels.back();
+    current = std::move(next);
+  }
+
+  if (unencoded) {
+    encode(0, unencoded->height);
+  }
+  return levels;
+}
+
+} // namespace common
@@ -0,0 +1,80 @@
+#include <common/morph.hpp>
+#include <common/state_cache.hpp>
+#include <vector>
+
+namespace common {
+
+const char morph_shader_source[]{
+    "uniform samplerBuffer u_morph_positions;\n"
+    "uniform int u_morph_vertex_count;\n"
+    "uniform int u_morph_keyframe_count;\n"
+    "uniform float u_morph_keyframe_duration;\n"
+    "uniform float u_morph_loop;\n"
+    "\n"
+    "vec3 morph_position(int vertex, float time)\n"
+    "{\n"
+    "  float count = float(u_morph_keyframe_count);\n"
+    "  float frame = time / u_morph_keyframe_duration;\n"
+    "  frame = mix(clamp(frame, 0.0, count - 1.0), mod(frame, count),\n"
+    "              u_morph_loop);\n"
+    "  float first = floor(frame);\n"
+    "  float second = mix(min(first + 1.0, count - 1.0),\n"
+    "                     mod(first + 1.0, count), u_morph_loop);\n"
+    "  vec3 a = texelFetch(u_morph_positions,\n"
+    "                      int(first) * u_morph_vertex_count + vertex).xyz;\n"
+    "  vec3 b = texelFetch(u_morph_positions,\n"
+    "                      int(second) * u_morph_vertex_count + vertex).xyz;\n"
+    "  return mix(a, b, frame - first);\n"
+    "}\n"};
+
+MorphAnimation::MorphAnimation(std::span<const glm::vec3> positions,
+                               int vertex_count, int keyframe_count,
+                               float keyframe_duration, bool loop)
+    : vertex_count_{vertex_count}, keyframe_count_{keyframe_count},
+      keyframe_duration_{keyframe_duration}, loop_{loop} {
+  // Texture buffers only take three-component formats from GL 4.0 on.
+  std::vector<glm::vec4> texels;
+  texels.reserve(positions.size());
+  for (auto &position : positions) {
+    texels.emplace_back(position, 1.0f);
+  }
+
+  glGenBuffers(1, &buffer_);
+  auto &state{gl_state()};
+  state.bind_buffer(GL_TEXTURE_BUFFER, buffer_);
+  glBufferData(GL_TEXTURE_BUFFER, texels.size() * sizeof(glm::vec4),
+               texels.data(), GL_STATIC_DRAW);
+  state.bind_buffer(GL_TEXTURE_BUFFER, 0);
+
+  glGenTextures(1, &texture_);
+  state.bind_texture(0, GL_TEXTURE_BUFFER, texture_);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer_);
+  state.bind_texture(0, GL_TEXTURE_BUFFER, 0);
+}
+
+MorphAnimation::~MorphAnimation() {
+  glDeleteTextures(1, &texture_);
+  glDeleteBuffers(1, &buffer_);
+  gl_state().forget_texture(texture_);
+  gl_state().forget_buffer(buffer_);
+}
+
+float MorphAnimation::duration() const {
+  return keyframe_duration_ * (loop_ ? keyframe_count_ : keyframe_count_ - 1);
+}
+
+void MorphAnimation::configure(const ProgramReflection &reflection,
+                               int texture_unit) const {
+  reflection.uniform<int>("u_morph_positions").set(texture_unit);
+  reflection.uniform<int>("u_morph_vertex_count").set(vertex_count_);
+  reflection.uniform<int>("u_morph_keyframe_count").set(keyframe_count_);
+  reflection.uniform<float>("u_morph_keyframe_duration")
+      .set(keyframe_duration_);
+  reflection.uniform<float>("u_morph_loop").set(loop_ ? 1.0f : 0.0f);
+}
+
+void MorphAnimation::bind(int texture_unit) const {
+  gl_state().bind_texture(texture_unit, GL_TEXTURE_BUFFER, texture_);
+}
+
+} // namespace common
@@ -0,0 +1,200 @@
+#include <atomic>
+#include <common/profiler.hpp>
+#include <iomanip>
+#include <sstream>
+#include <string_view>
+
+namespace common {
+
+namespace {
+
+// Weight of the newest frame in the moving averages.
+constexpr double average_weight{0.05};
+
+// Chrome trace thread id of the GPU zones.
+constexpr std::uint32_t gpu_thread{~std::uint32_t{0}};
+
+// Small, stable ids for the threads that open zones, in order of first use.
+std::uint32_t thread_index() {
+  static std::atomic<std::uint32_t> next{0};
+  thread_local auto index{next.fetch_add(1, std::memory_order_relaxed)};
+  return index;
+}
+
+} // namespace
+
+Profiler::Profiler(bool trace) : trace_{trace} {
+  GLint64 gpu_ns{0};
+  glGetInteger64v(GL_TIMESTAMP, &gpu_ns);
+  gpu_offset_ns_ = gpu_ns - now_ns();
+}
+
+Profiler::~Profiler() {
+  for (auto &frame : gpu_frames_) {
+    if (!frame.queries.empty()) {
+      glDeleteQueries(static_cast<GLsizei>(frame.queries.size()),
+                      frame.queries.data());
+    }
+  }
+}
+
+std::int64_t Profiler::now_ns() const {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() -
+                                                              epoch_)
+      .count();
+}
+
+void Profiler::begin_frame() {
+  frame_start_ns_ = now_ns();
+  auto &frame{gpu_frames_[frame_ % frames_in_flight]};
+  if (frame.pending && !collect(frame)) {
+    ++dropped_gpu_frames_;
+    frame.pending = false;
+  }
+  frame.used = 0;
+  frame.zones.clear();
+}
+
+void Profiler::end_frame() {
+  auto frame_end_ns{now_ns()};
+  auto &current{gpu_frames_[frame_ % frames_in_flight]};
+  current.pending = !current.zones.empty();
+  ++frame_;
+
+  // Pick up older frames whose results have arrived, oldest first.
+  for (std::size_t i{1}; i < frames_in_flight; ++i) {
+    auto &frame{gpu_frames_[(frame_ + i) % frames_in_flight]};
+    if (frame.pending) {
+      collect(frame);
+    }
+  }
+
+  std::lock_guard lock{mutex_};
+  auto frame_ms{(frame_end_ns - frame_start_ns_) / 1.0e6};
+  frame_average_ms_ = frame_ == 1 ? frame_ms
+                                  : frame_average_ms_ +
+                                        average_weight *
+                                            (frame_ms - frame_average_ms_);
+  for (auto &average : averages_) {
+    auto ms{average.frame_ns / 1.0e6};
+    average.average_ms =
+        average.frames++ == 0
+            ? ms
+            : average.average_ms + average_weight * (ms - average.average_ms);
+    average.frame_ns = 0.0;
+  }
+  if (trace_) {
+    zones_.push_back({"frame", thread_index(), frame_start_ns_,
+                      frame_end_ns - frame_start_ns_});
+  }
+}
+
+void Profiler::end_cpu_zone(const char *name, std::int64_t start_ns) {
+  auto duration_ns{now_ns() - start_ns};
+  std::lock_guard lock{mutex_};
+  accumulate(name, false, duration_ns);
+  if (trace_) {
+    zones_.push_back({name, thread_index(), start_ns, duration_ns});
+  }
+}
+
+GLuint Profiler::next_query() {
+  auto &frame{gpu_frames_[frame_ % frames_in_flight]};
+  if (frame.used == frame.queries.size()) {
+    frame.queries.push_back(0);
+    glGenQueries(1, &frame.queries.back());
+  }
+  return frame.queries[frame.used++];
+}
+
+void Profiler::end_gpu_zone(const char *name, std::size_t begin,
+                            std::size_t end) {
+  gpu_frames_[frame_ % frames_in_flight].zones.push_back({name, begin, end});
+}
+
+// Reads the timestamps of `frame` if all of them are available and returns
+// whether it did.
+bool Profiler::collect(GpuFrame &frame) {
+  for (std::size_t i{0}; i < frame.used; ++i) {
+    GLint available{GL_FALSE};
+    glGetQueryObjectiv(frame.queries[i], GL_QUERY_RESULT_AVAILABLE,
+                       &available);
+    if (!available) {
+      return false;
+    }
+  }
+  std::vector<GLuint64> timestamps(frame.used);
+  for (std::size_t i{0}; i < frame.used; ++i) {
+    glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &timestamps[i]);
+  }
+  frame.pending = false;
+
+  std::lock_guard lock{mutex_};
+  for (auto &zone : frame.zones) {
+    auto start_ns{static_cast<std::int64_t>(timestamps[zone.begin])};
+    auto duration_ns{static_cast<std::int64_t>(timestamps[zone.end]) -
+                     start_ns};
+    accumulate(zone.name, true, duration_ns);
+    if (trace_) {
+      zones_.push_back(
+          {zone.name, gpu_thread, start_ns - gpu_offset_ns_, duration_ns});
+    }
+  }
+  return true;
+}
+
+void Profiler::accumulate(const char *name, bool gpu,
+                          std::int64_t duration_ns) {
+  for (auto &average : averages_) {
+    if (average.gpu == gpu &&
+        (average.name == name || std::string_view{average.name} == name)) {
+      average.frame_ns += duration_ns;
+      return;
+    }
+  }
+  averages_.push_back({name, gpu, static_cast<double>(duration_ns), 0.0, 0});
+}
+
+void Profiler::write_trace(std::ostream &os) const {
+  std::lock_guard lock{mutex_};
+  os << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  os << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": "
+     << gpu_thread << ", \"args\": {\"name\": \"GPU\"}}";
+  os << std::fixed << std::setprecision(3);
+  for (auto &zone : zones_) {
+    os << ",\n  {\"name\": \"" << zone.name << "\", \"cat\": \""
+       << (zone.thread == gpu_thread ? "gpu" : "cpu")
+       << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << zone.thread
+       << ", \"ts\": " << zone.start_ns / 1.0e3
+       << ", \"dur\": " << zone.duration_ns / 1.0e3 << '}';
+  }
+  os << "\n]}\n";
+}
+
+std::string Profiler::summary() const {
+  std::lock_guard lock{mutex_};
+  std::ostringstream os;
+  os << std::fixed << std::setprecision(2) << "frame " << frame_average_ms_
+     << " ms";
+  for (auto &average : averages_) {
+    os << " | " << (average.gpu ? "gpu " : "") << average.name << ' '
+       << average.average_ms;
+  }
+  return os.str();
+}
+
+GpuZone::GpuZone(Profiler &profiler, const char *name)
+    : profiler_{profiler}, name_{name},
+      begin_{profiler.gpu_frames_[profiler.frame_ % Profiler::frames_in_flight]
+                 .used} {
+  glQueryCounter(profiler_.next_query(), GL_TIMESTAMP);
+}
+
+GpuZone::~GpuZone() {
+  auto end{profiler_.gpu_frames_[profiler_.frame_ % Profiler::frames_in_flight]
+               .used};
+  glQueryCounter(profiler_.next_query(), GL_TIMESTAMP);
+  profiler_.end_gpu_zone(name_, begin_, end);
+}
+
+} // namespace common
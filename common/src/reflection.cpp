@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <common/log.hpp>
+#include <common/reflection.hpp>
+#include <vector>
+
+namespace common {
+
+ProgramReflection::ProgramReflection(GLuint program) : program_{program} {
+  GLint uniform_count{0};
+  glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniform_count);
+  GLint max_name_length{0};
+  glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+
+  std::vector<GLchar> name_buffer(std::max(max_name_length, 1));
+  for (GLint i{0}; i < uniform_count; ++i) {
+    GLsizei name_length{0};
+    UniformInfo info;
+    glGetActiveUniform(program, i, name_buffer.size(), &name_length,
+                       &info.size, &info.type, name_buffer.data());
+    std::string name{name_buffer.data(), static_cast<size_t>(name_length)};
+    info.location = glGetUniformLocation(program, name.c_str());
+    // Uniforms inside blocks have no location and are not set this way.
+    if (info.location < 0) {
+      continue;
+    }
+    // Arrays are reported as "name[0]"; also make them reachable as "name".
+    if (name.ends_with("[0]")) {
+      uniforms_.emplace(name.substr(0, name.size() - 3), info);
+    }
+    uniforms_.emplace(std::move(name), info);
+  }
+}
+
+const ProgramReflection::UniformInfo *
+ProgramReflection::find(const std::string &name) const {
+  auto it{uniforms_.find(name)};
+  return it == uniforms_.end() ? nullptr : &it->second;
+}
+
+bool ProgramReflection::bind_uniform_block(const std::string &name,
+                                           GLuint binding) const {
+  auto index{glGetUniformBlockIndex(program_, name.c_str())};
+  if (index == GL_INVALID_INDEX) {
+    log_error("Program {} has no active uniform block {}", program_, name);
+    return false;
+  }
+  glUniformBlockBinding(program_, index, binding);
+  return true;
+}
+
+bool ProgramReflection::type_matches(GLenum declared, GLenum requested) {
+  if (declared == requested) {
+    return true;
+  }
+  // Samplers are set through their texture unit index.
+  if (requested == GL_INT) {
+    switch (declared) {
+    case GL_SAMPLER_1D:
+    case GL_SAMPLER_2D:
+    case GL_SAMPLER_3D:
+    case GL_SAMPLER_CUBE:
+    case GL_SAMPLER_1D_ARRAY:
+    case GL_SAMPLER_2D_ARRAY:
+    case GL_SAMPLER_BUFFER:
+    case GL_INT_SAMPLER_BUFFER:
+    case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+      return true;
+    }
+  }
+  return false;
+}
+
+void ProgramReflection::report_missing(const std::string &name) const {
+  log_error("Program {} has no active uniform {} of the requested type",
+            program_, name);
+}
+
+} // namespace common
@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <common/parallel.hpp>
+#include <common/scene_graph.hpp>
+
+namespace common {
+
+namespace {
+
+// Subtrees of up to this many nodes, or of a 64th of the graph if that is
+// more, are updated by one thread. Smaller ones would cost more to hand out
+// than to update.
+constexpr std::size_t min_task_nodes{1024};
+constexpr std::size_t tasks_per_graph{64};
+
+} // namespace
+
+std::uint32_t SceneGraph::add(std::uint32_t parent, const glm::mat4 &local) {
+  auto node{static_cast<std::uint32_t>(parents_.size())};
+  parents_.push_back(parent);
+  positions_.push_back(node);
+  nodes_.push_back(node);
+  parent_positions_.push_back(parent != no_parent ? positions_[parent]
+                                                  : no_parent);
+  locals_.push_back(local);
+  worlds_.push_back(local);
+  dirty_.push_back(0);
+  dirty_below_.push_back(0);
+  updated_in_.push_back(0);
+  order_stale_ = true;
+  set_local(node, local);
+  return node;
+}
+
+void SceneGraph::clear() {
+  parents_.clear();
+  positions_.clear();
+  nodes_.clear();
+  parent_positions_.clear();
+  locals_.clear();
+  worlds_.clear();
+  dirty_.clear();
+  dirty_below_.clear();
+  updated_in_.clear();
+  order_stale_ = true;
+  marked_ = false;
+}
+
+void SceneGraph::set_local(std::uint32_t node, const glm::mat4 &local) {
+  auto position{positions_[node]};
+  locals_[position] = local;
+  dirty_[position] = 1;
+  marked_ = true;
+  // Ancestors already marked have marked theirs too.
+  for (auto ancestor{parent_positions_[position]};
+       ancestor != no_parent && !dirty_below_[ancestor];
+       ancestor = parent_positions_[ancestor]) {
+    dirty_below_[ancestor] = 1;
+  }
+}
+
+void SceneGraph::build_order() {
+  // Parents are always at lower positions than their children, before and
+  // after reordering.
+  auto count{nodes_.size()};
+  std::vector<std::uint32_t> first_child(count + 1, 0);
+  for (auto parent : parent_positions_) {
+    if (parent != no_parent) {
+      ++first_child[parent + 1];
+    }
+  }
+  for (std::size_t i{0}; i < count; ++i) {
+    first_child[i + 1] += first_child[i];
+  }
+  std::vector<std::uint32_t> children(first_child[count]);
+  auto next{first_child};
+  for (std::uint32_t position{0}; position < count; ++position) {
+    if (parent_positions_[position] != no_parent) {
+      children[next[parent_positions_[position]]++] = position;
+    }
+  }
+
+  // Old positions in depth-first order, siblings in their current order.
+  std::vector<std::uint32_t> order;
+  order.reserve(count);
+  std::vector<std::uint32_t> stack;
+  for (auto root{count}; root-- > 0;) {
+    if (parent_positions_[root] == no_parent) {
+      stack.push_back(static_cast<std::uint32_t>(root));
+    }
+  }
+  while (!stack.empty()) {
+    auto position{stack.back()};
+    stack.pop_back();
+    order.push_back(position);
+    for (auto child{first_child[position + 1]};
+         child-- > first_child[position];) {
+      stack.push_back(children[child]);
+    }
+  }
+
+  std::vector<std::uint32_t> new_positions(count);
+  for (std::uint32_t position{0}; position < count; ++position) {
+    new_positions[order[position]] = position;
+  }
+  auto reorder{[&](auto &values) {
+    auto old_values{values};
+    for (std::size_t position{0}; position < count; ++position) {
+      values[position] = old_values[order[position]];
+    }
+  }};
+  reorder(nodes_);
+  reorder(parent_positions_);
+  reorder(locals_);
+  reorder(worlds_);
+  reorder(dirty_);
+  reorder(dirty_below_);
+  reorder(updated_in_);
+  for (std::size_t position{0}; position < count; ++position) {
+    auto &parent{parent_positions_[position]};
+    if (parent != no_parent) {
+      parent = new_positions[parent];
+    }
+    positions_[nodes_[position]] = static_cast<std::uint32_t>(position);
+  }
+
+  // One backwards pass sums up the subtree sizes.
+  subtree_end_.assign(count, 1);
+  for (auto position{count}; position-- > 0;) {
+    if (parent_positions_[position] != no_parent) {
+      subtree_end_[parent_positions_[position]] += subtree_end_[position];
+    }
+  }
+  for (std::uint32_t position{0}; position < count; ++position) {
+    subtree_end_[position] += position;
+  }
+
+  // Subtrees small enough for one thread become tasks, merged with their
+  // siblings' while they stay that small. The nodes above them are updated
+  // first, on the calling thread.
+  auto task_size{std::max(min_task_nodes, count / tasks_per_graph)};
+  spine_.clear();
+  task_begin_.clear();
+  task_end_.clear();
+  for (std::uint32_t position{0}; position < count;) {
+    auto end{subtree_end_[position]};
+    if (end - position > task_size) {
+      spine_.push_back(position++);
+      continue;
+    }
+    if (!task_end_.empty() && task_end_.back() == position &&
+        end - task_begin_.back() <= task_size) {
+      task_end_.back() = end;
+    } else {
+      task_begin_.push_back(position);
+      task_end_.push_back(end);
+    }
+    position = end;
+  }
+  order_stale_ = false;
+}
+
+std::size_t SceneGraph::update_range(std::size_t begin, std::size_t end) {
+  std::size_t updated{0};
+  for (auto position{begin}; position < end;) {
+    auto parent{parent_positions_[position]};
+    auto parent_moved{parent != no_parent && updated_in_[parent] == updates_};
+    if (dirty_[position] || parent_moved) {
+      worlds_[position] = parent != no_parent
+                              ? worlds_[parent] * locals_[position]
+                              : locals_[position];
+      updated_in_[position] = updates_;
+      dirty_[position] = 0;
+      ++updated;
+    } else if (!dirty_below_[position]) {
+      // Nothing in this subtree moved.
+      position = subtree_end_[position];
+      continue;
+    }
+    dirty_below_[position] = 0;
+    ++position;
+  }
+  return updated;
+}
+
+std::size_t SceneGraph::update(unsigned threads) {
+  if (!marked_) {
+    return 0;
+  }
+  marked_ = false;
+  if (order_stale_) {
+    build_order();
+  }
+  ++updates_;
+
+  std::size_t updated{0};
+  for (auto position : spine_) {
+    updated += update_range(position, position + 1);
+  }
+  // Each task only reads the spine and its own subtrees.
+  std::vector<std::size_t> task_updated(task_begin_.size(), 0);
+  parallel_for(task_begin_.size(), threads, 1,
+               [&](std::size_t begin, std::size_t end) {
+                 for (auto task{begin}; task < end; ++task) {
+                   task_updated[task] =
+                       update_range(task_begin_[task], task_end_[task]);
+                 }
+               });
+  for (auto count : task_updated) {
+    updated += count;
+  }
+  return updated;
+}
+
+} // namespace common
@@ -0,0 +1,375 @@
+#include <atomic>
+#include <chrono>
+#include <common/log.hpp>
+#include <common/shader.hpp>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace common {
+
+namespace {
+
+constexpr std::uint32_t binary_magic{0x4e494250}; // "PBIN"
+
+struct BinaryHeader {
+  std::uint32_t magic;
+  std::uint32_t format;
+  std::uint32_t length;
+};
+
+// A suffix that no other writer uses: a random id for the process and a
+// count of the temporary files it has made.
+std::string temporary_suffix() {
+  static const auto process{std::random_device{}()};
+  static std::atomic<std::uint32_t> count{0};
+  return ".tmp" + std::to_string(process) + "-" + std::to_string(++count);
+}
+
+void print_program_log(GLuint program) {
+  constexpr GLsizei infobuffer_size{512};
+  GLchar infobuffer[infobuffer_size];
+  glGetProgramInfoLog(program, infobuffer_size, nullptr, infobuffer);
+  log_error("{}", infobuffer);
+}
+
+// Prints the log of a shader that failed to compile. Returns false for a
+// shader that compiled.
+bool print_shader_log(GLuint shader) {
+  GLint success;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+  if (success) {
+    return false;
+  }
+  constexpr GLsizei infobuffer_size{512};
+  GLchar infobuffer[infobuffer_size];
+  glGetShaderInfoLog(shader, infobuffer_size, nullptr, infobuffer);
+  log_error("{}", infobuffer);
+  return true;
+}
+
+GLuint start_shader(GLenum type, const std::string &source) {
+  auto shader{glCreateShader(type)};
+  auto shader_code{source.c_str()};
+  glShaderSource(shader, 1, &shader_code, nullptr);
+  glCompileShader(shader);
+  return shader;
+}
+
+// Issues the compiles and the link without reading any result, so that a
+// driver that builds in the background is not made to wait. A shader that
+// fails to compile makes the link fail.
+GLuint start_program(GLuint vertex_shader, GLuint fragment_shader,
+                     bool retrievable) {
+  auto program{glCreateProgram()};
+  if (retrievable) {
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+  glAttachShader(program, vertex_shader);
+  glAttachShader(program, fragment_shader);
+  glLinkProgram(program);
+  return program;
+}
+
+// Reads the link status, which waits for the build, and frees the shaders.
+// Returns the program, or 0 after printing the logs.
+GLuint finish_program(GLuint program, GLuint vertex_shader,
+                      GLuint fragment_shader) {
+  glDetachShader(program, vertex_shader);
+  glDetachShader(program, fragment_shader);
+  GLint success;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success) {
+    auto compile_failed{print_shader_log(vertex_shader)};
+    compile_failed |= print_shader_log(fragment_shader);
+    if (!compile_failed) {
+      print_program_log(program);
+    }
+    glDeleteProgram(program);
+    program = 0;
+  }
+  glDeleteShader(vertex_shader);
+  glDeleteShader(fragment_shader);
+  return program;
+}
+
+GLuint link_program(const std::string &vertex_source,
+                    const std::string &fragment_source, bool retrievable) {
+  auto vertex_shader{start_shader(GL_VERTEX_SHADER, vertex_source)};
+  auto fragment_shader{start_shader(GL_FRAGMENT_SHADER, fragment_source)};
+  auto program{start_program(vertex_shader, fragment_shader, retrievable)};
+  return finish_program(program, vertex_shader, fragment_shader);
+}
+
+// FNV-1a, which is plenty to tell a handful of shader sources apart.
+void hash_append(std::uint64_t &hash, const std::string &data) {
+  for (auto c : data) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 0x100000001b3ull;
+  }
+  // Separator so that ("ab", "c") and ("a", "bc") hash differently.
+  hash ^= 0xff;
+  hash *= 0x100000001b3ull;
+}
+
+} // namespace
+
+GLuint compile_program(const std::string &vertex_source,
+                       const std::string &fragment_source) {
+  return link_program(vertex_source, fragment_source, false);
+}
+
+GLuint compile_compute_program(const std::string &compute_source) {
+  auto shader{start_shader(GL_COMPUTE_SHADER, compute_source)};
+  auto program{glCreateProgram()};
+  glAttachShader(program, shader);
+  glLinkProgram(program);
+  glDetachShader(program, shader);
+  GLint success;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success) {
+    if (!print_shader_log(shader)) {
+      print_program_log(program);
+    }
+    glDeleteProgram(program);
+    program = 0;
+  }
+  glDeleteShader(shader);
+  return program;
+}
+
+ShaderCache::ShaderCache(std::filesystem::path directory)
+    : directory_{std::move(directory)} {
+  auto gl_string{[](GLenum name) {
+    auto value{reinterpret_cast<const char *>(glGetString(name))};
+    return std::string{value ? value : ""};
+  }};
+  driver_ = gl_string(GL_VENDOR) + '\n' + gl_string(GL_RENDERER) + '\n' +
+            gl_string(GL_VERSION);
+
+  if (GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary) {
+    GLint format_count{0};
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+    binaries_supported_ = format_count > 0;
+  }
+
+  if (binaries_supported_) {
+    std::error_code error;
+    std::filesystem::create_directories(directory_, error);
+    if (error) {
+      log_error("Failed to create shader cache {}: {}", directory_.string(),
+                error.message());
+      binaries_supported_ = false;
+    }
+  }
+}
+
+GLuint ShaderCache::load(const std::string &vertex_source,
+                         const std::string &fragment_source) {
+  if (!binaries_supported_) {
+    return compile_program(vertex_source, fragment_source);
+  }
+
+  if (auto program{find(vertex_source, fragment_source)}) {
+    return program;
+  }
+
+  auto program{link_program(vertex_source, fragment_source, true)};
+  if (program) {
+    store(program, vertex_source, fragment_source);
+  }
+  return program;
+}
+
+GLuint ShaderCache::find(const std::string &vertex_source,
+                         const std::string &fragment_source) const {
+  if (!binaries_supported_) {
+    return 0;
+  }
+  return load_binary(entry_path(hash(vertex_source, fragment_source)));
+}
+
+void ShaderCache::store(GLuint program, const std::string &vertex_source,
+                        const std::string &fragment_source) const {
+  if (binaries_supported_) {
+    store_binary(program,
+                 entry_path(hash(vertex_source, fragment_source)));
+  }
+}
+
+std::uint64_t ShaderCache::hash(const std::string &vertex_source,
+                                const std::string &fragment_source) const {
+  std::uint64_t hash{0xcbf29ce484222325ull};
+  hash_append(hash, driver_);
+  hash_append(hash, vertex_source);
+  hash_append(hash, fragment_source);
+  return hash;
+}
+
+std::filesystem::path ShaderCache::entry_path(std::uint64_t key) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.bin",
+                static_cast<unsigned long long>(key));
+  return directory_ / name;
+}
+
+GLuint ShaderCache::load_binary(const std::filesystem::path &path) const {
+  std::ifstream file{path, std::ios::binary};
+  if (!file) {
+    return 0;
+  }
+
+  BinaryHeader header;
+  if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      header.magic != binary_magic) {
+    return 0;
+  }
+  // A truncated or corrupt entry must not make us allocate whatever length
+  // it claims.
+  std::error_code error;
+  auto file_size{std::filesystem::file_size(path, error)};
+  if (error || header.length == 0 ||
+      header.length > file_size - sizeof(header)) {
+    return 0;
+  }
+  std::vector<char> binary(header.length);
+  if (!file.read(binary.data(), binary.size())) {
+    return 0;
+  }
+
+  auto program{glCreateProgram()};
+  glProgramBinary(program, header.format, binary.data(), header.length);
+  GLint success;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success) {
+    // Stale or foreign binary; the caller recompiles and overwrites it.
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
+void ShaderCache::store_binary(GLuint program,
+                               const std::filesystem::path &path) const {
+  GLint length{0};
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+
+  std::vector<char> binary(length);
+  GLenum format;
+  glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+  // Write to a temporary file of this writer's own first, so that neither
+  // a concurrent reader nor a concurrent writer of the same entry ever sees
+  // it half-written. The last rename wins.
+  auto temporary_path{path};
+  temporary_path += temporary_suffix();
+  std::error_code error;
+  {
+    std::ofstream file{temporary_path, std::ios::binary | std::ios::trunc};
+    BinaryHeader header{binary_magic, format,
+                        static_cast<std::uint32_t>(length)};
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(binary.data(), binary.size());
+    if (!file) {
+      log_error("Failed to write {}", temporary_path.string());
+      file.close();
+      std::filesystem::remove(temporary_path, error);
+      return;
+    }
+  }
+  std::filesystem::rename(temporary_path, path, error);
+  if (error) {
+    log_error("Failed to store {}: {}", path.string(), error.message());
+    std::filesystem::remove(temporary_path, error);
+  }
+}
+
+ShaderBuildQueue::ShaderBuildQueue(ShaderCache *shader_cache)
+    : shader_cache_{shader_cache},
+      parallel_{GLAD_GL_KHR_parallel_shader_compile ||
+                GLAD_GL_ARB_parallel_shader_compile} {
+  // Lets the driver use as many threads as it sees fit.
+  if (GLAD_GL_KHR_parallel_shader_compile) {
+    glMaxShaderCompilerThreadsKHR(0xffffffff);
+  } else if (GLAD_GL_ARB_parallel_shader_compile) {
+    glMaxShaderCompilerThreadsARB(0xffffffff);
+  }
+}
+
+ShaderBuildQueue::~ShaderBuildQueue() {
+  for (auto index : pending_) {
+    auto &build{builds_[index]};
+    glDeleteProgram(build.linking);
+    glDeleteShader(build.vertex_shader);
+    glDeleteShader(build.fragment_shader);
+  }
+}
+
+std::size_t ShaderBuildQueue::submit(const std::string &vertex_source,
+                                     const std::string &fragment_source) {
+  auto &build{builds_.emplace_back()};
+  if (shader_cache_) {
+    build.program = shader_cache_->find(vertex_source, fragment_source);
+    if (build.program) {
+      build.done = true;
+      return builds_.size() - 1;
+    }
+  }
+
+  build.vertex_shader = start_shader(GL_VERTEX_SHADER, vertex_source);
+  build.fragment_shader = start_shader(GL_FRAGMENT_SHADER, fragment_source);
+  auto retrievable{shader_cache_ && shader_cache_->stores_binaries()};
+  build.linking =
+      start_program(build.vertex_shader, build.fragment_shader, retrievable);
+  if (retrievable) {
+    build.vertex_source = vertex_source;
+    build.fragment_source = fragment_source;
+  }
+  pending_.push_back(builds_.size() - 1);
+  return builds_.size() - 1;
+}
+
+void ShaderBuildQueue::finish_build(Build &build) {
+  build.program = finish_program(build.linking, build.vertex_shader,
+                                 build.fragment_shader);
+  if (build.program && !build.vertex_source.empty()) {
+    shader_cache_->store(build.program, build.vertex_source,
+                         build.fragment_source);
+  }
+  build = {build.program, true};
+}
+
+std::size_t ShaderBuildQueue::poll() {
+  auto start{std::chrono::steady_clock::now()};
+  std::erase_if(pending_, [&](std::size_t index) {
+    auto &build{builds_[index]};
+    if (parallel_) {
+      GLint complete{GL_FALSE};
+      glGetProgramiv(build.linking, GL_COMPLETION_STATUS_KHR, &complete);
+      if (!complete) {
+        return false;
+      }
+    } else if (std::chrono::duration<double, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+                   .count() > blocking_budget_ms) {
+      return false;
+    }
+    finish_build(build);
+    return true;
+  });
+  return pending_.size();
+}
+
+void ShaderBuildQueue::finish() {
+  for (auto index : pending_) {
+    finish_build(builds_[index]);
+  }
+  pending_.clear();
+}
+
+} // namespace common
@@ -0,0 +1,40 @@
+#include <common/simulation.hpp>
+#include <utility>
+
+namespace common {
+
+SimulationThread::SimulationThread(
+    clock::duration step, std::function<void(clock::time_point)> tick)
+    : step_{step}, tick_{std::move(tick)}, thread_{[this] { run(); }} {}
+
+SimulationThread::~SimulationThread() {
+  {
+    std::lock_guard lock{mutex_};
+    stopping_ = true;
+  }
+  stop_condition_.notify_one();
+  thread_.join();
+}
+
+void SimulationThread::run() {
+  auto next_tick{clock::now()};
+  std::unique_lock lock{mutex_};
+  while (!stopping_) {
+    lock.unlock();
+    auto now{clock::now()};
+    for (int i{0}; i < max_catch_up && next_tick <= now; ++i) {
+      tick_(next_tick);
+      ticks_.fetch_add(1, std::memory_order_relaxed);
+      next_tick += step_;
+    }
+    if (next_tick <= now) {
+      auto behind{(now - next_tick) / step_ + 1};
+      dropped_ticks_.fetch_add(behind, std::memory_order_relaxed);
+      next_tick += behind * step_;
+    }
+    lock.lock();
+    stop_condition_.wait_until(lock, next_tick, [this] { return stopping_; });
+  }
+}
+
+} // namespace common
@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <array>
+#include <common/log.hpp>
+#include <common/sprite_batcher.hpp>
+#include <common/state_cache.hpp>
+#include <cstddef>
+#include <string>
+#include <utility>
+
+namespace common {
+
+namespace {
+
+// Room for this many sprites per frame before the buffer has to grow.
+constexpr std::size_t initial_sprite_capacity{16384};
+
+struct SpriteVertex {
+  glm::vec2 position;
+  glm::vec2 tex_coord;
+  std::uint32_t color;
+  std::uint32_t layer;
+};
+
+const std::string vertex_shader_source =
+    "#version 330 core\n"
+    "layout (location = 0) in vec2 a_position;\n"
+    "layout (location = 1) in vec2 a_tex_coord;\n"
+    "layout (location = 2) in vec4 a_color;\n"
+    "layout (location = 3) in uint a_layer;\n"
+    "\n"
+    "uniform mat4 u_projection;\n"
+    "\n"
+    "out vec2 v_tex_coord;\n"
+    "out vec4 v_color;\n"
+    "flat out uint v_layer;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "  v_tex_coord = a_tex_coord;\n"
+    "  v_color = a_color;\n"
+    "  v_layer = a_layer;\n"
+    "  gl_Position = u_projection * vec4(a_position, 0.0, 1.0);\n"
+    "}";
+
+const std::string fragment_shader_source =
+    "#version 330 core\n"
+    "uniform sampler2D u_texture0;\n"
+    "\n"
+    "in vec2 v_tex_coord;\n"
+    "in vec4 v_color;\n"
+    "\n"
+    "out vec4 FragColor;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "  FragColor = v_color * texture(u_texture0, v_tex_coord);\n"
+    "}";
+
+const std::string array_fragment_shader_source =
+    "#version 330 core\n"
+    "uniform sampler2DArray u_texture0;\n"
+    "\n"
+    "in vec2 v_tex_coord;\n"
+    "in vec4 v_color;\n"
+    "flat in uint v_layer;\n"
+    "\n"
+    "out vec4 FragColor;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "  vec3 coord = vec3(v_tex_coord, v_layer);\n"
+    "  FragColor = v_color * texture(u_texture0, coord);\n"
+    "}";
+
+std::size_t program_index(GLenum target) {
+  return target == GL_TEXTURE_2D_ARRAY ? 1 : 0;
+}
+
+} // namespace
+
+SpriteBatcher::SpriteBatcher(ShaderCache &shader_cache)
+    : vertex_buffer_{GL_ARRAY_BUFFER,
+                     initial_sprite_capacity * 4 * sizeof(SpriteVertex)} {
+  programs_[0] =
+      shader_cache.load(vertex_shader_source, fragment_shader_source);
+  programs_[1] =
+      shader_cache.load(vertex_shader_source, array_fragment_shader_source);
+  for (std::size_t i{0}; i < 2; ++i) {
+    if (programs_[i]) {
+      projection_uniforms_[i] =
+          ProgramReflection{programs_[i]}.uniform<glm::mat4>("u_projection");
+    }
+  }
+
+  glGenVertexArrays(1, &vertex_array_);
+  glGenBuffers(1, &index_buffer_);
+  auto &state{gl_state()};
+  state.bind_vertex_array(vertex_array_);
+  state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+  for (GLuint location{0}; location < 4; ++location) {
+    glEnableVertexAttribArray(location);
+  }
+  reserve_indices(initial_sprite_capacity);
+}
+
+SpriteBatcher::~SpriteBatcher() {
+  auto &state{gl_state()};
+  for (auto program : programs_) {
+    glDeleteProgram(program);
+    state.forget_program(program);
+  }
+  glDeleteVertexArrays(1, &vertex_array_);
+  state.forget_vertex_array(vertex_array_);
+  glDeleteBuffers(1, &index_buffer_);
+  state.forget_buffer(index_buffer_);
+}
+
+std::uint32_t SpriteBatcher::add_texture(GLuint texture, GLenum target) {
+  for (std::uint32_t i{0}; i < textures_.size(); ++i) {
+    if (textures_[i].texture == texture && textures_[i].target == target) {
+      return i;
+    }
+  }
+  // Handles take the upper 16 bits of the sort key.
+  if (textures_.size() > 0xffff) {
+    log_error("Too many sprite textures");
+    return invalid_texture;
+  }
+  textures_.push_back({texture, target});
+  return static_cast<std::uint32_t>(textures_.size() - 1);
+}
+
+// Grows the shared quad indices to cover `sprite_count` sprites. Draws pick
+// their sprites with a base vertex, so the indices always start at 0.
+void SpriteBatcher::reserve_indices(std::size_t sprite_count) {
+  if (sprite_count <= index_capacity_) {
+    return;
+  }
+  index_capacity_ = std::max(sprite_count, index_capacity_ * 2);
+  std::vector<std::uint32_t> indices;
+  indices.reserve(index_capacity_ * 6);
+  for (std::uint32_t i{0}; i < index_capacity_; ++i) {
+    for (auto corner : {0u, 1u, 2u, 0u, 2u, 3u}) {
+      indices.push_back(4 * i + corner);
+    }
+  }
+  auto &state{gl_state()};
+  state.bind_vertex_array(vertex_array_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+               static_cast<GLsizeiptr>(indices.size() * sizeof(std::uint32_t)),
+               indices.data(), GL_STATIC_DRAW);
+}
+
+// LSD radix sort on bytes, as in DrawQueue. Most bytes are the same for
+// every key (few textures, few layers), and their passes are skipped.
+void SpriteBatcher::sort() {
+  constexpr std::size_t digits{sizeof(std::uint32_t)};
+  std::array<std::array<std::uint32_t, 256>, digits> counts{};
+  for (auto &entry : entries_) {
+    for (std::size_t d{0}; d < digits; ++d) {
+      ++counts[d][(entry.key >> (8 * d)) & 0xff];
+    }
+  }
+
+  scratch_.resize(entries_.size());
+  for (std::size_t d{0}; d < digits; ++d) {
+    auto &count{counts[d]};
+    if (count[(entries_.front().key >> (8 * d)) & 0xff] == entries_.size()) {
+      continue;
+    }
+    std::uint32_t offset{0};
+    for (auto &bucket : count) {
+      offset += std::exchange(bucket, offset);
+    }
+    for (auto &entry : entries_) {
+      scratch_[count[(entry.key >> (8 * d)) & 0xff]++] = entry;
+    }
+    entries_.swap(scratch_);
+  }
+}
+
+void SpriteBatcher::prepare() {
+  if (prepared_ || sprites_.empty()) {
+    return;
+  }
+
+  // The texture in the high half of the key, the layer in the low one.
+  entries_.clear();
+  for (std::uint32_t i{0}; i < sprites_.size(); ++i) {
+    entries_.push_back(
+        {textures_of_sprites_[i] << 16 | (sprites_[i].layer & 0xffffu), i});
+  }
+  sort();
+
+  auto size{sprites_.size() * 4 * sizeof(SpriteVertex)};
+  vertex_buffer_.reserve(size);
+  vertex_buffer_.begin_frame();
+  allocation_ = vertex_buffer_.allocate(size);
+  if (!allocation_.data) {
+    vertex_buffer_.end_frame();
+    clear();
+    return;
+  }
+  runs_.clear();
+  auto vertex{static_cast<SpriteVertex *>(allocation_.data)};
+  for (std::size_t i{0}; i < entries_.size(); ++i) {
+    auto texture{entries_[i].key >> 16};
+    if (runs_.empty() || runs_.back().texture != texture) {
+      runs_.push_back({texture, i, 0});
+    }
+    ++runs_.back().count;
+
+    auto &sprite{sprites_[entries_[i].sprite]};
+    vertex[0] = {sprite.min, sprite.uv_min, sprite.color, sprite.layer};
+    vertex[1] = {{sprite.max.x, sprite.min.y},
+                 {sprite.uv_max.x, sprite.uv_min.y},
+                 sprite.color,
+                 sprite.layer};
+    vertex[2] = {sprite.max, sprite.uv_max, sprite.color, sprite.layer};
+    vertex[3] = {{sprite.min.x, sprite.max.y},
+                 {sprite.uv_min.x, sprite.uv_max.y},
+                 sprite.color,
+                 sprite.layer};
+    vertex += 4;
+  }
+  vertex_buffer_.commit(allocation_);
+  prepared_ = true;
+}
+
+int SpriteBatcher::flush(const glm::mat4 &projection) {
+  prepare();
+  if (!prepared_) {
+    return 0;
+  }
+
+  auto &state{gl_state()};
+  state.bind_vertex_array(vertex_array_);
+  state.bind_buffer(GL_ARRAY_BUFFER, allocation_.buffer);
+  auto attribute{[&](std::size_t member_offset) {
+    return reinterpret_cast<const void *>(allocation_.offset + member_offset);
+  }};
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex),
+                        attribute(offsetof(SpriteVertex, position)));
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex),
+                        attribute(offsetof(SpriteVertex, tex_coord)));
+  glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SpriteVertex),
+                        attribute(offsetof(SpriteVertex, color)));
+  glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(SpriteVertex),
+                         attribute(offsetof(SpriteVertex, layer)));
+
+  state.set_enabled(GL_DEPTH_TEST, false);
+  state.set_enabled(GL_BLEND, true);
+  state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  auto draw_calls{0};
+  for (auto &run : runs_) {
+    auto &texture{textures_[run.texture]};
+    auto index{program_index(texture.target)};
+    if (!programs_[index]) {
+      continue;
+    }
+    reserve_indices(run.count);
+    state.use_program(programs_[index]);
+    projection_uniforms_[index].set(projection);
+    state.bind_texture(0, texture.target, texture.texture);
+    glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(run.count * 6),
+                             GL_UNSIGNED_INT, nullptr,
+                             static_cast<GLint>(run.first * 4));
+    ++draw_calls;
+  }
+  vertex_buffer_.end_frame();
+  clear();
+  return draw_calls;
+}
+
+// Keeps the capacity for the next frame.
+void SpriteBatcher::clear() {
+  sprites_.clear();
+  textures_of_sprites_.clear();
+  prepared_ = false;
+}
+
+} // namespace common
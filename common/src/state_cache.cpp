@@ -0,0 +1,195 @@
+#include <common/state_cache.hpp>
+
+namespace common {
+
+namespace {
+
+constexpr GLenum buffer_targets[]{
+    GL_ARRAY_BUFFER,      GL_UNIFORM_BUFFER,     GL_TEXTURE_BUFFER,
+    GL_PIXEL_UNPACK_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+};
+
+constexpr GLenum texture_targets[]{
+    GL_TEXTURE_2D,
+    GL_TEXTURE_2D_ARRAY,
+    GL_TEXTURE_BUFFER,
+};
+
+constexpr GLenum capabilities[]{
+    GL_BLEND,
+    GL_DEPTH_TEST,
+    GL_CULL_FACE,
+    GL_SCISSOR_TEST,
+};
+
+// The position of `value` in `values`, or the size of `values` if it is not
+// there.
+template <std::size_t N>
+std::size_t find(const GLenum (&values)[N], GLenum value) {
+  std::size_t i{0};
+  while (i < N && values[i] != value) {
+    ++i;
+  }
+  return i;
+}
+
+} // namespace
+
+void StateCache::use_program(GLuint program) {
+  if (change(program_, program)) {
+    glUseProgram(program);
+  }
+}
+
+void StateCache::bind_vertex_array(GLuint vertex_array) {
+  if (change(vertex_array_, vertex_array)) {
+    glBindVertexArray(vertex_array);
+  }
+}
+
+void StateCache::bind_buffer(GLenum target, GLuint buffer) {
+  auto i{find(buffer_targets, target)};
+  if (i == buffer_target_count) {
+    ++counters_.issued;
+    glBindBuffer(target, buffer);
+  } else if (change(buffers_[i], buffer)) {
+    glBindBuffer(target, buffer);
+  }
+}
+
+void StateCache::bind_buffer_range(GLenum target, GLuint index, GLuint buffer,
+                                   GLintptr offset, GLsizeiptr size) {
+  // glBindBufferRange binds the generic target too.
+  auto i{find(buffer_targets, target)};
+  if (i < buffer_target_count) {
+    buffers_[i] = buffer;
+  }
+  if (target != GL_UNIFORM_BUFFER || index >= uniform_binding_count) {
+    ++counters_.issued;
+    glBindBufferRange(target, index, buffer, offset, size);
+    return;
+  }
+  auto &binding{uniform_bindings_[index]};
+  if (binding.buffer == buffer && binding.offset == offset &&
+      binding.size == size) {
+    ++counters_.elided;
+    return;
+  }
+  binding = {buffer, offset, size};
+  ++counters_.issued;
+  glBindBufferRange(target, index, buffer, offset, size);
+}
+
+void StateCache::active_texture(GLuint unit) {
+  if (change(active_unit_, unit)) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+  }
+}
+
+void StateCache::bind_texture(GLuint unit, GLenum target, GLuint texture) {
+  active_texture(unit);
+  auto i{find(texture_targets, target)};
+  if (unit >= texture_unit_count || i == texture_target_count) {
+    ++counters_.issued;
+    glBindTexture(target, texture);
+  } else if (change(textures_[unit][i], texture)) {
+    glBindTexture(target, texture);
+  }
+}
+
+void StateCache::set_enabled(GLenum capability, bool enabled) {
+  auto i{find(capabilities, capability)};
+  if (i < capability_count && !change(capabilities_[i], int{enabled})) {
+    return;
+  }
+  if (i == capability_count) {
+    ++counters_.issued;
+  }
+  if (enabled) {
+    glEnable(capability);
+  } else {
+    glDisable(capability);
+  }
+}
+
+void StateCache::blend_func(GLenum source, GLenum destination) {
+  if (change(blend_func_, {source, destination})) {
+    glBlendFunc(source, destination);
+  }
+}
+
+void StateCache::depth_func(GLenum function) {
+  if (change(depth_func_, function)) {
+    glDepthFunc(function);
+  }
+}
+
+void StateCache::depth_mask(bool write) {
+  if (change(depth_mask_, int{write})) {
+    glDepthMask(write ? GL_TRUE : GL_FALSE);
+  }
+}
+
+void StateCache::viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+  if (change(viewport_, {x, y, width, height})) {
+    glViewport(x, y, width, height);
+  }
+}
+
+void StateCache::forget_program(GLuint program) {
+  if (program_ == program) {
+    program_ = unknown;
+  }
+}
+
+void StateCache::forget_vertex_array(GLuint vertex_array) {
+  if (vertex_array_ == vertex_array) {
+    vertex_array_ = unknown;
+  }
+}
+
+void StateCache::forget_buffer(GLuint buffer) {
+  for (auto &bound : buffers_) {
+    if (bound == buffer) {
+      bound = unknown;
+    }
+  }
+  for (auto &binding : uniform_bindings_) {
+    if (binding.buffer == buffer) {
+      binding.buffer = unknown;
+    }
+  }
+}
+
+void StateCache::forget_texture(GLuint texture) {
+  for (auto &unit : textures_) {
+    for (auto &bound : unit) {
+      if (bound == texture) {
+        bound = unknown;
+      }
+    }
+  }
+}
+
+void StateCache::invalidate() {
+  program_ = unknown;
+  vertex_array_ = unknown;
+  buffers_.fill(unknown);
+  uniform_bindings_.fill({unknown, 0, 0});
+  active_unit_ = unknown;
+  for (auto &unit : textures_) {
+    unit.fill(unknown);
+  }
+  capabilities_.fill(-1);
+  blend_func_.fill(unknown);
+  depth_func_ = unknown;
+  depth_mask_ = -1;
+  viewport_.fill(-1);
+}
+
+StateCache &gl_state() {
+  static thread_local StateCache state;
+  return state;
+}
+
+} // namespace common
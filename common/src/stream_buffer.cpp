@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <common/log.hpp>
+#include <common/state_cache.hpp>
+#include <common/stream_buffer.hpp>
+
+namespace common {
+
+namespace {
+
+// How long begin_frame() waits per attempt before flushing again.
+constexpr GLuint64 fence_timeout_ns{1'000'000};
+
+} // namespace
+
+StreamBuffer::StreamBuffer(GLenum target, std::size_t frame_capacity)
+    : target_{target}, frame_capacity_{frame_capacity},
+      persistent_{GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage} {
+  create();
+}
+
+StreamBuffer::~StreamBuffer() { destroy(); }
+
+void StreamBuffer::begin_frame() {
+  used_ = 0;
+  if (!persistent_) {
+    gl_state().bind_buffer(target_, buffer_);
+    // Hand last frame's storage to the driver and start on fresh memory.
+    glBufferData(target_, frame_capacity_, nullptr, GL_STREAM_DRAW);
+    return;
+  }
+
+  region_ = (region_ + 1) % frame_count;
+  auto &fence{fences_[region_]};
+  if (!fence) {
+    return;
+  }
+  if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+    ++stalls_;
+    while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                            fence_timeout_ns) == GL_TIMEOUT_EXPIRED) {
+    }
+  }
+  glDeleteSync(fence);
+  fence = nullptr;
+}
+
+void StreamBuffer::end_frame() {
+  if (persistent_) {
+    fences_[region_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+}
+
+void StreamBuffer::reserve(std::size_t frame_capacity) {
+  if (frame_capacity <= frame_capacity_) {
+    return;
+  }
+  // Grow geometrically so that a slowly rising demand does not recreate the
+  // buffer every frame.
+  frame_capacity_ = std::max(frame_capacity, frame_capacity_ * 2);
+  destroy();
+  create();
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(std::size_t size,
+                                                std::size_t alignment) {
+  auto offset{(used_ + alignment - 1) / alignment * alignment};
+  if (offset + size > frame_capacity_) {
+    return {nullptr, buffer_, 0, 0};
+  }
+  used_ = offset + size;
+
+  auto buffer_offset{static_cast<GLintptr>(
+      (persistent_ ? region_ * frame_capacity_ : 0) + offset)};
+  if (persistent_) {
+    return {mapping_ + buffer_offset, buffer_, buffer_offset,
+            static_cast<GLsizeiptr>(size)};
+  }
+  // The storage was orphaned in begin_frame() and allocations never
+  // overlap, so nothing the GPU reads can be overwritten.
+  gl_state().bind_buffer(target_, buffer_);
+  auto data{glMapBufferRange(target_, buffer_offset, size,
+                             GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+                                 GL_MAP_UNSYNCHRONIZED_BIT)};
+  if (!data) {
+    log_error("Failed to map stream buffer range");
+  }
+  return {data, buffer_, buffer_offset, static_cast<GLsizeiptr>(size)};
+}
+
+void StreamBuffer::commit(const Allocation &allocation) {
+  if (!persistent_ && allocation.data) {
+    gl_state().bind_buffer(target_, buffer_);
+    glUnmapBuffer(target_);
+  }
+}
+
+void StreamBuffer::create() {
+  glGenBuffers(1, &buffer_);
+  gl_state().bind_buffer(target_, buffer_);
+  if (!persistent_) {
+    glBufferData(target_, frame_capacity_, nullptr, GL_STREAM_DRAW);
+    return;
+  }
+  auto size{static_cast<GLsizeiptr>(frame_capacity_ * frame_count)};
+  auto flags{GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT};
+  glBufferStorage(target_, size, nullptr, flags);
+  mapping_ =
+      static_cast<unsigned char *>(glMapBufferRange(target_, 0, size, flags));
+  if (!mapping_) {
+    log_warning("Failed to map stream buffer persistently, falling back to "
+                "orphaning");
+    glDeleteBuffers(1, &buffer_);
+    gl_state().forget_buffer(buffer_);
+    persistent_ = false;
+    create();
+  }
+}
+
+void StreamBuffer::destroy() {
+  for (auto &fence : fences_) {
+    if (fence) {
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
+  }
+  if (mapping_) {
+    gl_state().bind_buffer(target_, buffer_);
+    glUnmapBuffer(target_);
+    mapping_ = nullptr;
+  }
+  // The driver keeps the storage alive until the GPU is done with it.
+  glDeleteBuffers(1, &buffer_);
+  gl_state().forget_buffer(buffer_);
+  buffer_ = 0;
+}
+
+} // namespace common
@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <bit>
+#include <common/log.hpp>
+#include <common/mipmap.hpp>
+#include <common/state_cache.hpp>
+#include <common/texture_array.hpp>
+#include <vector>
+
+namespace common {
+
+namespace {
+
+// Gray and gray-alpha pixels as RGBA, which is how stb_image converts them.
+// Uploaded as GL_RED or GL_RG they would sample as red.
+std::vector<unsigned char> expand_to_rgba(const unsigned char *pixels,
+                                          int width, int height,
+                                          int channels) {
+  auto count{static_cast<std::size_t>(width) * height};
+  std::vector<unsigned char> rgba(count * 4);
+  for (std::size_t i{0}; i < count; ++i) {
+    auto gray{pixels[i * channels]};
+    rgba[i * 4 + 0] = gray;
+    rgba[i * 4 + 1] = gray;
+    rgba[i * 4 + 2] = gray;
+    rgba[i * 4 + 3] = channels == 2 ? pixels[i * channels + 1] : 255;
+  }
+  return rgba;
+}
+
+} // namespace
+
+TextureArray::TextureArray(int width, int height, int capacity)
+    : width_{width}, height_{height},
+      levels_{static_cast<int>(std::bit_width(
+          static_cast<unsigned>(std::max({width, height, 1}))))} {
+  GLint max_layers{0};
+  glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+  capacity_ = std::clamp(capacity, 1, std::max(max_layers, 1));
+
+  glGenTextures(1, &texture_);
+  auto &state{gl_state()};
+  state.bind_texture(0, GL_TEXTURE_2D_ARRAY, texture_);
+  if (GLAD_GL_VERSION_4_2 || GLAD_GL_ARB_texture_storage) {
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels_, GL_RGBA8, width_, height_,
+                   capacity_);
+  } else {
+    for (int level{0}; level < levels_; ++level) {
+      glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8,
+                   std::max(width_ >> level, 1), std::max(height_ >> level, 1),
+                   capacity_, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+  }
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels_ - 1);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+TextureArray::~TextureArray() {
+  glDeleteTextures(1, &texture_);
+  gl_state().forget_texture(texture_);
+}
+
+int TextureArray::load(TextureLoader &loader, const std::string &path) {
+  if (size_ == capacity_) {
+    log_error("Texture array is full, skipping {}", path);
+    return -1;
+  }
+  loader.load_layer(texture_, size_, width_, height_, path);
+  return size_++;
+}
+
+int TextureArray::add(const unsigned char *pixels, int width, int height,
+                      int channels) {
+  if (size_ == capacity_) {
+    log_error("Texture array is full");
+    return -1;
+  }
+  if (width != width_ || height != height_) {
+    log_error("Image is {}x{}, but the texture array holds {}x{} layers",
+              width, height, width_, height_);
+    return -1;
+  }
+  if (channels < 1 || channels > 4) {
+    log_error("Images have 1 to 4 channels, not {}", channels);
+    return -1;
+  }
+
+  std::vector<unsigned char> rgba;
+  if (channels < 3) {
+    rgba = expand_to_rgba(pixels, width, height, channels);
+    pixels = rgba.data();
+    channels = 4;
+  }
+  auto mipmaps{build_mipmaps(pixels, width, height, channels, {})};
+  auto &state{gl_state()};
+  state.bind_texture(0, GL_TEXTURE_2D_ARRAY, texture_);
+  state.bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  auto format{channels == 3 ? GL_RGB : GL_RGBA};
+  glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, size_, width, height, 1,
+                  format, GL_UNSIGNED_BYTE, pixels);
+  for (std::size_t i{0}; i < mipmaps.size(); ++i) {
+    auto &level{mipmaps[i]};
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(i + 1), 0, 0,
+                    size_, level.width, level.height, 1, format,
+                    GL_UNSIGNED_BYTE, level.pixels.data());
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  return size_++;
+}
+
+} // namespace common
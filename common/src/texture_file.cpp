@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <common/log.hpp>
+#include <common/mapped_file.hpp>
+#include <common/state_cache.hpp>
+#include <common/texture_file.hpp>
+#include <fstream>
+
+namespace common {
+
+namespace {
+
+constexpr std::uint32_t max_level_count{16};
+
+std::uint64_t align_up(std::uint64_t value) {
+  return (value + texture_file_alignment - 1) & ~(texture_file_alignment - 1);
+}
+
+// The formats TextureConverter writes, with the pixel format and type the
+// uncompressed ones are uploaded with.
+bool is_known_format(const TextureFileHeader &header) {
+  auto uncompressed{[&](GLenum format) {
+    return header.format == format && header.type == GL_UNSIGNED_BYTE;
+  }};
+  switch (header.internal_format) {
+  case GL_R8:
+    return uncompressed(GL_RED);
+  case GL_RG8:
+    return uncompressed(GL_RG);
+  case GL_RGB8:
+    return uncompressed(GL_RGB);
+  case GL_RGBA8:
+    return uncompressed(GL_RGBA);
+  case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+  case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+  case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+  case GL_COMPRESSED_RGB8_ETC2:
+  case GL_COMPRESSED_RGBA8_ETC2_EAC:
+    return header.format == 0 && header.type == 0;
+  default:
+    return false;
+  }
+}
+
+// The bytes GL reads for a `width` x `height` level of a known format: rows
+// padded to 4 bytes when uncompressed, whole 4x4 blocks when compressed.
+std::uint64_t level_data_size(GLenum internal_format, std::uint64_t width,
+                              std::uint64_t height) {
+  auto blocks{((width + 3) / 4) * ((height + 3) / 4)};
+  auto rows{[&](std::uint64_t channels) {
+    return (width * channels + 3) / 4 * 4 * height;
+  }};
+  switch (internal_format) {
+  case GL_R8:
+    return rows(1);
+  case GL_RG8:
+    return rows(2);
+  case GL_RGB8:
+    return rows(3);
+  case GL_RGBA8:
+    return rows(4);
+  case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+  case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+  case GL_COMPRESSED_RGB8_ETC2:
+    return blocks * 8;
+  default:
+    return blocks * 16;
+  }
+}
+
+bool supports_format(GLenum internal_format) {
+  switch (internal_format) {
+  case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+  case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+  case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+    return GLAD_GL_EXT_texture_compression_s3tc;
+  case GL_COMPRESSED_RGB8_ETC2:
+  case GL_COMPRESSED_RGBA8_ETC2_EAC:
+    return GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_ES3_compatibility;
+  case GL_R8:
+  case GL_RG8:
+  case GL_RGB8:
+  case GL_RGBA8:
+    return true;
+  default:
+    return false;
+  }
+}
+
+} // namespace
+
+bool is_compressed_format(GLenum internal_format) {
+  switch (internal_format) {
+  case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+  case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+  case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+  case GL_COMPRESSED_RGB8_ETC2:
+  case GL_COMPRESSED_RGBA8_ETC2_EAC:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool write_texture_file(const std::string &path, const TextureData &texture) {
+  TextureFileHeader header{
+      texture_file_magic,
+      texture_file_version,
+      texture.internal_format,
+      texture.format,
+      texture.type,
+      texture.levels.front().width,
+      texture.levels.front().height,
+      static_cast<std::uint32_t>(texture.levels.size()),
+  };
+
+  std::vector<TextureFileLevel> levels;
+  auto offset{align_up(sizeof(header) +
+                       texture.levels.size() * sizeof(TextureFileLevel))};
+  for (auto &level : texture.levels) {
+    levels.push_back({offset, level.data.size(), level.width, level.height});
+    offset = align_up(offset + level.data.size());
+  }
+
+  std::ofstream file{path, std::ios::binary | std::ios::trunc};
+  if (!file) {
+    log_error("Failed to open {}", path);
+    return false;
+  }
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(levels.data()),
+             levels.size() * sizeof(TextureFileLevel));
+  for (std::size_t i{0}; i < levels.size(); ++i) {
+    file.seekp(levels[i].offset);
+    file.write(reinterpret_cast<const char *>(texture.levels[i].data.data()),
+               texture.levels[i].data.size());
+  }
+  if (!file) {
+    log_error("Failed to write {}", path);
+    return false;
+  }
+  return true;
+}
+
+bool upload_texture_file(GLuint texture, const std::string &path) {
+  MappedFile file;
+  if (!file.open(path)) {
+    return false;
+  }
+
+  TextureFileHeader header;
+  if (file.size() < sizeof(header)) {
+    log_error("Truncated texture file {}", path);
+    return false;
+  }
+  header = *reinterpret_cast<const TextureFileHeader *>(file.data());
+  if (header.magic != texture_file_magic ||
+      header.version != texture_file_version || header.level_count == 0 ||
+      header.level_count > max_level_count || header.width == 0 ||
+      header.height == 0 ||
+      (std::max(header.width, header.height) >> (header.level_count - 1)) ==
+          0 ||
+      !is_known_format(header)) {
+    log_error("Unsupported texture file {}", path);
+    return false;
+  }
+  if (!supports_format(header.internal_format)) {
+    log_error("Texture format of {} is not supported by this driver", path);
+    return false;
+  }
+
+  auto table_end{sizeof(header) +
+                 header.level_count * sizeof(TextureFileLevel)};
+  if (file.size() < table_end) {
+    log_error("Truncated texture file {}", path);
+    return false;
+  }
+  auto levels{
+      reinterpret_cast<const TextureFileLevel *>(file.data() + sizeof(header))};
+  for (std::uint32_t i{0}; i < header.level_count; ++i) {
+    // Levels must form the header's mip chain and hold every byte GL reads
+    // for them, or the upload reads past the end of the mapping.
+    if (levels[i].width != std::max(header.width >> i, 1u) ||
+        levels[i].height != std::max(header.height >> i, 1u)) {
+      log_error("Level {} of {} does not match the mip chain", i, path);
+      return false;
+    }
+    if (levels[i].offset > file.size() ||
+        levels[i].size > file.size() - levels[i].offset ||
+        levels[i].size < level_data_size(header.internal_format,
+                                          levels[i].width, levels[i].height)) {
+      log_error("Truncated texture file {}", path);
+      return false;
+    }
+  }
+
+  auto compressed{is_compressed_format(header.internal_format)};
+  auto &state{gl_state()};
+  // The level pointers are client memory, not offsets into a buffer.
+  state.bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  state.bind_texture(0, GL_TEXTURE_2D, texture);
+  if (GLAD_GL_VERSION_4_2 || GLAD_GL_ARB_texture_storage) {
+    glTexStorage2D(GL_TEXTURE_2D, header.level_count, header.internal_format,
+                   header.width, header.height);
+    for (std::uint32_t i{0}; i < header.level_count; ++i) {
+      auto data{file.data() + levels[i].offset};
+      if (compressed) {
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, levels[i].width,
+                                  levels[i].height, header.internal_format,
+                                  levels[i].size, data);
+      } else {
+        glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, levels[i].width,
+                        levels[i].height, header.format, header.type, data);
+      }
+    }
+  } else {
+    for (std::uint32_t i{0}; i < header.level_count; ++i) {
+      auto data{file.data() + levels[i].offset};
+      if (compressed) {
+        glCompressedTexImage2D(GL_TEXTURE_2D, i, header.internal_format,
+                               levels[i].width, levels[i].height, 0,
+                               levels[i].size, data);
+      } else {
+        glTexImage2D(GL_TEXTURE_2D, i, header.internal_format, levels[i].width,
+                     levels[i].height, 0, header.format, header.type, data);
+      }
+    }
+  }
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header.level_count - 1);
+  return true;
+}
+
+} // namespace common
@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <common/log.hpp>
+#include <common/state_cache.hpp>
+#include <common/texture_file.hpp>
+#include <common/texture_loader.hpp>
+#include <cstring>
+#include <stb_image.h>
+
+namespace common {
+
+namespace {
+
+struct PixelFormat {
+  GLenum internal_format;
+  GLenum format;
+};
+
+PixelFormat pixel_format(int channels) {
+  switch (channels) {
+  case 1:
+    return {GL_R8, GL_RED};
+  case 2:
+    return {GL_RG8, GL_RG};
+  case 3:
+    return {GL_RGB8, GL_RGB};
+  default:
+    return {GL_RGBA8, GL_RGBA};
+  }
+}
+
+} // namespace
+
+unsigned TextureLoader::default_worker_count() {
+  // Leave one core to the render thread.
+  auto cores{std::thread::hardware_concurrency()};
+  return cores > 1 ? cores - 1 : 1;
+}
+
+TextureLoader::TextureLoader(unsigned worker_count) {
+  stbi_set_flip_vertically_on_load(true);
+
+  glGenBuffers(1, &pixel_buffer_);
+
+  for (unsigned i{0}; i < std::max(1u, worker_count); ++i) {
+    workers_.emplace_back([this] { work(); });
+  }
+}
+
+TextureLoader::~TextureLoader() {
+  {
+    std::lock_guard lock{mutex_};
+    stopping_ = true;
+  }
+  job_available_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+
+  for (auto &image : decoded_) {
+    stbi_image_free(image.pixels);
+  }
+  glDeleteBuffers(1, &pixel_buffer_);
+  gl_state().forget_buffer(pixel_buffer_);
+}
+
+GLuint TextureLoader::load(const std::string &path) {
+  GLuint texture;
+  glGenTextures(1, &texture);
+
+  // Precompiled textures are GPU-ready and mapped, so there is nothing to
+  // decode and uploading them right away is cheaper than a round trip
+  // through the workers.
+  if (path.ends_with(".gtex") && upload_texture_file(texture, path)) {
+    return texture;
+  }
+
+  gl_state().bind_texture(0, GL_TEXTURE_2D, texture);
+  const unsigned char placeholder[]{255, 0, 255, 255};
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+               placeholder);
+  if (path.ends_with(".gtex")) {
+    return texture;
+  }
+
+  {
+    std::lock_guard lock{mutex_};
+    jobs_.push_back({texture, path});
+  }
+  job_available_.notify_one();
+  ++pending_;
+  return texture;
+}
+
+void TextureLoader::load_layer(GLuint array, GLint layer, int width,
+                               int height, const std::string &path) {
+  {
+    std::lock_guard lock{mutex_};
+    jobs_.push_back({array, path, layer, width, height});
+  }
+  job_available_.notify_one();
+  ++pending_;
+}
+
+void TextureLoader::update() {
+  std::size_t uploaded_bytes{0};
+  while (uploaded_bytes < upload_budget_bytes) {
+    Image image;
+    {
+      std::lock_guard lock{mutex_};
+      if (decoded_.empty()) {
+        return;
+      }
+      image = std::move(decoded_.front());
+      decoded_.pop_front();
+    }
+
+    --pending_;
+    if (!image.pixels) {
+      log_error("Failed to load image {}: {}", image.path,
+                image.failure_reason);
+      continue;
+    }
+    upload(image);
+    uploaded_bytes += static_cast<std::size_t>(image.width) * image.height *
+                      image.channels;
+    for (auto &level : image.mipmaps) {
+      uploaded_bytes += level.pixels.size();
+    }
+    stbi_image_free(image.pixels);
+  }
+}
+
+void TextureLoader::upload(const Image &image) {
+  if (image.layer >= 0 && (image.width != image.layer_width ||
+                           image.height != image.layer_height)) {
+    log_error("{} is {}x{}, but its texture array holds {}x{} layers",
+              image.path, image.width, image.height, image.layer_width,
+              image.layer_height);
+    return;
+  }
+
+  // Level 0 and the prebuilt mips share one buffer, back to back.
+  auto base_size{static_cast<GLsizeiptr>(image.width) * image.height *
+                 image.channels};
+  auto size{base_size};
+  for (auto &level : image.mipmaps) {
+    size += static_cast<GLsizeiptr>(level.pixels.size());
+  }
+  auto &state{gl_state()};
+  state.bind_buffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer_);
+  // Orphan the previous storage so that the copy never waits for an upload
+  // the driver has not consumed yet.
+  glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+  auto mapped{static_cast<unsigned char *>(glMapBufferRange(
+      GL_PIXEL_UNPACK_BUFFER, 0, size,
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT))};
+  if (!mapped) {
+    state.bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    log_error("Failed to map pixel buffer for {}", image.path);
+    return;
+  }
+  std::memcpy(mapped, image.pixels, base_size);
+  auto offset{base_size};
+  for (auto &level : image.mipmaps) {
+    std::memcpy(mapped + offset, level.pixels.data(), level.pixels.size());
+    offset += static_cast<GLsizeiptr>(level.pixels.size());
+  }
+  glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+  auto format{pixel_format(image.channels)};
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  if (image.layer >= 0) {
+    // The storage already exists; only this layer's levels are written.
+    state.bind_texture(0, GL_TEXTURE_2D_ARRAY, image.texture);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, image.layer, image.width,
+                    image.height, 1, format.format, GL_UNSIGNED_BYTE, nullptr);
+    offset = base_size;
+    for (std::size_t i{0}; i < image.mipmaps.size(); ++i) {
+      auto &level{image.mipmaps[i]};
+      glTexSubImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(i + 1), 0, 0,
+                      image.layer, level.width, level.height, 1, format.format,
+                      GL_UNSIGNED_BYTE, reinterpret_cast<const void *>(offset));
+      offset += static_cast<GLsizeiptr>(level.pixels.size());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    state.bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return;
+  }
+  state.bind_texture(0, GL_TEXTURE_2D, image.texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, format.internal_format, image.width,
+               image.height, 0, format.format, GL_UNSIGNED_BYTE, nullptr);
+  offset = base_size;
+  for (std::size_t i{0}; i < image.mipmaps.size(); ++i) {
+    auto &level{image.mipmaps[i]};
+    glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i + 1),
+                 format.internal_format, level.width, level.height, 0,
+                 format.format, GL_UNSIGNED_BYTE,
+                 reinterpret_cast<const void *>(offset));
+    offset += static_cast<GLsizeiptr>(level.pixels.size());
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  state.bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                  static_cast<GLint>(image.mipmaps.size()));
+}
+
+void TextureLoader::work() {
+  for (;;) {
+    Job job;
+    {
+      std::unique_lock lock{mutex_};
+      job_available_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+      if (stopping_) {
+        return;
+      }
+      job = std::move(jobs_.front());
+      jobs_.pop_front();
+    }
+
+    Image image{job.texture, std::move(job.path)};
+    image.layer = job.layer;
+    image.layer_width = job.layer_width;
+    image.layer_height = job.layer_height;
+    // Layers are RGBA8, where gray images uploaded as GL_RED or GL_RG would
+    // sample as red; stb_image expands those to gray RGBA instead.
+    auto channels{0};
+    if (image.layer >= 0 &&
+        stbi_info(image.path.c_str(), &image.width, &image.height,
+                  &image.channels) &&
+        image.channels < 3) {
+      channels = 4;
+    }
+    image.pixels = stbi_load(image.path.c_str(), &image.width, &image.height,
+                             &image.channels, channels);
+    if (image.pixels && channels != 0) {
+      image.channels = channels;
+    }
+    // The failure reason is per thread, so grab it here.
+    image.failure_reason = image.pixels ? nullptr : stbi_failure_reason();
+    if (image.pixels) {
+      // The pool already keeps every core busy, so one thread per image.
+      image.mipmaps = build_mipmaps(image.pixels, image.width, image.height,
+                                    image.channels, {});
+    }
+
+    std::lock_guard lock{mutex_};
+    if (stopping_) {
+      stbi_image_free(image.pixels);
+      return;
+    }
+    decoded_.push_back(std::move(image));
+  }
+}
+
+} // namespace common
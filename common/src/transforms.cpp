@@ -0,0 +1,216 @@
+#include <common/transforms.hpp>
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define COMMON_TRANSFORMS_AVX2
+#endif
+
+namespace common {
+
+namespace {
+
+glm::mat4 world_matrix(float px, float py, float pz, float qx, float qy,
+                       float qz, float qw, float sx, float sy, float sz) {
+  auto xx{qx * qx}, yy{qy * qy}, zz{qz * qz};
+  auto xy{qx * qy}, xz{qx * qz}, yz{qy * qz};
+  auto wx{qw * qx}, wy{qw * qy}, wz{qw * qz};
+  return glm::mat4{
+      glm::vec4{(1.0f - 2.0f * (yy + zz)) * sx, 2.0f * (xy + wz) * sx,
+                2.0f * (xz - wy) * sx, 0.0f},
+      glm::vec4{2.0f * (xy - wz) * sy, (1.0f - 2.0f * (xx + zz)) * sy,
+                2.0f * (yz + wx) * sy, 0.0f},
+      glm::vec4{2.0f * (xz + wy) * sz, 2.0f * (yz - wx) * sz,
+                (1.0f - 2.0f * (xx + yy)) * sz, 0.0f},
+      glm::vec4{px, py, pz, 1.0f},
+  };
+}
+
+#if defined(COMMON_TRANSFORMS_AVX2)
+// Transposes eight rows of eight floats in place.
+void transpose8(__m256 rows[8]) {
+  auto t0{_mm256_unpacklo_ps(rows[0], rows[1])};
+  auto t1{_mm256_unpackhi_ps(rows[0], rows[1])};
+  auto t2{_mm256_unpacklo_ps(rows[2], rows[3])};
+  auto t3{_mm256_unpackhi_ps(rows[2], rows[3])};
+  auto t4{_mm256_unpacklo_ps(rows[4], rows[5])};
+  auto t5{_mm256_unpackhi_ps(rows[4], rows[5])};
+  auto t6{_mm256_unpacklo_ps(rows[6], rows[7])};
+  auto t7{_mm256_unpackhi_ps(rows[6], rows[7])};
+  auto s0{_mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0))};
+  auto s1{_mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2))};
+  auto s2{_mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0))};
+  auto s3{_mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2))};
+  auto s4{_mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0))};
+  auto s5{_mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2))};
+  auto s6{_mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0))};
+  auto s7{_mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2))};
+  rows[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+  rows[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+  rows[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+  rows[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+  rows[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+  rows[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+  rows[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+  rows[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+// Writes element e of object k, held in lane k of m[e], as eight
+// consecutive matrices.
+void store8(__m256 m[16], glm::mat4 *out) {
+  transpose8(m);
+  transpose8(m + 8);
+  auto floats{reinterpret_cast<float *>(out)};
+  for (int k{0}; k < 8; ++k) {
+    _mm256_storeu_ps(floats + 16 * k, m[k]);
+    _mm256_storeu_ps(floats + 16 * k + 8, m[8 + k]);
+  }
+}
+#endif
+
+} // namespace
+
+std::size_t TransformStore::add(const glm::vec3 &position,
+                                const glm::quat &rotation,
+                                const glm::vec3 &scale) {
+  auto index{size_++};
+  if (index == position_x_.size()) {
+    auto padded{position_x_.size() + batch_size};
+    for (auto array : {&position_x_, &position_y_, &position_z_, &rotation_x_,
+                       &rotation_y_, &rotation_z_}) {
+      array->resize(padded, 0.0f);
+    }
+    for (auto array : {&rotation_w_, &scale_x_, &scale_y_, &scale_z_}) {
+      array->resize(padded, 1.0f);
+    }
+  }
+  set_position(index, position);
+  set_rotation(index, rotation);
+  set_scale(index, scale);
+  return index;
+}
+
+void TransformStore::clear() {
+  size_ = 0;
+  for (auto array : {&position_x_, &position_y_, &position_z_, &rotation_x_,
+                     &rotation_y_, &rotation_z_, &rotation_w_, &scale_x_,
+                     &scale_y_, &scale_z_}) {
+    array->clear();
+  }
+}
+
+void TransformStore::set_position(std::size_t index,
+                                  const glm::vec3 &position) {
+  position_x_[index] = position.x;
+  position_y_[index] = position.y;
+  position_z_[index] = position.z;
+}
+
+void TransformStore::set_rotation(std::size_t index,
+                                  const glm::quat &rotation) {
+  rotation_x_[index] = rotation.x;
+  rotation_y_[index] = rotation.y;
+  rotation_z_[index] = rotation.z;
+  rotation_w_[index] = rotation.w;
+}
+
+void TransformStore::set_scale(std::size_t index, const glm::vec3 &scale) {
+  scale_x_[index] = scale.x;
+  scale_y_[index] = scale.y;
+  scale_z_[index] = scale.z;
+}
+
+void TransformStore::compose_world(glm::mat4 *out) const {
+  compose(nullptr, size_, nullptr, out);
+}
+
+void TransformStore::compose_mvp(const glm::mat4 &view_projection,
+                                 glm::mat4 *out) const {
+  compose(nullptr, size_, &view_projection, out);
+}
+
+void TransformStore::compose_world(std::span<const std::uint32_t> indices,
+                                   glm::mat4 *out) const {
+  compose(indices.data(), indices.size(), nullptr, out);
+}
+
+void TransformStore::compose_mvp(const glm::mat4 &view_projection,
+                                 std::span<const std::uint32_t> indices,
+                                 glm::mat4 *out) const {
+  compose(indices.data(), indices.size(), &view_projection, out);
+}
+
+void TransformStore::compose(const std::uint32_t *indices, std::size_t count,
+                             const glm::mat4 *view_projection,
+                             glm::mat4 *out) const {
+  std::size_t i{0};
+#if defined(COMMON_TRANSFORMS_AVX2)
+  // vp[c][r] broadcast: element r of column c.
+  __m256 vp[4][4];
+  if (view_projection) {
+    for (int c{0}; c < 4; ++c) {
+      for (int r{0}; r < 4; ++r) {
+        vp[c][r] = _mm256_set1_ps((*view_projection)[c][r]);
+      }
+    }
+  }
+  auto zero{_mm256_setzero_ps()};
+  auto one{_mm256_set1_ps(1.0f)};
+  auto two{_mm256_set1_ps(2.0f)};
+  for (; i + batch_size <= count; i += batch_size) {
+    auto lanes{indices ? _mm256_loadu_si256(
+                             reinterpret_cast<const __m256i *>(indices + i))
+                       : _mm256_setzero_si256()};
+    auto load{[&](const std::vector<float> &component) {
+      return indices ? _mm256_i32gather_ps(component.data(), lanes, 4)
+                     : _mm256_loadu_ps(&component[i]);
+    }};
+    auto qx{load(rotation_x_)}, qy{load(rotation_y_)}, qz{load(rotation_z_)},
+        qw{load(rotation_w_)};
+    auto sx{load(scale_x_)}, sy{load(scale_y_)}, sz{load(scale_z_)};
+    auto xx{_mm256_mul_ps(qx, qx)}, yy{_mm256_mul_ps(qy, qy)},
+        zz{_mm256_mul_ps(qz, qz)};
+    auto xy{_mm256_mul_ps(qx, qy)}, xz{_mm256_mul_ps(qx, qz)},
+        yz{_mm256_mul_ps(qy, qz)};
+    auto wx{_mm256_mul_ps(qw, qx)}, wy{_mm256_mul_ps(qw, qy)},
+        wz{_mm256_mul_ps(qw, qz)};
+    // Upper 3x4 of the world matrix, column-major; its last row is
+    // (0, 0, 0, 1).
+    __m256 w[4][3]{
+        {_mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(yy, zz), one), sx),
+         _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), sx),
+         _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), sx)},
+        {_mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), sy),
+         _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(xx, zz), one), sy),
+         _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), sy)},
+        {_mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), sz),
+         _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), sz),
+         _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(xx, yy), one), sz)},
+        {load(position_x_), load(position_y_), load(position_z_)},
+    };
+    __m256 m[16];
+    for (int c{0}; c < 4; ++c) {
+      for (int r{0}; r < 4; ++r) {
+        if (view_projection) {
+          // (VP * W)[c][r] = sum over k of VP[k][r] * W[c][k].
+          auto sum{c == 3 ? vp[3][r] : zero};
+          sum = _mm256_fmadd_ps(vp[0][r], w[c][0], sum);
+          sum = _mm256_fmadd_ps(vp[1][r], w[c][1], sum);
+          m[4 * c + r] = _mm256_fmadd_ps(vp[2][r], w[c][2], sum);
+        } else {
+          m[4 * c + r] = r < 3 ? w[c][r] : (c == 3 ? one : zero);
+        }
+      }
+    }
+    store8(m, out + i);
+  }
+#endif
+  for (; i < count; ++i) {
+    auto j{indices ? indices[i] : i};
+    auto world{world_matrix(position_x_[j], position_y_[j], position_z_[j],
+                            rotation_x_[j], rotation_y_[j], rotation_z_[j],
+                            rotation_w_[j], scale_x_[j], scale_y_[j],
+                            scale_z_[j])};
+    out[i] = view_projection ? *view_projection * world : world;
+  }
+}
+
+} // namespace common
@@ -1,7 +1,5 @@
-#define GLFW_INCLUDE_NONE
-#include <GLFW/glfw3.h>
-#include <glad/glad.h>
-#include <iostream>
+#include <common/context.hpp>
+#include <common/state_cache.hpp>
 #include <scope_guard.hpp>
 #include <string>
 
@@ -27,92 +25,22 @@ static const std::string fragment_shader_source =
     "  FragColor = vec4(1.0f, 0.5f, 0.2f, 1.0f);\n"
     "}";
 
-int main() {
-  glfwSetErrorCallback([](int error_code, const char *description) {
-    std::cerr << "error_code: " << error_code << " description: " << description
-              << '\n';
-  });
-
-  if (!glfwInit()) {
-    std::cerr << "Failed to initialize glfw\n";
-    return 1;
-  }
-  SCOPE_EXIT { glfwTerminate(); };
-
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-#ifdef __APPLE__
-  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
-
-  auto window{glfwCreateWindow(window_width, window_height,
-                               window_title.c_str(), nullptr, nullptr)};
-  if (!window) {
-    std::cerr << "Failed to create window\n";
+int main(int argc, char **argv) {
+  auto context{common::Context::create(window_title, window_width,
+                                       window_height,
+                                       common::parse_options(argc, argv))};
+  if (!context) {
     return 1;
   }
-  SCOPE_EXIT { glfwDestroyWindow(window); };
+  auto &state{common::gl_state()};
 
-  glfwMakeContextCurrent(window);
-
-  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-    std::cerr << "Failed to initialize OpenGL context\n";
+  auto shader_program{context->shader_cache().load(vertex_shader_source,
+                                                   fragment_shader_source)};
+  if (!shader_program) {
     return 1;
   }
-
-  glfwSetFramebufferSizeCallback(window,
-                                 [](GLFWwindow *window, int width, int height) {
-                                   glViewport(0, 0, width, height);
-                                 });
-
-  glfwSetKeyCallback(window, [](GLFWwindow *window, int key, int scancode,
-                                int action, int mods) {
-    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
-      glfwSetWindowShouldClose(window, GLFW_TRUE);
-    }
-  });
-
-  GLint success;
-  constexpr GLsizei infobuffer_size{512};
-  GLchar infobuffer[infobuffer_size];
-
-  auto shader_program{glCreateProgram()};
   SCOPE_EXIT { glDeleteProgram(shader_program); };
 
-  {
-    auto vertex_shader{glCreateShader(GL_VERTEX_SHADER)};
-    SCOPE_EXIT { glDeleteShader(vertex_shader); };
-    auto vertex_shader_code{vertex_shader_source.c_str()};
-    glShaderSource(vertex_shader, 1, &vertex_shader_code, nullptr);
-    glCompileShader(vertex_shader);
-    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-      glGetShaderInfoLog(vertex_shader, infobuffer_size, nullptr, infobuffer);
-      std::cerr << infobuffer << '\n';
-    }
-
-    auto fragment_shader{glCreateShader(GL_FRAGMENT_SHADER)};
-    SCOPE_EXIT { glDeleteShader(fragment_shader); };
-    auto fragment_shader_code{fragment_shader_source.c_str()};
-    glShaderSource(fragment_shader, 1, &fragment_shader_code, nullptr);
-    glCompileShader(fragment_shader);
-    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-      glGetShaderInfoLog(fragment_shader, infobuffer_size, nullptr, infobuffer);
-      std::cerr << infobuffer << '\n';
-    }
-
-    glAttachShader(shader_program, vertex_shader);
-    glAttachShader(shader_program, fragment_shader);
-    glLinkProgram(shader_program);
-    glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
-    if (!success) {
-      glGetProgramInfoLog(shader_program, infobuffer_size, nullptr, infobuffer);
-      std::cerr << infobuffer << '\n';
-    }
-  }
-
   float vertices[] = {
       0.5f,  0.5f,  0.0f, 0.5f,  -0.5f, 0.0f,
       -0.5f, -0.5f, 0.0f, -0.5f, 0.5f,  0.0f,
@@ -125,12 +53,12 @@ int main() {
   GLuint VAO;
   glGenVertexArrays(1, &VAO);
   SCOPE_EXIT { glDeleteVertexArrays(1, &VAO); };
-  glBindVertexArray(VAO);
+  state.bind_vertex_array(VAO);
 
   GLuint VBO;
   glGenBuffers(1, &VBO);
   SCOPE_EXIT { glDeleteBuffers(1, &VBO); };
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
+  state.bind_buffer(GL_ARRAY_BUFFER, VBO);
   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float),
                         (void *)(0 * sizeof(float)));
@@ -139,22 +67,22 @@ int main() {
   GLuint EBO;
   glGenBuffers(1, &EBO);
   SCOPE_EXIT { glDeleteBuffers(1, &EBO); };
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+  state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
                GL_STATIC_DRAW);
 
-  while (!glfwWindowShouldClose(window)) {
+  while (context->begin_frame()) {
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    glUseProgram(shader_program);
+    state.use_program(shader_program);
 
-    glBindVertexArray(VAO);
+    state.bind_vertex_array(VAO);
 
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    context->add_draw_calls(1);
 
-    glfwSwapBuffers(window);
-    glfwPollEvents();
+    context->end_frame();
   }
 
   return 0;
@@ -1,12 +1,16 @@
-#define GLFW_INCLUDE_NONE
-#define STB_IMAGE_IMPLEMENTATION
-#include <GLFW/glfw3.h>
+#include <chrono>
 #include <cmath>
-#include <glad/glad.h>
-#include <iostream>
+#include <common/context.hpp>
+#include <common/profiler.hpp>
+#include <common/sprite_batcher.hpp>
+#include <common/state_cache.hpp>
+#include <common/texture_array.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
 #include <scope_guard.hpp>
-#include <stb_image.h>
 #include <string>
+#include <vector>
 
 static const std::string window_title{"HelloTexture"};
 static constexpr int window_width{800};
@@ -41,91 +45,164 @@ static const std::string fragment_shader_source =
     "  FragColor = texture(u_texture0, v_tex_coord);\n"
     "}";
 
-int main() {
-  glfwSetErrorCallback([](int error_code, const char *description) {
-    std::cerr << "error_code: " << error_code << " description: " << description
-              << '\n';
-  });
+// The stress mode's sprites use the container and the layers of an array of
+// small checkerboards.
+static constexpr int checkerboard_layers{3};
+static constexpr int checkerboard_size{64};
 
-  if (!glfwInit()) {
-    std::cerr << "Failed to initialize glfw\n";
-    return 1;
-  }
-  SCOPE_EXIT { glfwTerminate(); };
-
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-#ifdef __APPLE__
-  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
-
-  auto window{glfwCreateWindow(window_width, window_height,
-                               window_title.c_str(), nullptr, nullptr)};
-  if (!window) {
-    std::cerr << "Failed to create window\n";
-    return 1;
+static std::vector<unsigned char> checkerboard(int layer) {
+  const glm::vec3 colors[]{{0.9f, 0.3f, 0.2f},
+                           {0.2f, 0.7f, 0.3f},
+                           {0.3f, 0.4f, 0.9f}};
+  auto color{colors[layer % std::size(colors)]};
+  std::vector<unsigned char> pixels;
+  pixels.reserve(checkerboard_size * checkerboard_size * 3);
+  for (int y{0}; y < checkerboard_size; ++y) {
+    for (int x{0}; x < checkerboard_size; ++x) {
+      auto shade{(x / 8 + y / 8) % 2 ? 255.0f : 96.0f};
+      pixels.push_back(static_cast<unsigned char>(color.x * shade));
+      pixels.push_back(static_cast<unsigned char>(color.y * shade));
+      pixels.push_back(static_cast<unsigned char>(color.z * shade));
+    }
   }
-  SCOPE_EXIT { glfwDestroyWindow(window); };
+  return pixels;
+}
 
-  glfwMakeContextCurrent(window);
+// Bounces context.instances() translucent sprites around the window through
+// a SpriteBatcher, a quarter with the container and the rest with the
+// checkerboard layers, which makes two draw calls per frame. Reports how
+// many sprites per millisecond the batcher queues, sorts and writes out.
+static int run_stress_mode(common::Context &context) {
+  auto &state{common::gl_state()};
 
-  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-    std::cerr << "Failed to initialize OpenGL context\n";
-    return 1;
+  auto container{
+      context.texture_loader().load(context.texture_path(texture_path))};
+  SCOPE_EXIT { glDeleteTextures(1, &container); };
+  state.bind_texture(0, GL_TEXTURE_2D, container);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+  common::TextureArray checkerboards{checkerboard_size, checkerboard_size,
+                                     checkerboard_layers};
+  for (int layer{0}; layer < checkerboard_layers; ++layer) {
+    checkerboards.add(checkerboard(layer).data(), checkerboard_size,
+                      checkerboard_size, 3);
   }
 
-  glfwSetFramebufferSizeCallback(window,
-                                 [](GLFWwindow *window, int width, int height) {
-                                   glViewport(0, 0, width, height);
-                                 });
+  common::SpriteBatcher batcher{context.shader_cache()};
+  auto container_sprites{batcher.add_texture(container)};
+  auto checkerboard_sprites{
+      batcher.add_texture(checkerboards.texture(), GL_TEXTURE_2D_ARRAY)};
 
-  glfwSetKeyCallback(window, [](GLFWwindow *window, int key, int scancode,
-                                int action, int mods) {
-    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
-      glfwSetWindowShouldClose(window, GLFW_TRUE);
+  auto count{context.instances()};
+  std::mt19937 random{42};
+  std::uniform_real_distribution<float> unit{0.0f, 1.0f};
+  std::vector<common::Sprite> sprites;
+  std::vector<std::uint32_t> sprite_textures;
+  std::vector<glm::vec2> velocities;
+  for (int i{0}; i < count; ++i) {
+    common::Sprite sprite;
+    sprite.min = glm::vec2(unit(random) * window_width,
+                           unit(random) * window_height);
+    sprite.max = sprite.min + glm::vec2(8.0f + 16.0f * unit(random));
+    sprite.color = static_cast<std::uint32_t>(unit(random) * 255.0f) |
+                   static_cast<std::uint32_t>(unit(random) * 255.0f) << 8 |
+                   static_cast<std::uint32_t>(unit(random) * 255.0f) << 16 |
+                   0xc0u << 24;
+    if (i % 4 == 0) {
+      sprite_textures.push_back(container_sprites);
+    } else {
+      sprite.layer = static_cast<std::uint32_t>(i % checkerboard_layers);
+      sprite_textures.push_back(checkerboard_sprites);
     }
-  });
+    sprites.push_back(sprite);
+    velocities.push_back((glm::vec2(unit(random), unit(random)) - 0.5f) *
+                         200.0f);
+  }
 
-  GLint success;
-  constexpr GLsizei infobuffer_size{512};
-  GLchar infobuffer[infobuffer_size];
+  auto projection{glm::ortho(0.0f, (float)window_width, (float)window_height,
+                             0.0f, -1.0f, 1.0f)};
+  auto last_time{context.time()};
 
-  auto shader_program{glCreateProgram()};
-  SCOPE_EXIT { glDeleteProgram(shader_program); };
+  while (context.begin_frame()) {
+    auto time{context.time()};
+    auto delta{static_cast<float>(time - last_time)};
+    last_time = time;
+
+    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
 
-  {
-    auto vertex_shader{glCreateShader(GL_VERTEX_SHADER)};
-    SCOPE_EXIT { glDeleteShader(vertex_shader); };
-    auto vertex_shader_code{vertex_shader_source.c_str()};
-    glShaderSource(vertex_shader, 1, &vertex_shader_code, nullptr);
-    glCompileShader(vertex_shader);
-    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-      glGetShaderInfoLog(vertex_shader, infobuffer_size, nullptr, infobuffer);
-      std::cerr << infobuffer << '\n';
+    auto &profiler{context.profiler()};
+    {
+      common::CpuZone zone{profiler, "animate"};
+      for (int i{0}; i < count; ++i) {
+        auto &sprite{sprites[i]};
+        auto &velocity{velocities[i]};
+        auto offset{velocity * delta};
+        if (sprite.min.x + offset.x < 0.0f ||
+            sprite.max.x + offset.x > window_width) {
+          velocity.x = -velocity.x;
+          offset.x = -offset.x;
+        }
+        if (sprite.min.y + offset.y < 0.0f ||
+            sprite.max.y + offset.y > window_height) {
+          velocity.y = -velocity.y;
+          offset.y = -offset.y;
+        }
+        sprite.min += offset;
+        sprite.max += offset;
+      }
     }
 
-    auto fragment_shader{glCreateShader(GL_FRAGMENT_SHADER)};
-    SCOPE_EXIT { glDeleteShader(fragment_shader); };
-    auto fragment_shader_code{fragment_shader_source.c_str()};
-    glShaderSource(fragment_shader, 1, &fragment_shader_code, nullptr);
-    glCompileShader(fragment_shader);
-    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-      glGetShaderInfoLog(fragment_shader, infobuffer_size, nullptr, infobuffer);
-      std::cerr << infobuffer << '\n';
+    {
+      common::CpuZone zone{profiler, "batch"};
+      auto start{std::chrono::steady_clock::now()};
+      for (int i{0}; i < count; ++i) {
+        batcher.draw(sprite_textures[i], sprites[i]);
+      }
+      batcher.prepare();
+      auto elapsed{std::chrono::duration<double, std::milli>(
+                       std::chrono::steady_clock::now() - start)
+                       .count()};
+      context.add_counter("sprites", count);
+      if (elapsed > 0.0) {
+        context.add_sample("sprites_per_ms", count / elapsed);
+      }
     }
 
-    glAttachShader(shader_program, vertex_shader);
-    glAttachShader(shader_program, fragment_shader);
-    glLinkProgram(shader_program);
-    glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
-    if (!success) {
-      glGetProgramInfoLog(shader_program, infobuffer_size, nullptr, infobuffer);
-      std::cerr << infobuffer << '\n';
+    {
+      common::CpuZone zone{profiler, "draw"};
+      common::GpuZone gpu_zone{profiler, "draw"};
+      context.add_draw_calls(batcher.flush(projection));
     }
+
+    context.end_frame();
+  }
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  auto context{common::Context::create(window_title, window_width,
+                                       window_height,
+                                       common::parse_options(argc, argv))};
+  if (!context) {
+    return 1;
+  }
+  if (context->instances() > 0) {
+    return run_stress_mode(*context);
   }
+  auto &state{common::gl_state()};
+
+  auto shader_program{context->shader_cache().load(vertex_shader_source,
+                                                   fragment_shader_source)};
+  if (!shader_program) {
+    return 1;
+  }
+  SCOPE_EXIT { glDeleteProgram(shader_program); };
 
   float vertices[] = {
       0.5f,  0.5f,  0.0f, 1.0f, 1.0f, 0.5f,  -0.5f, 0.0f, 1.0f, 0.0f,
@@ -139,12 +216,12 @@ int main() {
   GLuint VAO;
   glGenVertexArrays(1, &VAO);
   SCOPE_EXIT { glDeleteVertexArrays(1, &VAO); };
-  glBindVertexArray(VAO);
+  state.bind_vertex_array(VAO);
 
   GLuint VBO;
   glGenBuffers(1, &VBO);
   SCOPE_EXIT { glDeleteBuffers(1, &VBO); };
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
+  state.bind_buffer(GL_ARRAY_BUFFER, VBO);
   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)0);
   glEnableVertexAttribArray(0);
@@ -155,51 +232,34 @@ int main() {
   GLuint EBO;
   glGenBuffers(1, &EBO);
   SCOPE_EXIT { glDeleteBuffers(1, &EBO); };
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+  state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
                GL_STATIC_DRAW);
 
-  GLuint u_texture0;
-  glGenTextures(1, &u_texture0);
+  auto u_texture0{
+      context->texture_loader().load(context->texture_path(texture_path))};
   SCOPE_EXIT { glDeleteTextures(1, &u_texture0); };
-  glBindTexture(GL_TEXTURE_2D, u_texture0);
+  state.bind_texture(0, GL_TEXTURE_2D, u_texture0);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
                   GL_LINEAR_MIPMAP_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-  {
-    GLsizei image_width, image_height;
-    int image_channels;
-    stbi_set_flip_vertically_on_load(true);
-    auto image_data{stbi_load(texture_path.c_str(), &image_width, &image_height,
-                              &image_channels, 0)};
-    if (!image_data) {
-      std::cerr << "Failed to load image\n";
-      return 1;
-    }
-    SCOPE_EXIT { stbi_image_free(image_data); };
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, image_width, image_height, 0, GL_RGB,
-                 GL_UNSIGNED_BYTE, image_data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-  }
-
-  while (!glfwWindowShouldClose(window)) {
+  while (context->begin_frame()) {
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    glUseProgram(shader_program);
+    state.use_program(shader_program);
 
-    glBindVertexArray(VAO);
+    state.bind_vertex_array(VAO);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, u_texture0);
+    state.bind_texture(0, GL_TEXTURE_2D, u_texture0);
 
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    context->add_draw_calls(1);
 
-    glfwSwapBuffers(window);
-    glfwPollEvents();
+    context->end_frame();
   }
 
   return 0;
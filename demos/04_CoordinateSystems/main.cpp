@@ -1,15 +1,19 @@
-#define GLFW_INCLUDE_NONE
-#define STB_IMAGE_IMPLEMENTATION
-#include <GLFW/glfw3.h>
+#include <algorithm>
 #include <cmath>
-#include <glad/glad.h>
+#include <common/context.hpp>
+#include <common/draw_list.hpp>
+#include <common/frustum.hpp>
+#include <common/gpu_culling.hpp>
+#include <common/log.hpp>
+#include <common/parallel.hpp>
+#include <common/reflection.hpp>
+#include <common/state_cache.hpp>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
-#include <iostream>
 #include <scope_guard.hpp>
-#include <stb_image.h>
 #include <string>
+#include <thread>
+#include <vector>
 
 static const std::string window_title{"CoordinateSystems"};
 static constexpr int window_width{800};
@@ -47,91 +51,243 @@ static const std::string fragment_shader_source =
     "  FragColor = texture(u_texture0, v_tex_coord);\n"
     "}";
 
-int main() {
-  glfwSetErrorCallback([](int error_code, const char *description) {
-    std::cerr << "error_code: " << error_code << " description: " << description
-              << '\n';
-  });
+// The stress mode's vertex shader with GPU culling: the quad's position is
+// its bounding sphere's center, and its spin is computed here instead of on
+// the CPU.
+static const std::string culled_vertex_shader_source =
+    "#version 430 core\n"
+    "layout (location = 0) in vec3 a_position;\n"
+    "layout (location = 1) in vec2 a_tex_coord;\n"
+    "layout (location = 7) in uint a_object;\n"
+    "\n"
+    "layout (std430, binding = 0) readonly buffer Objects {\n"
+    "  vec4 objects[];\n"
+    "};\n"
+    "\n"
+    "uniform mat4 u_view;\n"
+    "uniform mat4 u_projection;\n"
+    "uniform float u_time;\n"
+    "uniform vec3 u_spin_axis;\n"
+    "\n"
+    "out vec2 v_tex_coord;\n"
+    "\n"
+    "// glm::rotate() of the CPU path.\n"
+    "mat3 rotation(float angle, vec3 axis)\n"
+    "{\n"
+    "  float c = cos(angle);\n"
+    "  float s = sin(angle);\n"
+    "  vec3 t = (1.0 - c) * axis;\n"
+    "  return mat3(c + t.x * axis.x, t.x * axis.y + s * axis.z,\n"
+    "              t.x * axis.z - s * axis.y,\n"
+    "              t.y * axis.x - s * axis.z, c + t.y * axis.y,\n"
+    "              t.y * axis.z + s * axis.x,\n"
+    "              t.z * axis.x + s * axis.y, t.z * axis.y - s * axis.x,\n"
+    "              c + t.z * axis.z);\n"
+    "}\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "  float angle = u_time + 0.1 * float(a_object);\n"
+    "  vec3 position = objects[a_object].xyz +\n"
+    "                  rotation(angle, u_spin_axis) * a_position;\n"
+    "  v_tex_coord = a_tex_coord;\n"
+    "  gl_Position = u_projection * u_view * vec4(position, 1.0);\n"
+    "}";
 
-  if (!glfwInit()) {
-    std::cerr << "Failed to initialize glfw\n";
-    return 1;
-  }
-  SCOPE_EXIT { glfwTerminate(); };
-
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-#ifdef __APPLE__
-  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
-
-  auto window{glfwCreateWindow(window_width, window_height,
-                               window_title.c_str(), nullptr, nullptr)};
-  if (!window) {
-    std::cerr << "Failed to create window\n";
-    return 1;
-  }
-  SCOPE_EXIT { glfwDestroyWindow(window); };
+// Bounds that hold a unit quad in any orientation.
+static constexpr auto quad_radius{0.7072f};
+
+// Draws context.instances() spinning quads in a grid, each with its own draw
+// call and u_model. Worker threads cull them against the view frustum and
+// record the visible ones into one draw list each; the main thread sorts
+// and issues the packets of all lists.
+static int run_stress_mode(common::Context &context, GLuint shader_program,
+                           GLuint vertex_array, GLuint texture) {
+  auto &state{common::gl_state()};
+  common::ProgramReflection reflection{shader_program};
+  auto u_model_info{reflection.find("u_model")};
+  auto u_model_location{u_model_info ? u_model_info->location : -1};
+  auto u_view_uniform{reflection.uniform<glm::mat4>("u_view")};
+  auto u_projection_uniform{reflection.uniform<glm::mat4>("u_projection")};
+
+  // A grid of quads seen from close enough that only part of it is in view.
+  auto count{context.instances()};
+  auto side{static_cast<int>(std::ceil(std::sqrt(count)))};
+  constexpr auto spacing{1.5f};
+  auto extent{side * spacing};
+  auto u_view{glm::translate(glm::mat4(1.0f),
+                             glm::vec3(0.0f, 0.0f, -extent / 4.0f - 1.0f))};
+  auto far_plane{std::max(100.0f, extent)};
+  auto u_projection{glm::perspective(glm::radians(45.0f),
+                                     (float)window_width /
+                                         (float)window_height,
+                                     0.1f, far_plane)};
+  common::Frustum frustum{u_projection * u_view};
+  auto spin_axis{glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f))};
+
+  auto threads{std::max(1u, std::thread::hardware_concurrency())};
+  std::vector<common::DrawList> lists(threads);
+  std::vector<std::size_t> visible(threads);
+  common::DrawQueue queue;
+  common::DrawState draw_state{shader_program, vertex_array, texture};
+
+  while (context.begin_frame()) {
+    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
 
-  glfwMakeContextCurrent(window);
+    state.use_program(shader_program);
+    u_view_uniform.set(u_view);
+    u_projection_uniform.set(u_projection);
+
+    auto time{static_cast<float>(context.time())};
+    // Each list records a contiguous run of the grid.
+    auto per_list{(static_cast<std::size_t>(count) + threads - 1) / threads};
+    auto &profiler{context.profiler()};
+    auto record{[&](std::size_t l) {
+      common::CpuZone zone{profiler, "record"};
+      auto &list{lists[l]};
+      list.clear();
+      visible[l] = 0;
+      auto last{std::min<std::size_t>(count, (l + 1) * per_list)};
+      for (auto i{l * per_list}; i < last; ++i) {
+        auto position{spacing * glm::vec3(i % side - (side - 1) / 2.0f,
+                                          i / side - (side - 1) / 2.0f, 0.0f)};
+        common::Aabb bounds{position - glm::vec3(quad_radius),
+                            position + glm::vec3(quad_radius)};
+        if (frustum.classify(bounds) == common::Containment::outside) {
+          continue;
+        }
+        auto u_model{glm::translate(glm::mat4(1.0f), position)};
+        u_model = glm::rotate(u_model, time + 0.1f * i, spin_axis);
+        // Nearer quads first, which pays off once there is depth testing.
+        auto distance{
+            glm::length(glm::vec3(u_view * glm::vec4(position, 1.0f)))};
+        auto depth{static_cast<std::uint16_t>(
+            std::min(distance / far_plane, 1.0f) * 65535.0f)};
+        list.draw(draw_state, 6, 0, depth);
+        list.uniform(u_model_location, u_model);
+        ++visible[l];
+      }
+    }};
+    common::parallel_for(threads, threads, 1,
+                         [&](std::size_t begin, std::size_t end) {
+                           for (auto l{begin}; l < end; ++l) {
+                             record(l);
+                           }
+                         });
+
+    {
+      common::CpuZone zone{profiler, "submit"};
+      common::GpuZone gpu_zone{profiler, "submit"};
+      context.add_draw_calls(queue.submit(lists));
+    }
+    std::size_t visible_objects{0};
+    for (auto objects : visible) {
+      visible_objects += objects;
+    }
+    context.add_counter("visible_objects", visible_objects);
 
-  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-    std::cerr << "Failed to initialize OpenGL context\n";
-    return 1;
+    context.end_frame();
   }
 
-  glfwSetFramebufferSizeCallback(window,
-                                 [](GLFWwindow *window, int width, int height) {
-                                   glViewport(0, 0, width, height);
-                                 });
+  return 0;
+}
+
+// The same grid with GpuCuller: the bounding spheres are uploaded once, and
+// every frame costs the CPU one dispatch and one indirect draw however many
+// quads there are. With depth testing on, the depth of each frame feeds the
+// next frame's occlusion culling.
+static int run_gpu_culled_stress_mode(common::Context &context,
+                                      GLuint vertex_array, GLuint texture) {
+  auto &state{common::gl_state()};
+  auto shader_program{context.shader_cache().load(
+      culled_vertex_shader_source, fragment_shader_source)};
+  if (!shader_program) {
+    return 1;
+  }
+  SCOPE_EXIT {
+    glDeleteProgram(shader_program);
+    state.forget_program(shader_program);
+  };
+  common::ProgramReflection reflection{shader_program};
+  auto u_view_uniform{reflection.uniform<glm::mat4>("u_view")};
+  auto u_projection_uniform{reflection.uniform<glm::mat4>("u_projection")};
+  auto u_time_uniform{reflection.uniform<float>("u_time")};
+  auto u_spin_axis_uniform{reflection.uniform<glm::vec3>("u_spin_axis")};
+
+  auto count{context.instances()};
+  auto side{static_cast<int>(std::ceil(std::sqrt(count)))};
+  constexpr auto spacing{1.5f};
+  auto extent{side * spacing};
+  auto u_view{glm::translate(glm::mat4(1.0f),
+                             glm::vec3(0.0f, 0.0f, -extent / 4.0f - 1.0f))};
+  auto far_plane{std::max(100.0f, extent)};
+  auto u_projection{glm::perspective(glm::radians(45.0f),
+                                     (float)window_width /
+                                         (float)window_height,
+                                     0.1f, far_plane)};
+
+  common::GpuCuller culler;
+  std::vector<glm::vec4> spheres;
+  for (int i{0}; i < count; ++i) {
+    spheres.emplace_back(spacing * (i % side - (side - 1) / 2.0f),
+                         spacing * (i / side - (side - 1) / 2.0f), 0.0f,
+                         quad_radius);
+  }
+  culler.set_objects(spheres);
 
-  glfwSetKeyCallback(window, [](GLFWwindow *window, int key, int scancode,
-                                int action, int mods) {
-    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
-      glfwSetWindowShouldClose(window, GLFW_TRUE);
+  state.set_enabled(GL_DEPTH_TEST, true);
+  while (context.begin_frame()) {
+    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    state.use_program(shader_program);
+    u_view_uniform.set(u_view);
+    u_projection_uniform.set(u_projection);
+    u_time_uniform.set(static_cast<float>(context.time()));
+    u_spin_axis_uniform.set(glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f)));
+    state.bind_texture(0, GL_TEXTURE_2D, texture);
+
+    auto &profiler{context.profiler()};
+    {
+      common::CpuZone zone{profiler, "submit"};
+      common::GpuZone gpu_zone{profiler, "submit"};
+      context.add_draw_calls(
+          culler.draw(u_projection * u_view, shader_program, vertex_array, 6));
     }
-  });
-
-  GLint success;
-  constexpr GLsizei infobuffer_size{512};
-  GLchar infobuffer[infobuffer_size];
+    {
+      common::CpuZone zone{profiler, "depth_pyramid"};
+      common::GpuZone gpu_zone{profiler, "depth_pyramid"};
+      culler.update_depth();
+    }
+    context.add_counter("visible_objects", culler.visible_objects());
 
-  auto shader_program{glCreateProgram()};
-  SCOPE_EXIT { glDeleteProgram(shader_program); };
+    context.end_frame();
+  }
 
-  {
-    auto vertex_shader{glCreateShader(GL_VERTEX_SHADER)};
-    SCOPE_EXIT { glDeleteShader(vertex_shader); };
-    auto vertex_shader_code{vertex_shader_source.c_str()};
-    glShaderSource(vertex_shader, 1, &vertex_shader_code, nullptr);
-    glCompileShader(vertex_shader);
-    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-      glGetShaderInfoLog(vertex_shader, infobuffer_size, nullptr, infobuffer);
-      std::cerr << infobuffer << '\n';
-    }
+  return 0;
+}
 
-    auto fragment_shader{glCreateShader(GL_FRAGMENT_SHADER)};
-    SCOPE_EXIT { glDeleteShader(fragment_shader); };
-    auto fragment_shader_code{fragment_shader_source.c_str()};
-    glShaderSource(fragment_shader, 1, &fragment_shader_code, nullptr);
-    glCompileShader(fragment_shader);
-    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-      glGetShaderInfoLog(fragment_shader, infobuffer_size, nullptr, infobuffer);
-      std::cerr << infobuffer << '\n';
-    }
+int main(int argc, char **argv) {
+  auto context{common::Context::create(window_title, window_width,
+                                       window_height,
+                                       common::parse_options(argc, argv))};
+  if (!context) {
+    return 1;
+  }
+  auto &state{common::gl_state()};
 
-    glAttachShader(shader_program, vertex_shader);
-    glAttachShader(shader_program, fragment_shader);
-    glLinkProgram(shader_program);
-    glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
-    if (!success) {
-      glGetProgramInfoLog(shader_program, infobuffer_size, nullptr, infobuffer);
-      std::cerr << infobuffer << '\n';
-    }
+  auto shader_program{context->shader_cache().load(vertex_shader_source,
+                                                   fragment_shader_source)};
+  if (!shader_program) {
+    return 1;
   }
+  SCOPE_EXIT { glDeleteProgram(shader_program); };
+
+  common::ProgramReflection reflection{shader_program};
+  auto u_model_uniform{reflection.uniform<glm::mat4>("u_model")};
+  auto u_view_uniform{reflection.uniform<glm::mat4>("u_view")};
+  auto u_projection_uniform{reflection.uniform<glm::mat4>("u_projection")};
 
   float vertices[] = {
       0.5f,  0.5f,  0.0f, 1.0f, 1.0f, 0.5f,  -0.5f, 0.0f, 1.0f, 0.0f,
@@ -145,12 +301,12 @@ int main() {
   GLuint VAO;
   glGenVertexArrays(1, &VAO);
   SCOPE_EXIT { glDeleteVertexArrays(1, &VAO); };
-  glBindVertexArray(VAO);
+  state.bind_vertex_array(VAO);
 
   GLuint VBO;
   glGenBuffers(1, &VBO);
   SCOPE_EXIT { glDeleteBuffers(1, &VBO); };
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
+  state.bind_buffer(GL_ARRAY_BUFFER, VBO);
   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)0);
   glEnableVertexAttribArray(0);
@@ -161,71 +317,59 @@ int main() {
   GLuint EBO;
   glGenBuffers(1, &EBO);
   SCOPE_EXIT { glDeleteBuffers(1, &EBO); };
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+  state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
                GL_STATIC_DRAW);
 
-  GLuint u_texture0;
-  glGenTextures(1, &u_texture0);
+  auto u_texture0{
+      context->texture_loader().load(context->texture_path(texture_path))};
   SCOPE_EXIT { glDeleteTextures(1, &u_texture0); };
-  glBindTexture(GL_TEXTURE_2D, u_texture0);
+  state.bind_texture(0, GL_TEXTURE_2D, u_texture0);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
                   GL_LINEAR_MIPMAP_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-  {
-    GLsizei image_width, image_height;
-    int image_channels;
-    stbi_set_flip_vertically_on_load(true);
-    auto image_data{stbi_load(texture_path.c_str(), &image_width, &image_height,
-                              &image_channels, 0)};
-    if (!image_data) {
-      std::cerr << "Failed to load image\n";
-      return 1;
+  if (context->instances() > 0) {
+    if (context->gpu_culling()) {
+      if (common::GpuCuller::supported()) {
+        return run_gpu_culled_stress_mode(*context, VAO, u_texture0);
+      }
+      common::log_warning("GPU culling needs GL 4.3, culling on the CPU");
     }
-    SCOPE_EXIT { stbi_image_free(image_data); };
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, image_width, image_height, 0, GL_RGB,
-                 GL_UNSIGNED_BYTE, image_data);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    return run_stress_mode(*context, shader_program, VAO, u_texture0);
   }
 
-  while (!glfwWindowShouldClose(window)) {
+  while (context->begin_frame()) {
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    glUseProgram(shader_program);
+    state.use_program(shader_program);
 
-    glBindVertexArray(VAO);
+    state.bind_vertex_array(VAO);
 
     auto u_model{glm::mat4(1.0f)};
     u_model =
         glm::rotate(u_model, glm::radians(-55.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-    auto u_model_location{glGetUniformLocation(shader_program, "u_model")};
-    glUniformMatrix4fv(u_model_location, 1, GL_FALSE, glm::value_ptr(u_model));
+    u_model_uniform.set(u_model);
 
     auto u_view{glm::mat4(1.0f)};
     u_view = glm::translate(u_view, glm::vec3(0.0f, 0.0f, -3.0f));
-    auto u_view_location{glGetUniformLocation(shader_program, "u_view")};
-    glUniformMatrix4fv(u_view_location, 1, GL_FALSE, glm::value_ptr(u_view));
+    u_view_uniform.set(u_view);
 
     auto u_projection{glm::mat4(1.0f)};
     u_projection = glm::perspective(glm::radians(45.0f),
                                     (float)window_width / (float)window_height,
                                     0.1f, 100.0f);
-    auto u_projection_location{
-        glGetUniformLocation(shader_program, "u_projection")};
-    glUniformMatrix4fv(u_projection_location, 1, GL_FALSE,
-                       glm::value_ptr(u_projection));
+    u_projection_uniform.set(u_projection);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, u_texture0);
+    state.bind_texture(0, GL_TEXTURE_2D, u_texture0);
 
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    context->add_draw_calls(1);
 
-    glfwSwapBuffers(window);
-    glfwPollEvents();
+    context->end_frame();
   }
 
   return 0;
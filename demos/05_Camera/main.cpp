@@ -1,34 +1,211 @@
-#define GLFW_INCLUDE_NONE
-#define STB_IMAGE_IMPLEMENTATION
-#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <cmath>
-#include <glad/glad.h>
+#include <common/bvh.hpp>
+#include <common/context.hpp>
+#include <common/event_queue.hpp>
+#include <common/instancing.hpp>
+#include <common/lod.hpp>
+#include <common/mesh.hpp>
+#include <common/mesh_file.hpp>
+#include <common/reflection.hpp>
+#include <common/simulation.hpp>
+#include <common/snapshot_buffer.hpp>
+#include <common/state_cache.hpp>
+#include <common/texture_array.hpp>
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
-#include <iostream>
+#include <glm/gtc/quaternion.hpp>
 #include <scope_guard.hpp>
-#include <stb_image.h>
 #include <string>
+#include <vector>
 
 static const std::string window_title{"Camera"};
 static constexpr int window_width{800};
 static constexpr int window_height{600};
 static const std::string texture_path{"resources/textures/container.jpg"};
-static auto camera_pos{glm::vec3(0.0f, 0.0f, 3.0f)};
-static auto camera_front{glm::vec3(0.0f, 0.0f, -1.0f)};
-static auto camera_up{glm::vec3(0.0f, 1.0f, 0.0f)};
+static const auto camera_up{glm::vec3(0.0f, 1.0f, 0.0f)};
 static constexpr auto camera_speed{2.5f};
 static constexpr auto sensitivity{0.1f};
-bool firstMouse = true;
-float yaw   = -90.0f;
-float pitch =  0.0f;
-float lastX =  800.0f / 2.0;
-float lastY =  600.0 / 2.0;
-float fov   =  45.0f;
 
-static auto delta_time{0.0f};
-static auto last_frame{0.0f};
+using simulation_clock = common::SimulationThread::clock;
+
+// The simulation ticks at 120 Hz whatever the frame rate is.
+static constexpr std::chrono::nanoseconds simulation_step{8'333'333};
+static constexpr auto step_seconds{
+    std::chrono::duration<float>(simulation_step).count()};
+
+struct InputEvent {
+  enum class Type { key, cursor, scroll, probe };
+  Type type{Type::probe};
+  int key{0};
+  int action{0};
+  double x{0.0};
+  double y{0.0};
+  simulation_clock::time_point time;
+};
+
+// Filled by the GLFW callbacks on the main thread and drained by the
+// simulation thread at the start of every tick.
+static common::EventQueue<InputEvent, 1024> input_events;
+
+static void push_input(InputEvent event) {
+  event.time = simulation_clock::now();
+  // A full queue means the simulation is stalled; drop the event.
+  input_events.push(event);
+}
+
+struct CameraState {
+  glm::vec3 position{0.0f, 0.0f, 3.0f};
+  glm::vec3 front{0.0f, 0.0f, -1.0f};
+  float fov{45.0f};
+  // Simulated seconds, which drive the scene's animation.
+  float time{0.0f};
+};
+
+// The states after the two latest ticks, which the render thread blends.
+struct CameraSnapshot {
+  CameraState previous;
+  CameraState current;
+  std::uint64_t tick{0};
+  simulation_clock::time_point tick_time;
+  // When the newest input event reflected in `current` was received.
+  simulation_clock::time_point input_time;
+};
+
+// Moves the camera and advances the scene clock on a fixed-timestep thread.
+// Keys move the camera for as long as they are held, at the same speed at
+// any frame rate.
+class CameraSimulation {
+public:
+  explicit CameraSimulation(const CameraState &initial)
+      : state_{initial},
+        snapshots_{CameraSnapshot{initial, initial, 0,
+                                  simulation_clock::now(), {}}},
+        thread_{simulation_step,
+                [this](simulation_clock::time_point time) { tick(time); }} {}
+
+  // The camera to draw this frame. Rendering runs one tick behind the
+  // simulation and blends the two latest ticks, so motion stays smooth when
+  // the frame rate and the tick rate differ.
+  CameraState sample() {
+    snapshot_ = snapshots_.latest();
+    auto since_tick{simulation_clock::now() - snapshot_.tick_time};
+    auto alpha{std::clamp(
+        std::chrono::duration<float>(since_tick).count() / step_seconds, 0.0f,
+        1.0f)};
+    auto &from{snapshot_.previous};
+    auto &to{snapshot_.current};
+    return {glm::mix(from.position, to.position, alpha),
+            glm::normalize(glm::mix(from.front, to.front, alpha)),
+            glm::mix(from.fov, to.fov, alpha),
+            glm::mix(from.time, to.time, alpha)};
+  }
+
+  // Call once the frame drawn from the last sample() is presented. Counts the
+  // ticks since the previous frame and, when the frame shows input it has
+  // not shown before, records the time from that input to now.
+  void presented(common::Context &context) {
+    context.add_counter("simulation_ticks", snapshot_.tick - presented_tick_);
+    presented_tick_ = snapshot_.tick;
+    if (snapshot_.input_time > presented_input_time_) {
+      context.add_sample("input_latency_ms",
+                         std::chrono::duration<double, std::milli>(
+                             simulation_clock::now() - snapshot_.input_time)
+                             .count());
+      presented_input_time_ = snapshot_.input_time;
+    }
+  }
+
+private:
+  void tick(simulation_clock::time_point time) {
+    auto previous{state_};
+    InputEvent event;
+    while (input_events.pop(event)) {
+      input_time_ = event.time;
+      apply(event);
+    }
+
+    auto right{glm::normalize(glm::cross(state_.front, camera_up))};
+    auto distance{camera_speed * step_seconds};
+    state_.position += distance * (float(held_[0]) - float(held_[1])) *
+                       state_.front;
+    state_.position += distance * (float(held_[3]) - float(held_[2])) * right;
+    state_.time = ++tick_count_ * step_seconds;
+
+    snapshots_.publish({previous, state_, tick_count_, time, input_time_});
+  }
+
+  void apply(const InputEvent &event) {
+    switch (event.type) {
+    case InputEvent::Type::key: {
+      const int keys[]{GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D};
+      for (std::size_t i{0}; i < held_.size(); ++i) {
+        if (event.key == keys[i] && event.action != GLFW_REPEAT) {
+          held_[i] = event.action == GLFW_PRESS;
+        }
+      }
+      break;
+    }
+    case InputEvent::Type::cursor: {
+      auto x{static_cast<float>(event.x)}, y{static_cast<float>(event.y)};
+      if (first_cursor_) {
+        last_x_ = x;
+        last_y_ = y;
+        first_cursor_ = false;
+      }
+      yaw_ += (x - last_x_) * sensitivity;
+      pitch_ = std::clamp(pitch_ + (last_y_ - y) * sensitivity, -89.0f, 89.0f);
+      last_x_ = x;
+      last_y_ = y;
+
+      glm::vec3 front;
+      front.x = cos(glm::radians(yaw_)) * cos(glm::radians(pitch_));
+      front.y = sin(glm::radians(pitch_));
+      front.z = sin(glm::radians(yaw_)) * cos(glm::radians(pitch_));
+      state_.front = glm::normalize(front);
+      break;
+    }
+    case InputEvent::Type::scroll:
+      state_.fov =
+          std::clamp(state_.fov - static_cast<float>(event.y), 1.0f, 45.0f);
+      break;
+    case InputEvent::Type::probe:
+      break;
+    }
+  }
+
+  // Simulation thread.
+  CameraState state_;
+  float yaw_{-90.0f};
+  float pitch_{0.0f};
+  bool first_cursor_{true};
+  float last_x_{0.0f};
+  float last_y_{0.0f};
+  // W, S, A and D.
+  std::array<bool, 4> held_{};
+  std::uint64_t tick_count_{0};
+  simulation_clock::time_point input_time_;
+
+  // Render thread.
+  CameraSnapshot snapshot_;
+  std::uint64_t presented_tick_{0};
+  simulation_clock::time_point presented_input_time_;
+
+  common::SnapshotBuffer<CameraSnapshot> snapshots_;
+  // Last, so that the thread stops before the state it ticks goes away.
+  common::SimulationThread thread_;
+};
+
+// Headless runs have no user, so every frame sends an event that does
+// nothing, to measure the input latency all the same.
+static void probe_input(common::Context &context) {
+  if (context.headless()) {
+    push_input({InputEvent::Type::probe});
+  }
+}
 
 static const std::string vertex_shader_source =
     "#version 330 core\n"
@@ -48,6 +225,65 @@ static const std::string vertex_shader_source =
     "  gl_Position = u_projection * u_view * u_model * vec4(a_position, 1.0);\n"
     "}";
 
+// Stress mode: the model matrix and texture layer come from the instance
+// buffer.
+static const std::string instanced_vertex_shader_source =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 a_position;\n"
+    "layout (location = 1) in vec2 a_tex_coord;\n"
+    "layout (location = 2) in mat4 a_model;\n"
+    "layout (location = 6) in uint a_layer;\n"
+    "\n"
+    "uniform mat4 u_view;\n"
+    "uniform mat4 u_projection;\n"
+    "\n"
+    "out vec2 v_tex_coord;\n"
+    "flat out uint v_layer;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "  v_tex_coord = a_tex_coord;\n"
+    "  v_layer = a_layer;\n"
+    "  gl_Position = u_projection * u_view * a_model * vec4(a_position, 1.0);\n"
+    "}";
+
+static const std::string instanced_fragment_shader_source =
+    "#version 330 core\n"
+    "uniform sampler2DArray u_texture0;\n"
+    "\n"
+    "in vec2 v_tex_coord;\n"
+    "flat in uint v_layer;\n"
+    "\n"
+    "out vec4 FragColor;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "  FragColor = texture(u_texture0, vec3(v_tex_coord, v_layer));\n"
+    "}";
+
+// Layers of the stress mode's texture array: the container, then
+// checkerboards of two colours each.
+static constexpr int texture_layers{4};
+static constexpr int texture_size{512};
+
+static std::vector<unsigned char> checkerboard(int layer) {
+  const glm::vec3 colors[]{{0.9f, 0.3f, 0.2f},
+                           {0.2f, 0.7f, 0.3f},
+                           {0.3f, 0.4f, 0.9f}};
+  auto color{colors[(layer - 1) % std::size(colors)]};
+  std::vector<unsigned char> pixels;
+  pixels.reserve(texture_size * texture_size * 3);
+  for (int y{0}; y < texture_size; ++y) {
+    for (int x{0}; x < texture_size; ++x) {
+      auto shade{(x / 64 + y / 64) % 2 ? 255.0f : 96.0f};
+      pixels.push_back(static_cast<unsigned char>(color.x * shade));
+      pixels.push_back(static_cast<unsigned char>(color.y * shade));
+      pixels.push_back(static_cast<unsigned char>(color.z * shade));
+    }
+  }
+  return pixels;
+}
+
 static const std::string fragment_shader_source =
     "#version 330 core\n"
     "uniform sampler2D u_texture0;\n"
@@ -61,149 +297,271 @@ static const std::string fragment_shader_source =
     "  FragColor = texture(u_texture0, v_tex_coord);\n"
     "}";
 
-int main() {
-  glfwSetErrorCallback([](int error_code, const char *description) {
-    std::cerr << "error_code: " << error_code << " description: " << description
-              << '\n';
-  });
-
-  if (!glfwInit()) {
-    std::cerr << "Failed to initialize glfw\n";
-    return 1;
+// The object of the stress mode: a vertex array with its element buffer
+// bound, the levels of detail in that buffer and a bounding sphere around
+// the mesh origin.
+struct StressMesh {
+  GLuint vertex_array{0};
+  std::vector<common::MeshLod> lods;
+  float radius{0.0f};
+};
+
+// A UV sphere of diameter 1 with the texture wrapped around it once, for
+// the stress mode when no --mesh is given.
+static common::Mesh sphere_mesh(int segments, int rings) {
+  constexpr auto pi{3.14159265f};
+  common::Mesh mesh;
+  for (int ring{0}; ring <= rings; ++ring) {
+    auto polar{pi * ring / rings};
+    for (int segment{0}; segment <= segments; ++segment) {
+      auto azimuth{2.0f * pi * segment / segments};
+      glm::vec3 normal{std::sin(polar) * std::cos(azimuth), std::cos(polar),
+                       std::sin(polar) * std::sin(azimuth)};
+      mesh.vertices.push_back(
+          {0.5f * normal, normal,
+           glm::vec2(float(segment) / segments, 1.0f - float(ring) / rings)});
+    }
+  }
+  auto row{static_cast<std::uint32_t>(segments + 1)};
+  for (std::uint32_t ring{0}; ring < static_cast<std::uint32_t>(rings);
+       ++ring) {
+    for (std::uint32_t segment{0};
+         segment < static_cast<std::uint32_t>(segments); ++segment) {
+      auto a{ring * row + segment}, b{a + row};
+      // The triangles at the poles would have no area.
+      if (ring > 0) {
+        mesh.indices.insert(mesh.indices.end(), {a, a + 1, b});
+      }
+      if (ring + 1 < static_cast<std::uint32_t>(rings)) {
+        mesh.indices.insert(mesh.indices.end(), {a + 1, b + 1, b});
+      }
+    }
   }
-  SCOPE_EXIT { glfwTerminate(); };
-
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-#ifdef __APPLE__
-  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
-
-  auto window{glfwCreateWindow(window_width, window_height,
-                               window_title.c_str(), nullptr, nullptr)};
-  if (!window) {
-    std::cerr << "Failed to create window\n";
+  return mesh;
+}
+
+// Draws context.instances() spinning, bobbing spheres, or copies of the
+// first mesh of a --mesh scene, in a grid. They are culled against the view
+// frustum through a BVH, and each visible one is drawn at the level of
+// detail its distance calls for, with one instanced draw call per level.
+// The objects use four textures, all layers of one array.
+static int run_stress_mode(common::Context &context, StressMesh mesh) {
+  auto &state{common::gl_state()};
+  auto shader_program{context.shader_cache().load(
+      instanced_vertex_shader_source, instanced_fragment_shader_source)};
+  if (!shader_program) {
     return 1;
   }
-  SCOPE_EXIT { glfwDestroyWindow(window); };
+  SCOPE_EXIT { glDeleteProgram(shader_program); };
 
-  glfwMakeContextCurrent(window);
+  common::ProgramReflection reflection{shader_program};
+  auto u_view_uniform{reflection.uniform<glm::mat4>("u_view")};
+  auto u_projection_uniform{reflection.uniform<glm::mat4>("u_projection")};
 
-  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-    std::cerr << "Failed to initialize OpenGL context\n";
-    return 1;
+  GLuint VAO;
+  glGenVertexArrays(1, &VAO);
+  SCOPE_EXIT { glDeleteVertexArrays(1, &VAO); };
+  GLuint buffers[2];
+  glGenBuffers(2, buffers);
+  SCOPE_EXIT { glDeleteBuffers(2, buffers); };
+  if (!mesh.vertex_array) {
+    // What MeshConverter would write for a sphere, made at startup as the
+    // repository has no mesh files.
+    auto sphere{sphere_mesh(32, 16)};
+    common::optimize_mesh(sphere);
+    common::generate_lods(sphere, 5);
+    state.bind_vertex_array(VAO);
+    state.bind_buffer(GL_ARRAY_BUFFER, buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER,
+                 sphere.vertices.size() * sizeof(common::MeshVertex),
+                 sphere.vertices.data(), GL_STATIC_DRAW);
+    common::set_mesh_vertex_attributes(buffers[0], 0, -1, 1);
+    state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 sphere.indices.size() * sizeof(std::uint32_t),
+                 sphere.indices.data(), GL_STATIC_DRAW);
+    mesh = {VAO, sphere.lods, 0.5f};
+  }
+
+  // A grid centred on the origin, seen from just outside one face so that
+  // only part of it is in view.
+  auto count{context.instances()};
+  auto side{static_cast<int>(std::ceil(std::cbrt(count)))};
+  constexpr auto bob_height{0.5f};
+  auto spacing{std::max(2.0f, 2.0f * mesh.radius + 1.0f)};
+  auto extent{side * spacing};
+  common::TransformStore transforms;
+  std::vector<glm::vec3> grid_positions;
+  for (int i{0}; i < count; ++i) {
+    grid_positions.push_back(
+        spacing * (glm::vec3(i % side, i / side % side, i / (side * side)) -
+                   glm::vec3((side - 1) / 2.0f)));
+    transforms.add(grid_positions.back(), glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+                   glm::vec3(1.0f));
   }
+  auto centers{grid_positions};
+  auto spin_axis{glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f))};
+  auto far_plane{std::max(100.0f, 2.0f * extent)};
+
+  // Bounds that hold the mesh in any orientation.
+  auto object_bounds{[&](const glm::vec3 &center) {
+    return common::Aabb{center - glm::vec3(mesh.radius),
+                        center + glm::vec3(mesh.radius)};
+  }};
+  std::vector<common::Aabb> bounds;
+  for (auto &position : grid_positions) {
+    bounds.push_back(object_bounds(position));
+  }
+  common::Bvh bvh;
+  bvh.build(bounds);
+  std::vector<std::uint32_t> visible;
+
+  common::TextureArray textures{texture_size, texture_size, texture_layers};
+  textures.load(context.texture_loader(), texture_path);
+  for (int layer{1}; layer < texture_layers; ++layer) {
+    textures.add(checkerboard(layer).data(), texture_size, texture_size, 3);
+  }
+  std::vector<std::uint32_t> layers;
+  for (int i{0}; i < count; ++i) {
+    layers.push_back(static_cast<std::uint32_t>(i % textures.size()));
+  }
+
+  common::InstancedRenderer renderer;
+  std::vector<common::DrawBatch> batches;
+  for (auto &lod : mesh.lods) {
+    batches.push_back({mesh.vertex_array,
+                       static_cast<GLsizei>(lod.index_count), shader_program,
+                       textures.texture(), GL_TEXTURE_2D_ARRAY,
+                       lod.first_index});
+  }
+  // The visible objects at each level.
+  std::vector<std::vector<std::uint32_t>> lod_objects(mesh.lods.size());
+  common::LodSelector lod_selector;
+  lod_selector.resize(count);
+
+  state.set_enabled(GL_DEPTH_TEST, true);
 
-  glfwSetFramebufferSizeCallback(window,
-                                 [](GLFWwindow *window, int width, int height) {
-                                   glViewport(0, 0, width, height);
-                                 });
+  CameraState initial_camera;
+  initial_camera.position = glm::vec3(0.0f, 0.0f, extent / 2.0f + spacing);
+  CameraSimulation simulation{initial_camera};
 
-  glfwSetKeyCallback(window, [](GLFWwindow *window, int key, int scancode,
-                                int action, int mods) {
-    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
-      glfwSetWindowShouldClose(window, GLFW_TRUE);
+  while (context.begin_frame()) {
+    probe_input(context);
+    auto camera{simulation.sample()};
+
+    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    state.use_program(shader_program);
+
+    auto u_view{glm::lookAt(camera.position, camera.position + camera.front,
+                            camera_up)};
+    u_view_uniform.set(u_view);
+
+    auto u_projection{glm::perspective(
+        glm::radians(camera.fov), (float)window_width / (float)window_height,
+        0.1f, far_plane)};
+    u_projection_uniform.set(u_projection);
+
+    auto &profiler{context.profiler()};
+    {
+      common::CpuZone zone{profiler, "animate"};
+      for (int i{0}; i < count; ++i) {
+        auto position{grid_positions[i] +
+                      glm::vec3(0.0f,
+                                bob_height * std::sin(camera.time + 0.7f * i),
+                                0.0f)};
+        centers[i] = position;
+        transforms.set_position(i, position);
+        transforms.set_rotation(
+            i, glm::angleAxis(camera.time + 0.1f * i, spin_axis));
+        bvh.update(i, object_bounds(position));
+      }
+      bvh.refit();
     }
-    if (key == GLFW_KEY_W && action == GLFW_PRESS) {
-      camera_pos += camera_speed * delta_time * camera_front;
+
+    {
+      common::CpuZone zone{profiler, "cull"};
+      visible.clear();
+      bvh.cull(common::Frustum{u_projection * u_view}, visible);
     }
-    if (key == GLFW_KEY_S && action == GLFW_PRESS) {
-      camera_pos -= camera_speed * delta_time * camera_front;
+    {
+      common::CpuZone zone{profiler, "lod"};
+      lod_selector.begin_frame(camera.position, glm::radians(camera.fov),
+                               window_height);
+      for (auto &objects : lod_objects) {
+        objects.clear();
+      }
+      for (auto i : visible) {
+        lod_objects[lod_selector.select(i, mesh.lods, centers[i],
+                                        mesh.radius)]
+            .push_back(i);
+      }
     }
-    if (key == GLFW_KEY_A && action == GLFW_PRESS) {
-      camera_pos -= camera_speed * delta_time *
-                    glm::normalize(glm::cross(camera_front, camera_up));
+    for (std::size_t level{0}; level < batches.size(); ++level) {
+      if (!lod_objects[level].empty()) {
+        renderer.add(batches[level], transforms, lod_objects[level], layers);
+      }
     }
-    if (key == GLFW_KEY_D && action == GLFW_PRESS) {
-      camera_pos += camera_speed * delta_time *
-                    glm::normalize(glm::cross(camera_front, camera_up));
+    context.add_counter("visible_objects", visible.size());
+    context.add_counter("triangles", lod_selector.triangles());
+    context.add_counter("full_detail_triangles",
+                        lod_selector.full_detail_triangles());
+    context.add_counter("lod_changes", lod_selector.changes());
+
+    {
+      common::CpuZone zone{profiler, "draw"};
+      common::GpuZone gpu_zone{profiler, "draw"};
+      context.add_draw_calls(renderer.flush());
     }
-  });
-
-  glfwSetCursorPosCallback(
-      window, [](GLFWwindow *window, double xposIn, double yposIn) {
-        float xpos = static_cast<float>(xposIn);
-        float ypos = static_cast<float>(yposIn);
-
-        if (firstMouse) {
-          lastX = xpos;
-          lastY = ypos;
-          firstMouse = false;
-        }
 
-        float xoffset = xpos - lastX;
-        float yoffset = lastY - ypos;
-        lastX = xpos;
-        lastY = ypos;
-
-        xoffset *= sensitivity;
-        yoffset *= sensitivity;
-
-        yaw += xoffset;
-        pitch += yoffset;
-
-        if (pitch > 89.0f)
-          pitch = 89.0f;
-        if (pitch < -89.0f)
-          pitch = -89.0f;
-
-        glm::vec3 front;
-        front.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
-        front.y = sin(glm::radians(pitch));
-        front.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
-        camera_front = glm::normalize(front);
-      });
-
-  glfwSetScrollCallback(window,
-                        [](GLFWwindow *window, double xoffset, double yoffset) {
-                          if (fov >= 1.0f && fov <= 45.0f)
-                            fov -= yoffset;
-                          if (fov <= 1.0f)
-                            fov = 1.0f;
-                          if (fov >= 45.0f)
-                            fov = 45.0f;
-                        });
-
-  GLint success;
-  constexpr GLsizei infobuffer_size{512};
-  GLchar infobuffer[infobuffer_size];
-
-  auto shader_program{glCreateProgram()};
-  SCOPE_EXIT { glDeleteProgram(shader_program); };
+    context.end_frame();
+    simulation.presented(context);
+  }
 
-  {
-    auto vertex_shader{glCreateShader(GL_VERTEX_SHADER)};
-    SCOPE_EXIT { glDeleteShader(vertex_shader); };
-    auto vertex_shader_code{vertex_shader_source.c_str()};
-    glShaderSource(vertex_shader, 1, &vertex_shader_code, nullptr);
-    glCompileShader(vertex_shader);
-    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-      glGetShaderInfoLog(vertex_shader, infobuffer_size, nullptr, infobuffer);
-      std::cerr << infobuffer << '\n';
-    }
+  return 0;
+}
 
-    auto fragment_shader{glCreateShader(GL_FRAGMENT_SHADER)};
-    SCOPE_EXIT { glDeleteShader(fragment_shader); };
-    auto fragment_shader_code{fragment_shader_source.c_str()};
-    glShaderSource(fragment_shader, 1, &fragment_shader_code, nullptr);
-    glCompileShader(fragment_shader);
-    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-      glGetShaderInfoLog(fragment_shader, infobuffer_size, nullptr, infobuffer);
-      std::cerr << infobuffer << '\n';
-    }
+int main(int argc, char **argv) {
+  auto context{common::Context::create(window_title, window_width,
+                                       window_height,
+                                       common::parse_options(argc, argv))};
+  if (!context) {
+    return 1;
+  }
+  auto &state{common::gl_state()};
+
+  if (auto window{context->window()}) {
+    glfwSetKeyCallback(window, [](GLFWwindow *window, int key, int scancode,
+                                  int action, int mods) {
+      if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
+        glfwSetWindowShouldClose(window, GLFW_TRUE);
+      }
+      push_input({InputEvent::Type::key, key, action});
+    });
+
+    glfwSetCursorPosCallback(
+        window, [](GLFWwindow *window, double xpos, double ypos) {
+          push_input({InputEvent::Type::cursor, 0, 0, xpos, ypos});
+        });
+
+    glfwSetScrollCallback(
+        window, [](GLFWwindow *window, double xoffset, double yoffset) {
+          push_input({InputEvent::Type::scroll, 0, 0, xoffset, yoffset});
+        });
+  }
 
-    glAttachShader(shader_program, vertex_shader);
-    glAttachShader(shader_program, fragment_shader);
-    glLinkProgram(shader_program);
-    glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
-    if (!success) {
-      glGetProgramInfoLog(shader_program, infobuffer_size, nullptr, infobuffer);
-      std::cerr << infobuffer << '\n';
-    }
+  auto shader_program{context->shader_cache().load(vertex_shader_source,
+                                                   fragment_shader_source)};
+  if (!shader_program) {
+    return 1;
   }
+  SCOPE_EXIT { glDeleteProgram(shader_program); };
+
+  common::ProgramReflection reflection{shader_program};
+  auto u_model_uniform{reflection.uniform<glm::mat4>("u_model")};
+  auto u_view_uniform{reflection.uniform<glm::mat4>("u_view")};
+  auto u_projection_uniform{reflection.uniform<glm::mat4>("u_projection")};
 
   float vertices[] = {
       0.5f,  0.5f,  0.0f, 1.0f, 1.0f, 0.5f,  -0.5f, 0.0f, 1.0f, 0.0f,
@@ -217,12 +575,12 @@ int main() {
   GLuint VAO;
   glGenVertexArrays(1, &VAO);
   SCOPE_EXIT { glDeleteVertexArrays(1, &VAO); };
-  glBindVertexArray(VAO);
+  state.bind_vertex_array(VAO);
 
   GLuint VBO;
   glGenBuffers(1, &VBO);
   SCOPE_EXIT { glDeleteBuffers(1, &VBO); };
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
+  state.bind_buffer(GL_ARRAY_BUFFER, VBO);
   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)0);
   glEnableVertexAttribArray(0);
@@ -233,74 +591,96 @@ int main() {
   GLuint EBO;
   glGenBuffers(1, &EBO);
   SCOPE_EXIT { glDeleteBuffers(1, &EBO); };
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+  state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
                GL_STATIC_DRAW);
 
-  GLuint u_texture0;
-  glGenTextures(1, &u_texture0);
+  // --mesh draws the chunks of a .gmesh scene in place of the quad.
+  GLuint mesh_VAO;
+  glGenVertexArrays(1, &mesh_VAO);
+  SCOPE_EXIT { glDeleteVertexArrays(1, &mesh_VAO); };
+  GLuint mesh_buffers[2];
+  glGenBuffers(2, mesh_buffers);
+  SCOPE_EXIT { glDeleteBuffers(2, mesh_buffers); };
+  std::vector<common::MeshFileChunk> mesh_chunks;
+  std::vector<common::MeshLod> mesh_lods;
+  if (!context->mesh_path().empty()) {
+    if (!common::upload_mesh_file(context->mesh_path(), mesh_buffers[0],
+                                  mesh_buffers[1], mesh_chunks, mesh_lods)) {
+      return 1;
+    }
+    state.bind_vertex_array(mesh_VAO);
+    common::set_mesh_vertex_attributes(mesh_buffers[0], 0, -1, 1);
+    state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, mesh_buffers[1]);
+    context->record_event("mesh_resident");
+  }
+
+  if (context->instances() > 0) {
+    StressMesh stress_mesh;
+    if (!mesh_chunks.empty()) {
+      auto &chunk{mesh_chunks.front()};
+      stress_mesh.vertex_array = mesh_VAO;
+      stress_mesh.lods.assign(
+          mesh_lods.begin() + chunk.first_lod,
+          mesh_lods.begin() + chunk.first_lod + chunk.lod_count);
+      stress_mesh.radius = glm::length(
+          glm::max(glm::abs(chunk.bounds_min), glm::abs(chunk.bounds_max)));
+    }
+    return run_stress_mode(*context, stress_mesh);
+  }
+
+  auto u_texture0{
+      context->texture_loader().load(context->texture_path(texture_path))};
   SCOPE_EXIT { glDeleteTextures(1, &u_texture0); };
-  glBindTexture(GL_TEXTURE_2D, u_texture0);
+  state.bind_texture(0, GL_TEXTURE_2D, u_texture0);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
                   GL_LINEAR_MIPMAP_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-  {
-    GLsizei image_width, image_height;
-    int image_channels;
-    stbi_set_flip_vertically_on_load(true);
-    auto image_data{stbi_load(texture_path.c_str(), &image_width, &image_height,
-                              &image_channels, 0)};
-    if (!image_data) {
-      std::cerr << "Failed to load image\n";
-      return 1;
-    }
-    SCOPE_EXIT { stbi_image_free(image_data); };
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, image_width, image_height, 0, GL_RGB,
-                 GL_UNSIGNED_BYTE, image_data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-  }
-
-  while (!glfwWindowShouldClose(window)) {
-    auto current_frame{static_cast<float>(glfwGetTime())};
-    delta_time = current_frame - last_frame;
-    last_frame = current_frame;
+  CameraSimulation simulation{CameraState{}};
 
+  while (context->begin_frame()) {
+    probe_input(*context);
+    auto camera{simulation.sample()};
 
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    glUseProgram(shader_program);
+    state.use_program(shader_program);
 
-    glBindVertexArray(VAO);
+    state.bind_vertex_array(mesh_chunks.empty() ? VAO : mesh_VAO);
 
     auto u_model{glm::mat4(1.0f)};
     u_model =
         glm::rotate(u_model, glm::radians(-55.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-    auto u_model_location{glGetUniformLocation(shader_program, "u_model")};
-    glUniformMatrix4fv(u_model_location, 1, GL_FALSE, glm::value_ptr(u_model));
+    u_model_uniform.set(u_model);
 
-    auto u_view{glm::lookAt(camera_pos, camera_pos + camera_front, camera_up)};
-    auto u_view_location{glGetUniformLocation(shader_program, "u_view")};
-    glUniformMatrix4fv(u_view_location, 1, GL_FALSE, glm::value_ptr(u_view));
+    auto u_view{glm::lookAt(camera.position, camera.position + camera.front,
+                            camera_up)};
+    u_view_uniform.set(u_view);
 
     auto u_projection{glm::perspective(
-        glm::radians(fov), (float)window_width / (float)window_height, 0.1f,
-        100.0f)};
-    auto u_projection_location{
-        glGetUniformLocation(shader_program, "u_projection")};
-    glUniformMatrix4fv(u_projection_location, 1, GL_FALSE,
-                       glm::value_ptr(u_projection));
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, u_texture0);
-
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        glm::radians(camera.fov), (float)window_width / (float)window_height,
+        0.1f, 100.0f)};
+    u_projection_uniform.set(u_projection);
+
+    state.bind_texture(0, GL_TEXTURE_2D, u_texture0);
+
+    if (mesh_chunks.empty()) {
+      glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+      context->add_draw_calls(1);
+    } else {
+      for (auto &chunk : mesh_chunks) {
+        glDrawElements(GL_TRIANGLES, chunk.index_count, GL_UNSIGNED_INT,
+                       (void *)(chunk.first_index * sizeof(std::uint32_t)));
+      }
+      context->add_draw_calls(mesh_chunks.size());
+    }
 
-    glfwSwapBuffers(window);
-    glfwPollEvents();
+    context->end_frame();
+    simulation.presented(*context);
   }
 
   return 0;
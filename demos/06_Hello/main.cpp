@@ -1,61 +1,46 @@
-#define GLFW_INCLUDE_NONE
-#include <GLFW/glfw3.h>
+#include <algorithm>
 #include <cmath>
-#include <glad/glad.h>
-#include <iostream>
+#include <common/context.hpp>
+#include <common/log.hpp>
+#include <common/morph.hpp>
+#include <common/reflection.hpp>
+#include <common/state_cache.hpp>
+#include <common/stream_buffer.hpp>
 #include <scope_guard.hpp>
 #include <string>
+#include <vector>
 
-static const std::string window_title{"HelloShader"};
+static const std::string window_title{"Hello"};
 static constexpr int window_width{800};
 static constexpr int window_height{600};
+static constexpr GLuint frame_block_binding{0};
 
+// Mirrors the std140 layout of the Frame uniform block.
+struct FrameBlock {
+  float u_time;
+  float padding[3];
+};
+
+// Every instance plays the same animation back and forth, offset in space
+// and in phase.
 static const std::string vertex_shader_source =
-    "#version 330 core\n"
-    "layout (location = 0) in vec3 a_position;\n"
+    std::string{"#version 330 core\n"} + common::morph_shader_source +
     "\n"
-    "uniform sampler1DArray framePosition;\n"
-    "uniform float u_t;\n"
+    "layout (location = 0) in vec3 a_instance;\n"
     "\n"
-    "out vec3 cc;\n"
-    "vec3 computePosition()\n"
+    "layout (std140) uniform Frame\n"
     "{\n"
-    "  int prevFrameId = int(floor(u_t / 1.0));\n"
-    "  int nextFrameId = prevFrameId;\n"
-    "  float dt = u_t - 1.0 * prevFrameId;\n"
-    "  vec3 prevPosition;\n"
-    "  if (prevFrameId < 1)\n"
-    "  {\n"
-    "    prevPosition = a_position;\n"
-    "  }\n" 
-    "  else if (prevFrameId < 2)\n"
-    "  {\n"
-    "    prevPosition = texture(framePosition, vec2(gl_VertexID / 4.0, floor(prevFrameId - 1))).rgb;\n"
-    "  }\n" 
-    "  else\n"
-    "  {\n"
-    "    prevPosition = texture(framePosition, vec2(gl_VertexID / 4.0, 1)).rgb;\n"
-    "  }\n" 
-    "  vec3 nextPosition;\n"
-    "  if (nextFrameId < 1)\n"
-    "  {\n"
-    "    nextPosition = a_position;\n"
-    "  }\n" 
-    "  else if (prevFrameId < 2)\n"
-    "  {\n"
-    "    nextPosition = texture(framePosition, vec2(gl_VertexID / 4.0, nextFrameId - 1)).rgb;\n"
-    "  }\n" 
-    "  else\n"
-    "  {\n"
-    "    nextPosition = texture(framePosition, vec2(gl_VertexID / 4.0, 1)).rgb;\n"
-    "  }\n" 
-    "  return mix(prevPosition, nextPosition, dt);\n"
-    "}\n"
+    "  float u_time;\n"
+    "};\n"
+    "uniform float u_scale;\n"
+    "\n"
+    "out vec3 cc;\n"
     "\n"
     "void main()\n"
     "{\n"
-    "  cc = computePosition();\n"
-    "  gl_Position = vec4(cc, 1.0);\n"
+    "  float t = (sin(u_time + a_instance.z) + 1.0) * 1.5;\n"
+    "  cc = morph_position(gl_VertexID, t);\n"
+    "  gl_Position = vec4(cc * u_scale + vec3(a_instance.xy, 0.0), 1.0);\n"
     "}";
 
 static const std::string fragment_shader_source =
@@ -69,98 +54,55 @@ static const std::string fragment_shader_source =
     "  FragColor = vec4(cc, 1.0);\n"
     "}";
 
-int main() {
-  glfwSetErrorCallback([](int error_code, const char *description) {
-    std::cerr << "error_code: " << error_code << " description: " << description
-              << '\n';
-  });
-
-  if (!glfwInit()) {
-    std::cerr << "Failed to initialize glfw\n";
-    return 1;
-  }
-  SCOPE_EXIT { glfwTerminate(); };
-
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-#ifdef __APPLE__
-  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
-
-  auto window{glfwCreateWindow(window_width, window_height,
-                               window_title.c_str(), nullptr, nullptr)};
-  if (!window) {
-    std::cerr << "Failed to create window\n";
+int main(int argc, char **argv) {
+  auto context{common::Context::create(window_title, window_width,
+                                       window_height,
+                                       common::parse_options(argc, argv))};
+  if (!context) {
     return 1;
   }
-  SCOPE_EXIT { glfwDestroyWindow(window); };
-
-  glfwMakeContextCurrent(window);
+  auto &state{common::gl_state()};
 
-  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-    std::cerr << "Failed to initialize OpenGL context\n";
+  auto shader_program{context->shader_cache().load(vertex_shader_source,
+                                                   fragment_shader_source)};
+  if (!shader_program) {
     return 1;
   }
-
-  glfwSetFramebufferSizeCallback(window,
-                                 [](GLFWwindow *window, int width, int height) {
-                                   glViewport(0, 0, width, height);
-                                 });
-
-  glfwSetKeyCallback(window, [](GLFWwindow *window, int key, int scancode,
-                                int action, int mods) {
-    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
-      glfwSetWindowShouldClose(window, GLFW_TRUE);
-    }
-  });
-
-  GLint success;
-  constexpr GLsizei infobuffer_size{512};
-  GLchar infobuffer[infobuffer_size];
-
-  auto shader_program{glCreateProgram()};
   SCOPE_EXIT { glDeleteProgram(shader_program); };
 
-  {
-    auto vertex_shader{glCreateShader(GL_VERTEX_SHADER)};
-    SCOPE_EXIT { glDeleteShader(vertex_shader); };
-    auto vertex_shader_code{vertex_shader_source.c_str()};
-    glShaderSource(vertex_shader, 1, &vertex_shader_code, nullptr);
-    glCompileShader(vertex_shader);
-    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-      glGetShaderInfoLog(vertex_shader, infobuffer_size, nullptr, infobuffer);
-      std::cerr << infobuffer << '\n';
-    }
-
-    auto fragment_shader{glCreateShader(GL_FRAGMENT_SHADER)};
-    SCOPE_EXIT { glDeleteShader(fragment_shader); };
-    auto fragment_shader_code{fragment_shader_source.c_str()};
-    glShaderSource(fragment_shader, 1, &fragment_shader_code, nullptr);
-    glCompileShader(fragment_shader);
-    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-      glGetShaderInfoLog(fragment_shader, infobuffer_size, nullptr, infobuffer);
-      std::cerr << infobuffer << '\n';
-    }
-
-    glAttachShader(shader_program, vertex_shader);
-    glAttachShader(shader_program, fragment_shader);
-    glLinkProgram(shader_program);
-    glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
-    if (!success) {
-      glGetProgramInfoLog(shader_program, infobuffer_size, nullptr, infobuffer);
-      std::cerr << infobuffer << '\n';
-    }
+  // Keyframe 0 is the rest pose; the shader's t runs from 0 to 3 and holds
+  // the last keyframe for its final second.
+  const glm::vec3 keyframes[] = {
+      {0.9f, 0.9f, 0.0f},   {0.9f, -0.9f, 0.0f},
+      {-0.9f, -0.9f, 0.0f}, {-0.9f, 0.9f, 0.0f},
+      {0.5f, 0.5f, 0.0f},   {0.5f, -0.5f, 0.0f},
+      {-0.5f, -0.5f, 0.0f}, {-0.5f, 0.5f, 0.0f},
+      {0.1f, 0.1f, 0.0f},   {0.1f, -0.1f, 0.0f},
+      {-0.1f, -0.1f, 0.0f}, {-0.1f, 0.1f, 0.0f},
+  };
+  common::MorphAnimation animation{keyframes, 4, 3, 1.0f, false};
+
+  // With --instances, a grid of quads that play the animation with staggered
+  // phases; otherwise one full-size quad.
+  auto instance_count{std::max(1, context->instances())};
+  auto side{static_cast<int>(std::ceil(std::sqrt(instance_count)))};
+  std::vector<glm::vec3> instances;
+  for (int i{0}; i < instance_count; ++i) {
+    instances.emplace_back(
+        side == 1 ? 0.0f : -1.0f + (2.0f * (i % side) + 1.0f) / side,
+        side == 1 ? 0.0f : -1.0f + (2.0f * (i / side) + 1.0f) / side,
+        6.2831853f * i / instance_count);
   }
 
-  float vertices[] = {
-      0.9f,  0.9f,  0.0f, 
-      0.9f,  -0.9f, 0.0f,
-      -0.9f, -0.9f, 0.0f, 
-      -0.9f, 0.9f,  0.0f,
-  };
+  state.use_program(shader_program);
+  common::ProgramReflection reflection{shader_program};
+  reflection.bind_uniform_block("Frame", frame_block_binding);
+  reflection.uniform<float>("u_scale").set(1.0f / side);
+  animation.configure(reflection, 0);
+
+  GLint uniform_buffer_alignment{0};
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform_buffer_alignment);
+  common::StreamBuffer uniform_stream{GL_UNIFORM_BUFFER, 64 * 1024};
 
   unsigned int indices[] = {
       0, 1, 3, 1, 2, 3,
@@ -169,68 +111,61 @@ int main() {
   GLuint VAO;
   glGenVertexArrays(1, &VAO);
   SCOPE_EXIT { glDeleteVertexArrays(1, &VAO); };
-  glBindVertexArray(VAO);
+  state.bind_vertex_array(VAO);
 
   GLuint VBO;
   glGenBuffers(1, &VBO);
   SCOPE_EXIT { glDeleteBuffers(1, &VBO); };
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float),
-                        (void *)(0 * sizeof(float)));
+  state.bind_buffer(GL_ARRAY_BUFFER, VBO);
+  glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(glm::vec3),
+               instances.data(), GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3),
+                        (void *)0);
   glEnableVertexAttribArray(0);
+  glVertexAttribDivisor(0, 1);
 
   GLuint EBO;
   glGenBuffers(1, &EBO);
   SCOPE_EXIT { glDeleteBuffers(1, &EBO); };
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+  state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
                GL_STATIC_DRAW);
 
-  GLuint u_texture0;
-  glGenTextures(1, &u_texture0);
-  SCOPE_EXIT { glDeleteTextures(1, &u_texture0); };
-  glBindTexture(GL_TEXTURE_1D_ARRAY, u_texture0);
-  glTexParameteri(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  float texels[24] = 
-  {
-     // Texels for first image.
-      0.5f,  0.5f,  0.0f, 
-      0.5f,  -0.5f, 0.0f,
-      -0.5f, -0.5f, 0.0f, 
-      -0.5f, 0.5f,  0.0f,
-     // Texels for second image.
-      0.1f,  0.1f,  0.0f, 
-      0.1f,  -0.1f, 0.0f,
-      -0.1f, -0.1f, 0.0f, 
-      -0.1f, 0.1f,  0.0f,
-  };
-  glTexImage2D(GL_TEXTURE_1D_ARRAY, 0, GL_RGB, 4, 2, 0, GL_RGB, GL_FLOAT, texels);
-
-  while (!glfwWindowShouldClose(window)) {
+  // Once a second is plenty to follow the animation clock.
+  common::LogRateLimit time_log{std::chrono::seconds{1}};
+  while (context->begin_frame()) {
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    glUseProgram(shader_program);
+    state.use_program(shader_program);
 
-    glBindVertexArray(VAO);
+    state.bind_vertex_array(VAO);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_1D_ARRAY, u_texture0);
+    animation.bind(0);
 
-    auto time_value{glfwGetTime()};
-    auto t_value{static_cast<float>((std::sin(time_value) + 1.0) * 1.5)};
-    std::cout << "t_value: " << t_value << '\n';
-    auto t_location{glGetUniformLocation(shader_program, "u_t")};
-    glUniform1f(t_location, t_value);
+    auto time_value{static_cast<float>(context->time())};
+    time_log.log(common::LogLevel::info, "time_value: {}", time_value);
 
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    uniform_stream.begin_frame();
+    auto frame_block{uniform_stream.allocate(
+        sizeof(FrameBlock), std::max(uniform_buffer_alignment, 16))};
+    if (frame_block.data) {
+      *static_cast<FrameBlock *>(frame_block.data) = {time_value};
+      uniform_stream.commit(frame_block);
+      state.bind_buffer_range(GL_UNIFORM_BUFFER, frame_block_binding,
+                             frame_block.buffer, frame_block.offset,
+                             frame_block.size);
+    }
+
+    {
+      common::GpuZone zone{context->profiler(), "draw"};
+      glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0,
+                              instance_count);
+    }
+    context->add_draw_calls(1);
+    uniform_stream.end_frame();
 
-    glfwSwapBuffers(window);
-    glfwPollEvents();
+    context->end_frame();
   }
 
   return 0;
@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <chrono>
+#include <common/context.hpp>
+#include <common/mipmap.hpp>
+#include <common/state_cache.hpp>
+#include <fstream>
+#include <iostream>
+#include <scope_guard.hpp>
+#include <stb_image.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Times common::build_mipmaps against glGenerateMipmap for one image and
+// writes the median of each variant as JSON.
+//
+// usage: MipmapBenchmark [--headless] [--frames <runs>] [--benchmark <path>]
+//                        [--texture <image>]
+
+static const std::string default_texture_path{
+    "resources/textures/container.jpg"};
+static constexpr int default_runs{20};
+
+template <class F> static double median_ms(int runs, F &&body) {
+  std::vector<double> samples;
+  for (int i{0}; i < runs; ++i) {
+    auto start{std::chrono::steady_clock::now()};
+    body();
+    samples.push_back(std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - start)
+                          .count());
+  }
+  std::nth_element(samples.begin(), samples.begin() + samples.size() / 2,
+                   samples.end());
+  return samples[samples.size() / 2];
+}
+
+int main(int argc, char **argv) {
+  auto options{common::parse_options(argc, argv)};
+  auto runs{options.frames > 0 ? options.frames : default_runs};
+  auto output_path{options.benchmark_path.empty() ? std::string{"-"}
+                                                  : options.benchmark_path};
+  // The context only provides GL; this tool reports on its own.
+  options.frames = 0;
+  options.benchmark_path.clear();
+  auto context{common::Context::create("MipmapBenchmark", 64, 64, options)};
+  if (!context) {
+    return 1;
+  }
+
+  auto path{context->texture_path(default_texture_path)};
+  int width, height, channels;
+  auto pixels{stbi_load(path.c_str(), &width, &height, &channels, 0)};
+  if (!pixels) {
+    std::cerr << "Failed to load image " << path << ": "
+              << stbi_failure_reason() << '\n';
+    return 1;
+  }
+  SCOPE_EXIT { stbi_image_free(pixels); };
+
+  const GLenum formats[]{GL_RED, GL_RG, GL_RGB, GL_RGBA};
+  const GLenum internal_formats[]{GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+  auto format{formats[channels - 1]};
+  auto internal_format{internal_formats[channels - 1]};
+
+  GLuint texture;
+  glGenTextures(1, &texture);
+  SCOPE_EXIT { glDeleteTextures(1, &texture); };
+  common::gl_state().bind_texture(0, GL_TEXTURE_2D, texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  auto threads{std::max(1u, std::thread::hardware_concurrency())};
+  std::vector<std::pair<std::string, double>> results;
+  auto cpu{[&](const std::string &name, common::MipmapOptions mipmap_options) {
+    results.emplace_back(name, median_ms(runs, [&] {
+                           common::build_mipmaps(pixels, width, height,
+                                                 channels, mipmap_options);
+                         }));
+  }};
+  cpu("box", {common::MipmapFilter::box, true, 1});
+  cpu("box_linear", {common::MipmapFilter::box, false, 1});
+  cpu("box_threaded", {common::MipmapFilter::box, true, threads});
+  cpu("kaiser", {common::MipmapFilter::kaiser, true, 1});
+  cpu("kaiser_threaded", {common::MipmapFilter::kaiser, true, threads});
+
+  // What the runtime pays per texture on the GL thread: uploading prebuilt
+  // levels, against uploading level 0 and letting the driver filter.
+  auto levels{common::build_mipmaps(pixels, width, height, channels, {})};
+  results.emplace_back("upload_levels", median_ms(runs, [&] {
+                         glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width,
+                                      height, 0, format, GL_UNSIGNED_BYTE,
+                                      pixels);
+                         for (std::size_t i{0}; i < levels.size(); ++i) {
+                           glTexImage2D(GL_TEXTURE_2D,
+                                        static_cast<GLint>(i + 1),
+                                        internal_format, levels[i].width,
+                                        levels[i].height, 0, format,
+                                        GL_UNSIGNED_BYTE,
+                                        levels[i].pixels.data());
+                         }
+                         glFinish();
+                       }));
+  results.emplace_back("upload_generate_mipmap", median_ms(runs, [&] {
+                         glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width,
+                                      height, 0, format, GL_UNSIGNED_BYTE,
+                                      pixels);
+                         glGenerateMipmap(GL_TEXTURE_2D);
+                         glFinish();
+                       }));
+
+  std::ofstream file;
+  if (output_path != "-") {
+    file.open(output_path);
+    if (!file) {
+      std::cerr << "Failed to open " << output_path << '\n';
+      return 1;
+    }
+  }
+  auto &os{output_path == "-" ? std::cout : file};
+  os << "{\n";
+  os << "  \"name\": \"MipmapBenchmark\",\n";
+  os << "  \"image\": \"" << path << "\",\n";
+  os << "  \"width\": " << width << ",\n";
+  os << "  \"height\": " << height << ",\n";
+  os << "  \"channels\": " << channels << ",\n";
+  os << "  \"runs\": " << runs << ",\n";
+  os << "  \"threads\": " << threads << ",\n";
+  os << "  \"median_ms\": {";
+  for (std::size_t i{0}; i < results.size(); ++i) {
+    os << (i ? ", " : "") << '"' << results[i].first
+       << "\": " << results[i].second;
+  }
+  os << "}\n";
+  os << "}\n";
+  return 0;
+}
@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <common/image.hpp>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Checks a regression run, a directory with a <name>.ppm capture and a
+// <name>.json benchmark report per demo run:
+// - every capture must match <golden dir>/<name>.ppm, apart from at most a
+//   fraction of pixels that differ by more than a tolerance per channel, or
+//   without that image hash to the digest in <golden dir>/<name>.digest;
+// - the median CPU and GPU frame times of every report must not exceed the
+//   median of the last runs recorded in the history file by more than a
+//   fraction of it.
+// A capture with neither fails. Digests only match the exact pixels, such as
+// those of llvmpipe on a fixed clock, while golden images allow for other
+// renderers. The run's timings are appended to the history only when every
+// check passes, so that a slow run does not become the baseline of the next.
+// --update accepts the run instead: it replaces the golden images and
+// digests and records the timings without checking either. Exits with 1
+// when any check fails.
+//
+// usage: RegressionCheck <run dir> <golden dir> <history file>
+//                        [--tolerance <0-255>] [--max-mismatch <fraction>]
+//                        [--threshold <fraction>] [--update]
+
+namespace fs = std::filesystem;
+
+// Runs in the history that a report is compared with.
+static constexpr std::size_t history_window{5};
+// Slowdowns below this are noise, whatever the fraction.
+static constexpr double min_regression_ms{0.25};
+
+// 64-bit FNV-1a of the size and pixels of `image`, in hex.
+static std::string image_digest(const common::Image &image) {
+  std::uint64_t hash{0xcbf29ce484222325};
+  auto add{[&](unsigned char byte) {
+    hash = (hash ^ byte) * 0x100000001b3;
+  }};
+  for (auto value : {image.width, image.height}) {
+    for (int shift{0}; shift < 32; shift += 8) {
+      add(static_cast<unsigned char>(value >> shift));
+    }
+  }
+  for (auto byte : image.pixels) {
+    add(byte);
+  }
+  std::stringstream digest;
+  digest << std::hex << std::setw(16) << std::setfill('0') << hash;
+  return digest.str();
+}
+
+struct Timings {
+  double cpu_ms;
+  double gpu_ms;
+};
+
+// The "median" of a summary such as "cpu_frame_ms" in a benchmark report,
+// or -1 when the report has none.
+static double summary_median(const std::string &json, const std::string &key) {
+  auto summary{json.find('"' + key + '"')};
+  if (summary == std::string::npos) {
+    return -1.0;
+  }
+  auto median{json.find("\"median\":", summary)};
+  if (median == std::string::npos) {
+    return -1.0;
+  }
+  return std::strtod(json.c_str() + median + std::strlen("\"median\":"),
+                     nullptr);
+}
+
+static std::vector<fs::path> run_files(const fs::path &directory,
+                                       const std::string &extension) {
+  std::vector<fs::path> paths;
+  for (auto &entry : fs::directory_iterator{directory}) {
+    if (entry.path().extension() == extension) {
+      paths.push_back(entry.path());
+    }
+  }
+  std::sort(paths.begin(), paths.end());
+  return paths;
+}
+
+static double median(std::vector<double> values) {
+  std::nth_element(values.begin(), values.begin() + values.size() / 2,
+                   values.end());
+  return values[values.size() / 2];
+}
+
+// Whether `current` is slower than the recent `history` by more than
+// `threshold`. Prints the comparison.
+static bool regressed(const char *what, double current,
+                      const std::vector<double> &history, double threshold) {
+  std::cout << "  " << what << ' ' << current << " ms";
+  if (current < 0.0 || history.empty()) {
+    std::cout << '\n';
+    return false;
+  }
+  auto baseline{median(history)};
+  auto slower{current > baseline * (1.0 + threshold) &&
+              current - baseline > min_regression_ms};
+  std::cout << ", baseline " << baseline << " ms"
+            << (slower ? "  REGRESSED" : "") << '\n';
+  return slower;
+}
+
+int main(int argc, char **argv) {
+  std::vector<std::string> positional;
+  auto tolerance{2};
+  auto max_mismatch{0.001};
+  auto threshold{0.25};
+  auto update{false};
+  for (int i{1}; i < argc; ++i) {
+    auto has_value{i + 1 < argc};
+    if (std::strcmp(argv[i], "--tolerance") == 0 && has_value) {
+      tolerance = std::atoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--max-mismatch") == 0 && has_value) {
+      max_mismatch = std::atof(argv[++i]);
+    } else if (std::strcmp(argv[i], "--threshold") == 0 && has_value) {
+      threshold = std::atof(argv[++i]);
+    } else if (std::strcmp(argv[i], "--update") == 0) {
+      update = true;
+    } else {
+      positional.push_back(argv[i]);
+    }
+  }
+  if (positional.size() != 3) {
+    std::cerr << "usage: RegressionCheck <run dir> <golden dir> "
+                 "<history file> [--tolerance <0-255>] [--max-mismatch "
+                 "<fraction>] [--threshold <fraction>] [--update]\n";
+    return 1;
+  }
+  fs::path run_directory{positional[0]};
+  fs::path golden_directory{positional[1]};
+  fs::path history_path{positional[2]};
+  std::error_code error;
+  if (!fs::is_directory(run_directory, error)) {
+    std::cerr << "No regression run in " << run_directory << '\n';
+    return 1;
+  }
+
+  auto failures{0};
+  std::cout << std::fixed << std::setprecision(3);
+
+  if (update) {
+    fs::create_directories(golden_directory, error);
+  }
+  for (auto &capture : run_files(run_directory, ".ppm")) {
+    auto golden_path{golden_directory / capture.filename()};
+    auto digest_path{golden_directory / capture.stem()};
+    digest_path += ".digest";
+    std::cout << capture.stem().string() << ": ";
+    common::Image image, golden;
+    if (!common::read_ppm(capture.string(), image)) {
+      std::cout << "unreadable\n";
+      ++failures;
+      continue;
+    }
+    auto digest{image_digest(image)};
+    if (update) {
+      std::ofstream digest_file{digest_path, std::ios::trunc};
+      if (!fs::copy_file(capture, golden_path,
+                         fs::copy_options::overwrite_existing, error) ||
+          !(digest_file << digest << '\n')) {
+        std::cout << "failed to update " << golden_path << '\n';
+        ++failures;
+        continue;
+      }
+      std::cout << "recorded, digest " << digest << '\n';
+      continue;
+    }
+    if (!fs::exists(golden_path)) {
+      std::string golden_digest;
+      if (!(std::ifstream{digest_path} >> golden_digest)) {
+        std::cout << "no golden image or digest, run with --update to "
+                     "record them  MISMATCH\n";
+        ++failures;
+        continue;
+      }
+      auto matches{digest == golden_digest};
+      std::cout << "digest " << digest
+                << (matches ? "" : ", expected " + golden_digest + "  MISMATCH")
+                << '\n';
+      failures += !matches;
+      continue;
+    }
+    if (!common::read_ppm(golden_path.string(), golden)) {
+      std::cout << "unreadable golden image\n";
+      ++failures;
+      continue;
+    }
+    auto difference{common::compare_images(image, golden, tolerance)};
+    auto allowed{static_cast<std::size_t>(max_mismatch * golden.width *
+                                          golden.height)};
+    auto matches{difference.mismatched_pixels <= allowed};
+    std::cout << difference.mismatched_pixels << " pixels differ by more than "
+              << tolerance << ", at most " << difference.max_difference
+              << (matches ? "" : "  MISMATCH") << '\n';
+    failures += !matches;
+  }
+
+  // Earlier runs, one line per report: name, CPU and GPU median in ms.
+  std::map<std::string, std::vector<Timings>> history;
+  {
+    std::ifstream file{history_path};
+    std::string name;
+    Timings timings;
+    while (file >> name >> timings.cpu_ms >> timings.gpu_ms) {
+      history[name].push_back(timings);
+    }
+  }
+
+  std::stringstream run_history;
+  for (auto &report : run_files(run_directory, ".json")) {
+    std::ifstream file{report};
+    std::stringstream json;
+    json << file.rdbuf();
+    auto name{report.stem().string()};
+    Timings timings{summary_median(json.str(), "cpu_frame_ms"),
+                    summary_median(json.str(), "gpu_frame_ms")};
+
+    std::vector<double> cpu_history, gpu_history;
+    auto &runs{history[name]};
+    for (auto i{runs.size() - std::min(runs.size(), history_window)};
+         i < runs.size(); ++i) {
+      cpu_history.push_back(runs[i].cpu_ms);
+      if (runs[i].gpu_ms >= 0.0) {
+        gpu_history.push_back(runs[i].gpu_ms);
+      }
+    }
+    std::cout << name << ":\n";
+    auto slower{regressed("cpu median", timings.cpu_ms, cpu_history,
+                          threshold) |
+                regressed("gpu median", timings.gpu_ms, gpu_history,
+                          threshold)};
+    if (!update) {
+      failures += slower;
+    }
+    run_history << name << ' ' << timings.cpu_ms << ' ' << timings.gpu_ms
+                << '\n';
+  }
+
+  if (failures == 0 || update) {
+    std::ofstream history_file{history_path, std::ios::app};
+    if (!(history_file << run_history.str())) {
+      std::cerr << "Failed to update " << history_path << '\n';
+      return 1;
+    }
+  }
+
+  if (failures > 0) {
+    std::cout << failures << " regression check(s) failed\n";
+    return 1;
+  }
+  return 0;
+}
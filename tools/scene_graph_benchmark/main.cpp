@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <common/context.hpp>
+#include <common/scene_graph.hpp>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Moves 1% of the nodes of a deep and of a wide hierarchy every frame and
+// times bringing the world matrices up to date: rebuilt from scratch, and
+// with SceneGraph::update() on one and on all threads. Writes the medians as
+// JSON.
+//
+// usage: SceneGraphBenchmark [--frames <runs>] [--benchmark <path>]
+
+static constexpr int default_runs{100};
+static constexpr double moved_fraction{0.01};
+
+struct Hierarchy {
+  const char *name;
+  // Children per node on each level below the root.
+  std::vector<std::size_t> fan_out;
+};
+
+// 64 chains of 1024 nodes, and 256 groups of 256 leaves, both under one
+// root.
+static const Hierarchy hierarchies[]{
+    {"deep", [] {
+       std::vector<std::size_t> fan_out{64};
+       fan_out.resize(1024, 1);
+       return fan_out;
+     }()},
+    {"wide", {256, 256}},
+};
+
+static glm::mat4 local_transform(std::mt19937 &random) {
+  std::uniform_real_distribution<float> unit{-1.0f, 1.0f};
+  auto local{glm::translate(glm::mat4(1.0f), glm::vec3(unit(random),
+                                                        unit(random),
+                                                        unit(random)))};
+  return glm::rotate(local, unit(random) * 0.1f, glm::vec3(0.0f, 0.0f, 1.0f));
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+static double median(std::vector<double> values) {
+  std::nth_element(values.begin(), values.begin() + values.size() / 2,
+                   values.end());
+  return values[values.size() / 2];
+}
+
+int main(int argc, char **argv) {
+  auto options{common::parse_options(argc, argv)};
+  auto runs{options.frames > 0 ? options.frames : default_runs};
+  auto threads{std::max(1u, std::thread::hardware_concurrency())};
+
+  std::ofstream file;
+  if (!options.benchmark_path.empty() && options.benchmark_path != "-") {
+    file.open(options.benchmark_path);
+    if (!file) {
+      std::cerr << "Failed to open " << options.benchmark_path << '\n';
+      return 1;
+    }
+  }
+  auto &os{file.is_open() ? file : std::cout};
+
+  os << "{\n";
+  os << "  \"name\": \"SceneGraphBenchmark\",\n";
+  os << "  \"runs\": " << runs << ",\n";
+  os << "  \"threads\": " << threads << ",\n";
+  os << "  \"median_ms\": {";
+  for (std::size_t h{0}; h < std::size(hierarchies); ++h) {
+    auto &hierarchy{hierarchies[h]};
+    std::mt19937 random{42};
+    common::SceneGraph graph;
+    std::vector<std::uint32_t> level{graph.add(common::SceneGraph::no_parent)};
+    for (auto fan_out : hierarchy.fan_out) {
+      std::vector<std::uint32_t> next;
+      for (auto parent : level) {
+        for (std::size_t i{0}; i < fan_out; ++i) {
+          next.push_back(graph.add(parent, local_transform(random)));
+        }
+      }
+      level.swap(next);
+    }
+    auto count{graph.size()};
+    graph.update();
+
+    // The same moves for every method.
+    auto moves_per_frame{static_cast<std::size_t>(count * moved_fraction)};
+    std::uniform_int_distribution<std::uint32_t> any_node(
+        0, static_cast<std::uint32_t>(count - 1));
+    std::vector<std::uint32_t> moved;
+    std::vector<glm::mat4> moved_locals;
+    for (std::size_t i{0}; i < moves_per_frame * runs; ++i) {
+      moved.push_back(any_node(random));
+      moved_locals.push_back(local_transform(random));
+    }
+    auto move{[&](int run, auto &&set_local) {
+      for (auto i{run * moves_per_frame}; i < (run + 1) * moves_per_frame;
+           ++i) {
+        set_local(moved[i], moved_locals[i]);
+      }
+    }};
+
+    // What the demos do: every world matrix from its local matrix and its
+    // parent's, every frame.
+    std::vector<glm::mat4> locals(count), worlds(count);
+    for (std::uint32_t node{0}; node < count; ++node) {
+      locals[node] = graph.local(node);
+    }
+    std::vector<double> full_ms;
+    for (int run{0}; run < runs; ++run) {
+      move(run, [&](std::uint32_t node, const glm::mat4 &local) {
+        locals[node] = local;
+      });
+      auto start{std::chrono::steady_clock::now()};
+      for (std::uint32_t node{0}; node < count; ++node) {
+        auto parent{graph.parent(node)};
+        worlds[node] = parent != common::SceneGraph::no_parent
+                           ? worlds[parent] * locals[node]
+                           : locals[node];
+      }
+      full_ms.push_back(elapsed_ms(start));
+    }
+
+    // Both incremental methods start from the same graph.
+    auto incremental{[&](common::SceneGraph copy, unsigned thread_count,
+                         std::size_t &updated, float &error) {
+      std::vector<double> samples;
+      updated = 0;
+      for (int run{0}; run < runs; ++run) {
+        move(run, [&](std::uint32_t node, const glm::mat4 &local) {
+          copy.set_local(node, local);
+        });
+        auto start{std::chrono::steady_clock::now()};
+        updated += copy.update(thread_count);
+        samples.push_back(elapsed_ms(start));
+      }
+      updated /= runs;
+      error = 0.0f;
+      for (std::uint32_t node{0}; node < count; ++node) {
+        for (int c{0}; c < 4; ++c) {
+          for (int r{0}; r < 4; ++r) {
+            error = std::max(
+                error, std::abs(copy.world(node)[c][r] - worlds[node][c][r]));
+          }
+        }
+      }
+      return median(samples);
+    }};
+    std::size_t serial_updated, threaded_updated;
+    float serial_error, threaded_error;
+    auto serial_ms{incremental(graph, 1, serial_updated, serial_error)};
+    auto threaded_ms{
+        incremental(graph, threads, threaded_updated, threaded_error)};
+
+    os << (h ? "," : "") << "\n    \"" << hierarchy.name
+       << "\": {\"nodes\": " << count
+       << ", \"moved_per_frame\": " << moves_per_frame
+       << ", \"updated_per_frame\": " << serial_updated
+       << ", \"full\": " << median(full_ms)
+       << ", \"incremental\": " << serial_ms
+       << ", \"incremental_threaded\": " << threaded_ms
+       << ", \"max_error\": " << std::max(serial_error, threaded_error) << "}";
+  }
+  os << "\n  }\n";
+  os << "}\n";
+  return 0;
+}
@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <common/context.hpp>
+#include <common/shader.hpp>
+#include <common/state_cache.hpp>
+#include <fstream>
+#include <iostream>
+#include <scope_guard.hpp>
+#include <string>
+#include <vector>
+
+// Builds a few hundred distinct programs twice, first one after the other
+// with compile_program, then all at once through a ShaderBuildQueue while
+// rendering frames with the programs that are ready, and writes the times
+// as JSON. Every run uses sources no earlier run has seen, so driver-side
+// shader caches do not hide the compile times.
+//
+// usage: ShaderBenchmark [--headless] [--instances <programs>]
+//                        [--benchmark <path>]
+
+static constexpr int default_programs{200};
+static constexpr int window_size{256};
+
+static const std::string vertex_shader_source =
+    "#version 330 core\n"
+    "uniform vec4 u_cell;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "  vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+    "  gl_Position = vec4(mix(u_cell.xy, u_cell.zw, corner), 0.0, 1.0);\n"
+    "}";
+
+static std::string fragment_shader_source(long long run, int variant) {
+  return "#version 330 core\n"
+         "// run " +
+         std::to_string(run) +
+         "\n"
+         "out vec4 FragColor;\n"
+         "\n"
+         "void main()\n"
+         "{\n"
+         "  vec3 phase = vec3(" +
+         std::to_string(variant) +
+         ".0) + gl_FragCoord.xyz * 0.01;\n"
+         "  FragColor = vec4(sin(phase) * 0.5 + 0.5, 1.0);\n"
+         "}";
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+int main(int argc, char **argv) {
+  auto options{common::parse_options(argc, argv)};
+  auto program_count{options.instances > 0 ? options.instances
+                                           : default_programs};
+  auto output_path{options.benchmark_path.empty() ? std::string{"-"}
+                                                  : options.benchmark_path};
+  // The context only provides GL; this tool reports on its own.
+  options.frames = 0;
+  options.benchmark_path.clear();
+  auto context{common::Context::create("ShaderBenchmark", window_size,
+                                       window_size, options)};
+  if (!context) {
+    return 1;
+  }
+  auto &state{common::gl_state()};
+
+  auto run{std::chrono::system_clock::now().time_since_epoch().count()};
+  std::vector<GLuint> programs;
+  SCOPE_EXIT {
+    for (auto program : programs) {
+      glDeleteProgram(program);
+    }
+  };
+
+  // Draws every program into a cell of a grid. Drivers such as llvmpipe
+  // finish compiling at the first draw, so both builds count until then.
+  GLuint VAO;
+  glGenVertexArrays(1, &VAO);
+  SCOPE_EXIT { glDeleteVertexArrays(1, &VAO); };
+  state.bind_vertex_array(VAO);
+  auto side{static_cast<int>(std::ceil(std::sqrt(program_count)))};
+  auto cell_size{2.0f / side};
+  auto draw_cell{[&](GLuint program, int cell) {
+    state.use_program(program);
+    auto x{-1.0f + cell % side * cell_size};
+    auto y{-1.0f + cell / side * cell_size};
+    glUniform4f(glGetUniformLocation(program, "u_cell"), x, y, x + cell_size,
+                y + cell_size);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  }};
+
+  auto serial_start{std::chrono::steady_clock::now()};
+  for (int i{0}; i < program_count; ++i) {
+    programs.push_back(common::compile_program(
+        vertex_shader_source, fragment_shader_source(run, i)));
+    if (programs.back()) {
+      draw_cell(programs.back(), i);
+    }
+  }
+  glFinish();
+  auto serial_ms{elapsed_ms(serial_start)};
+
+  auto queued_start{std::chrono::steady_clock::now()};
+  common::ShaderBuildQueue queue;
+  std::vector<std::size_t> builds;
+  for (int i{0}; i < program_count; ++i) {
+    builds.push_back(queue.submit(vertex_shader_source,
+                                  fragment_shader_source(run + 1, i)));
+  }
+  auto submit_ms{elapsed_ms(queued_start)};
+  auto first_ready_ms{-1.0};
+  auto frames{0};
+  std::vector<bool> drawn(program_count, false);
+  for (auto pending{queue.poll()};; pending = queue.poll()) {
+    // The frame: each program that became ready since the last one draws
+    // its cell.
+    for (int i{0}; i < program_count; ++i) {
+      auto program{queue.program(builds[i])};
+      if (!program || drawn[i]) {
+        continue;
+      }
+      if (first_ready_ms < 0.0) {
+        first_ready_ms = elapsed_ms(queued_start);
+      }
+      draw_cell(program, i);
+      drawn[i] = true;
+    }
+    glFlush();
+    ++frames;
+    if (pending == 0) {
+      break;
+    }
+  }
+  glFinish();
+  auto queued_ms{elapsed_ms(queued_start)};
+  for (auto build : builds) {
+    programs.push_back(queue.program(build));
+  }
+  auto failed{std::count(programs.begin(), programs.end(), 0u)};
+
+  GLint compiler_threads{0};
+  if (queue.parallel()) {
+    glGetIntegerv(GL_MAX_SHADER_COMPILER_THREADS_KHR, &compiler_threads);
+  }
+
+  std::ofstream file;
+  if (output_path != "-") {
+    file.open(output_path);
+    if (!file) {
+      std::cerr << "Failed to open " << output_path << '\n';
+      return 1;
+    }
+  }
+  auto &os{output_path == "-" ? std::cout : file};
+  os << "{\n";
+  os << "  \"name\": \"ShaderBenchmark\",\n";
+  os << "  \"programs\": " << program_count << ",\n";
+  os << "  \"failed\": " << failed << ",\n";
+  os << "  \"parallel\": " << (queue.parallel() ? "true" : "false") << ",\n";
+  os << "  \"compiler_threads\": " << static_cast<GLuint>(compiler_threads)
+     << ",\n";
+  os << "  \"serial_ms\": " << serial_ms << ",\n";
+  os << "  \"queued_submit_ms\": " << submit_ms << ",\n";
+  os << "  \"queued_first_ready_ms\": " << first_ready_ms << ",\n";
+  os << "  \"queued_ms\": " << queued_ms << ",\n";
+  os << "  \"queued_frames\": " << frames << "\n";
+  os << "}\n";
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <array>
+#include <common/mipmap.hpp>
+#include <common/texture_file.hpp>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stb_image.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Converts an image into a GPU-ready .gtex file with a precomputed mip chain
+// and, optionally, BC1 compression. Mips are box filtered in linear light by
+// default; --kaiser selects the sharper filter and --linear treats the color
+// channels as linear data rather than sRGB.
+//
+// usage: TextureConverter <input image> <output.gtex> [--bc1] [--no-mipmaps]
+//                         [--kaiser] [--linear]
+
+struct Image {
+  int width;
+  int height;
+  int channels;
+  std::vector<unsigned char> pixels;
+};
+
+// Rows padded to 4 bytes, matching the default GL_UNPACK_ALIGNMENT.
+static std::vector<std::byte> pad_rows(const Image &image) {
+  auto row_size{static_cast<std::size_t>(image.width) * image.channels};
+  auto row_pitch{(row_size + 3) & ~std::size_t{3}};
+  std::vector<std::byte> data(row_pitch * image.height);
+  for (int y{0}; y < image.height; ++y) {
+    std::memcpy(data.data() + y * row_pitch,
+                image.pixels.data() + y * row_size, row_size);
+  }
+  return data;
+}
+
+static std::uint16_t to_rgb565(const std::array<int, 3> &color) {
+  return static_cast<std::uint16_t>(((color[0] * 31 + 127) / 255) << 11 |
+                                    ((color[1] * 63 + 127) / 255) << 5 |
+                                    ((color[2] * 31 + 127) / 255));
+}
+
+static std::array<int, 3> from_rgb565(std::uint16_t color) {
+  auto r{(color >> 11) & 31}, g{(color >> 5) & 63}, b{color & 31};
+  return {(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)};
+}
+
+// Encodes one 4x4 block of RGB texels. Endpoints are the extremes of the
+// block along its luminance axis; cheap, and good enough for photos.
+static void encode_bc1_block(const std::array<std::array<int, 3>, 16> &block,
+                             std::byte *output) {
+  auto luminance{[](const std::array<int, 3> &c) {
+    return c[0] * 2 + c[1] * 4 + c[2];
+  }};
+  auto [min_it, max_it]{std::minmax_element(
+      block.begin(), block.end(),
+      [&](auto &a, auto &b) { return luminance(a) < luminance(b); })};
+
+  auto color0{to_rgb565(*max_it)};
+  auto color1{to_rgb565(*min_it)};
+  std::uint32_t indices{0};
+  if (color0 != color1) {
+    if (color0 < color1) {
+      std::swap(color0, color1);
+    }
+    auto c0{from_rgb565(color0)}, c1{from_rgb565(color1)};
+    std::array<std::array<int, 3>, 4> palette{c0, c1};
+    for (int c{0}; c < 3; ++c) {
+      palette[2][c] = (2 * c0[c] + c1[c]) / 3;
+      palette[3][c] = (c0[c] + 2 * c1[c]) / 3;
+    }
+    for (int i{0}; i < 16; ++i) {
+      auto best{0}, best_error{std::numeric_limits<int>::max()};
+      for (int p{0}; p < 4; ++p) {
+        auto error{0};
+        for (int c{0}; c < 3; ++c) {
+          auto d{block[i][c] - palette[p][c]};
+          error += d * d;
+        }
+        if (error < best_error) {
+          best = p;
+          best_error = error;
+        }
+      }
+      indices |= static_cast<std::uint32_t>(best) << (2 * i);
+    }
+  }
+
+  std::memcpy(output, &color0, 2);
+  std::memcpy(output + 2, &color1, 2);
+  std::memcpy(output + 4, &indices, 4);
+}
+
+static std::vector<std::byte> compress_bc1(const Image &image) {
+  auto blocks_x{(image.width + 3) / 4}, blocks_y{(image.height + 3) / 4};
+  std::vector<std::byte> data(static_cast<std::size_t>(blocks_x) * blocks_y *
+                              8);
+  for (int by{0}; by < blocks_y; ++by) {
+    for (int bx{0}; bx < blocks_x; ++bx) {
+      std::array<std::array<int, 3>, 16> block;
+      for (int i{0}; i < 16; ++i) {
+        auto x{std::min(bx * 4 + i % 4, image.width - 1)};
+        auto y{std::min(by * 4 + i / 4, image.height - 1)};
+        auto texel{&image.pixels[(static_cast<std::size_t>(y) * image.width +
+                                  x) *
+                                 image.channels]};
+        block[i] = {texel[0], texel[1], texel[2]};
+      }
+      encode_bc1_block(block,
+                       data.data() + (static_cast<std::size_t>(by) * blocks_x +
+                                      bx) *
+                                         8);
+    }
+  }
+  return data;
+}
+
+int main(int argc, char **argv) {
+  std::vector<std::string> paths;
+  auto bc1{false};
+  auto mipmaps{true};
+  common::MipmapOptions mipmap_options;
+  mipmap_options.threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int i{1}; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--bc1") == 0) {
+      bc1 = true;
+    } else if (std::strcmp(argv[i], "--no-mipmaps") == 0) {
+      mipmaps = false;
+    } else if (std::strcmp(argv[i], "--kaiser") == 0) {
+      mipmap_options.filter = common::MipmapFilter::kaiser;
+    } else if (std::strcmp(argv[i], "--linear") == 0) {
+      mipmap_options.srgb = false;
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+  if (paths.size() != 2) {
+    std::cerr << "usage: " << argv[0]
+              << " <input image> <output.gtex> [--bc1] [--no-mipmaps]"
+                 " [--kaiser] [--linear]\n";
+    return 1;
+  }
+
+  Image image;
+  stbi_set_flip_vertically_on_load(true);
+  auto pixels{stbi_load(paths[0].c_str(), &image.width, &image.height,
+                        &image.channels, bc1 ? 3 : 0)};
+  if (!pixels) {
+    std::cerr << "Failed to load image " << paths[0] << ": "
+              << stbi_failure_reason() << '\n';
+    return 1;
+  }
+  if (bc1) {
+    image.channels = 3;
+  }
+  image.pixels.assign(pixels, pixels + static_cast<std::size_t>(image.width) *
+                                           image.height * image.channels);
+  stbi_image_free(pixels);
+
+  common::TextureData texture;
+  if (bc1) {
+    texture.internal_format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    texture.format = 0;
+    texture.type = 0;
+  } else {
+    const GLenum internal_formats[]{GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+    const GLenum formats[]{GL_RED, GL_RG, GL_RGB, GL_RGBA};
+    texture.internal_format = internal_formats[image.channels - 1];
+    texture.format = formats[image.channels - 1];
+    texture.type = GL_UNSIGNED_BYTE;
+  }
+
+  std::vector<Image> chain;
+  if (mipmaps) {
+    for (auto &level :
+         common::build_mipmaps(image.pixels.data(), image.width, image.height,
+                               image.channels, mipmap_options)) {
+      chain.push_back({level.width, level.height, image.channels,
+                       std::move(level.pixels)});
+    }
+  }
+  chain.insert(chain.begin(), std::move(image));
+
+  for (auto &level : chain) {
+    texture.levels.push_back({static_cast<std::uint32_t>(level.width),
+                              static_cast<std::uint32_t>(level.height),
+                              bc1 ? compress_bc1(level) : pad_rows(level)});
+  }
+
+  return common::write_texture_file(paths[1], texture) ? 0 : 1;
+}
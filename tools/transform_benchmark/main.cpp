@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <common/context.hpp>
+#include <common/transforms.hpp>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Times TransformStore's batched composition against building every matrix
+// with glm, at several object counts, and writes the medians as JSON.
+//
+// usage: TransformBenchmark [--frames <runs>] [--benchmark <path>]
+
+static constexpr int default_runs{20};
+static constexpr std::size_t object_counts[]{1'000, 100'000, 1'000'000};
+
+struct Transform {
+  glm::vec3 position;
+  glm::quat rotation;
+  glm::vec3 scale;
+};
+
+template <class F> static double median_ms(int runs, F &&body) {
+  std::vector<double> samples;
+  for (int i{0}; i < runs; ++i) {
+    auto start{std::chrono::steady_clock::now()};
+    body();
+    samples.push_back(std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - start)
+                          .count());
+  }
+  std::nth_element(samples.begin(), samples.begin() + samples.size() / 2,
+                   samples.end());
+  return samples[samples.size() / 2];
+}
+
+static float max_difference(const std::vector<glm::mat4> &a,
+                            const std::vector<glm::mat4> &b) {
+  float difference{0.0f};
+  for (std::size_t i{0}; i < a.size(); ++i) {
+    for (int c{0}; c < 4; ++c) {
+      for (int r{0}; r < 4; ++r) {
+        difference = std::max(difference, std::abs(a[i][c][r] - b[i][c][r]));
+      }
+    }
+  }
+  return difference;
+}
+
+int main(int argc, char **argv) {
+  auto options{common::parse_options(argc, argv)};
+  auto runs{options.frames > 0 ? options.frames : default_runs};
+
+  std::ofstream file;
+  if (!options.benchmark_path.empty() && options.benchmark_path != "-") {
+    file.open(options.benchmark_path);
+    if (!file) {
+      std::cerr << "Failed to open " << options.benchmark_path << '\n';
+      return 1;
+    }
+  }
+  auto &os{file.is_open() ? file : std::cout};
+
+  std::mt19937 random{42};
+  std::uniform_real_distribution<float> unit{-1.0f, 1.0f};
+  auto view_projection{
+      glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f) *
+      glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f),
+                  glm::vec3(0.0f, 1.0f, 0.0f))};
+
+  os << "{\n";
+  os << "  \"name\": \"TransformBenchmark\",\n";
+  os << "  \"runs\": " << runs << ",\n";
+  os << "  \"median_ms\": {";
+  for (std::size_t n{0}; n < std::size(object_counts); ++n) {
+    auto count{object_counts[n]};
+    std::vector<Transform> transforms;
+    common::TransformStore store;
+    for (std::size_t i{0}; i < count; ++i) {
+      Transform transform{
+          glm::vec3(unit(random), unit(random), unit(random)) * 50.0f,
+          glm::angleAxis(unit(random) * 3.14159f,
+                         glm::normalize(glm::vec3(unit(random), unit(random),
+                                                  unit(random)) +
+                                        glm::vec3(0.0f, 0.0f, 1.5f))),
+          glm::vec3(1.0f + unit(random) * 0.5f)};
+      transforms.push_back(transform);
+      store.add(transform.position, transform.rotation, transform.scale);
+    }
+
+    std::vector<glm::mat4> expected(count), actual(count);
+    auto glm_world{median_ms(runs, [&] {
+      for (std::size_t i{0}; i < count; ++i) {
+        auto &transform{transforms[i]};
+        expected[i] = glm::translate(glm::mat4(1.0f), transform.position) *
+                      glm::mat4_cast(transform.rotation) *
+                      glm::scale(glm::mat4(1.0f), transform.scale);
+      }
+    })};
+    auto soa_world{
+        median_ms(runs, [&] { store.compose_world(actual.data()); })};
+    auto world_error{max_difference(expected, actual)};
+
+    auto glm_mvp{median_ms(runs, [&] {
+      for (std::size_t i{0}; i < count; ++i) {
+        auto &transform{transforms[i]};
+        expected[i] = view_projection *
+                      glm::translate(glm::mat4(1.0f), transform.position) *
+                      glm::mat4_cast(transform.rotation) *
+                      glm::scale(glm::mat4(1.0f), transform.scale);
+      }
+    })};
+    auto soa_mvp{median_ms(runs, [&] {
+      store.compose_mvp(view_projection, actual.data());
+    })};
+    auto mvp_error{max_difference(expected, actual)};
+
+    os << (n ? "," : "") << "\n    \"" << count << "\": {\"glm_world\": "
+       << glm_world << ", \"soa_world\": " << soa_world
+       << ", \"glm_mvp\": " << glm_mvp << ", \"soa_mvp\": " << soa_mvp
+       << ", \"max_error\": " << std::max(world_error, mvp_error) << "}";
+  }
+  os << "\n  }\n";
+  os << "}\n";
+  return 0;
+}